@@ -0,0 +1,274 @@
+/* Microbenchmarks for the DSP kernels and the full frame pipeline.
+
+   Usage: rnnoise_bench [--json FILE] [--min-time SECONDS] [--neurons N] [--density D]
+
+   Every benchmark reports ns/frame, frames/s/core and the real-time factor
+   (processing time over the 10 ms of audio in a frame). Results are printed
+   as a table and, with --json, written as machine-readable JSON so runs can
+   be compared across versions, along with the memory used by one stream. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rnnoise.h"
+#include "common.h"
+#include "kiss_fft.h"
+#include "pitch.h"
+#include "rnn.h"
+
+#define FRAME_NS 10000000.0
+#define NB_REPEATS 5
+#define MAX_BENCHES 32
+
+typedef struct {
+    const char *name;
+    double ns_per_frame;
+    long long iterations;
+} BenchResult;
+
+typedef void (*bench_fn)(void *arg);
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static float randf(void) {
+    return (float)rand()/RAND_MAX*2.f - 1.f;
+}
+
+/* Uniform in [-scale, scale], in Q(bits) for the fixed-point build. */
+#ifdef FIXED_POINT
+#define RAND_SIGNAL(scale, bits) ((int)((scale)*randf()*(1 << (bits))))
+#else
+#define RAND_SIGNAL(scale, bits) ((scale)*randf())
+#endif
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Calibrates an iteration count that runs for about min_time/NB_REPEATS,
+   then reports the median of NB_REPEATS timed runs. */
+static BenchResult run_bench(const char *name, bench_fn fn, void *arg, double min_time) {
+    BenchResult r;
+    double per_rep[NB_REPEATS];
+    double target = min_time*1e9/NB_REPEATS;
+    long long iters = 1, i;
+    int rep;
+
+    for (;;) {
+        double start = now_ns();
+        for (i=0;i<iters;i++) fn(arg);
+        if (now_ns() - start >= target/10 || iters >= (1LL<<30)) {
+            double elapsed = now_ns() - start;
+            iters = (long long)(iters*target/(elapsed > 0 ? elapsed : 1)) + 1;
+            break;
+        }
+        iters *= 2;
+    }
+    for (rep=0;rep<NB_REPEATS;rep++) {
+        double start = now_ns();
+        for (i=0;i<iters;i++) fn(arg);
+        per_rep[rep] = (now_ns() - start)/iters;
+    }
+    qsort(per_rep, NB_REPEATS, sizeof(double), cmp_double);
+    r.name = name;
+    r.ns_per_frame = per_rep[NB_REPEATS/2];
+    r.iterations = iters*NB_REPEATS;
+    return r;
+}
+
+typedef struct {
+    kiss_fft_cfg cfg;
+    kiss_fft_cpx in[FRAME_SIZE];
+    kiss_fft_cpx out[FRAME_SIZE];
+    opus_val32 x[FRAME_SIZE];
+    float Ex[NB_BANDS];
+    opus_val32 xcorr[PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1];
+    opus_val16 pitch_buf[PITCH_FRAME_SIZE];
+} KernelArgs;
+
+static void bench_kiss_fft(void *arg) {
+    KernelArgs *a = arg;
+    kiss_fft(a->cfg, a->in, a->out);
+}
+
+static void bench_forward_transform(void *arg) {
+    KernelArgs *a = arg;
+    forward_transform(a->out, a->x);
+}
+
+static void bench_inverse_transform(void *arg) {
+    KernelArgs *a = arg;
+    inverse_transform(a->x, a->in, 0);
+}
+
+static void bench_band_energy(void *arg) {
+    KernelArgs *a = arg;
+    compute_band_energy(a->Ex, a->in, 0);
+}
+
+static void bench_pitch_xcorr(void *arg) {
+    KernelArgs *a = arg;
+    compute_pitch_xcorr(a->pitch_buf, a->xcorr);
+}
+
+typedef struct {
+    RNNState rnn;
+    opus_val16 *neurons;
+    opus_val16 in[NB_BANDS+1];
+    opus_val16 out[NB_BANDS+1];
+} RNNArgs;
+
+static float *random_weights(int n) {
+    int i;
+    float *w = malloc(sizeof(float)*n);
+    for (i=0;i<n;i++) w[i] = .1f*randf();
+    return w;
+}
+
+static void init_rnn(RNNArgs *a, int nb_neurons, float density) {
+    int i;
+    float *w[6];
+    w[0] = random_weights((NB_BANDS+1)*nb_neurons);
+    w[1] = random_weights(nb_neurons*nb_neurons);
+    w[2] = random_weights(nb_neurons*(NB_BANDS+1));
+    w[3] = random_weights(nb_neurons);
+    w[4] = random_weights(nb_neurons);
+    w[5] = random_weights(NB_BANDS+1);
+    if (rnn_init_sparse(&a->rnn, NB_BANDS+1, nb_neurons, NB_BANDS+1, w[0], w[1], w[2], w[3], w[4], w[5], density)) {
+        fprintf(stderr, "rnn_init_sparse failed\n");
+        exit(1);
+    }
+    for (i=0;i<6;i++) free(w[i]);
+    a->neurons = calloc(nb_neurons, sizeof(*a->neurons));
+    for (i=0;i<NB_BANDS+1;i++) a->in[i] = RAND_SIGNAL(1.f, ACTIVATION_SHIFT);
+}
+
+static void bench_compute_rnn(void *arg) {
+    RNNArgs *a = arg;
+    compute_rnn(&a->rnn, a->neurons, a->in, a->out);
+}
+
+#define PIPELINE_FRAMES 100
+
+typedef struct {
+    DenoiseState *st;
+    short *pcm;
+    short out[FRAME_SIZE];
+    int pos;
+} PipelineArgs;
+
+/* Cycles through a fixed block of noisy tone frames so that the noise
+   estimate and gains keep changing as they would on real input. */
+static void bench_process_frame(void *arg) {
+    PipelineArgs *a = arg;
+    rnnoise_process_frame(a->st, a->out, &a->pcm[a->pos*FRAME_SIZE]);
+    a->pos = (a->pos + 1) % PIPELINE_FRAMES;
+}
+
+static void init_pipeline(PipelineArgs *a, int complexity) {
+    int i;
+    a->st = rnnoise_create(NULL);
+    rnnoise_set_complexity(a->st, complexity);
+    a->pcm = malloc(sizeof(short)*FRAME_SIZE*PIPELINE_FRAMES);
+    for (i=0;i<FRAME_SIZE*PIPELINE_FRAMES;i++)
+        a->pcm[i] = (short)(4000*sinf(2*M_PI*220*i/48000.f) + 1000*randf());
+    a->pos = 0;
+}
+
+static void free_pipeline(PipelineArgs *a) {
+    rnnoise_destroy(a->st);
+    free(a->pcm);
+}
+
+static void write_json(FILE *f, const BenchResult *r, int n, int nb_neurons, float density, int stream_bytes) {
+    int i;
+    fprintf(f, "{\n  \"frame_size\": %d,\n  \"frame_ns\": %.0f,\n  \"rnn_neurons\": %d,\n  \"rnn_weight_bytes\": %d,\n  \"rnn_density\": %.3f,\n  \"stream_bytes\": %d,\n  \"benchmarks\": [\n",
+            FRAME_SIZE, FRAME_NS, nb_neurons, (int)sizeof(rnn_weight), density, stream_bytes);
+    for (i=0;i<n;i++) {
+        fprintf(f, "    {\"name\": \"%s\", \"ns_per_frame\": %.1f, \"frames_per_sec_core\": %.1f, "
+                "\"realtime_factor\": %.6f, \"iterations\": %lld}%s\n",
+                r[i].name, r[i].ns_per_frame, 1e9/r[i].ns_per_frame, r[i].ns_per_frame/FRAME_NS,
+                r[i].iterations, i+1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char **argv) {
+    int i, n = 0;
+    const char *json_path = NULL;
+    double min_time = 1.;
+    int nb_neurons = 96;
+    float density = 1;
+    int stream_bytes = 0;
+    BenchResult results[MAX_BENCHES];
+    KernelArgs *k;
+    RNNArgs rnn;
+    PipelineArgs pipeline;
+    static const int complexities[] = {0, 4, 6, RNNOISE_MAX_COMPLEXITY};
+    static const char *pipeline_names[] = {"process_frame_c0", "process_frame_c4",
+                                           "process_frame_c6", "process_frame_c10"};
+
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i], "--json") && i+1 < argc) json_path = argv[++i];
+        else if (!strcmp(argv[i], "--min-time") && i+1 < argc) min_time = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--neurons") && i+1 < argc) nb_neurons = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--density") && i+1 < argc) density = atof(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--json FILE] [--min-time SECONDS] [--neurons N] [--density D]\n", argv[0]);
+            return 1;
+        }
+    }
+    srand(42);
+
+    k = calloc(1, sizeof(*k));
+    k->cfg = kiss_fft_alloc(FRAME_SIZE, 0, NULL, NULL);
+    for (i=0;i<FRAME_SIZE;i++) {
+        k->in[i].r = RAND_SIGNAL(1.f, 21);
+        k->in[i].i = RAND_SIGNAL(1.f, 21);
+        k->x[i] = RAND_SIGNAL(1.f, 21);
+    }
+    for (i=0;i<PITCH_FRAME_SIZE;i++) k->pitch_buf[i] = RAND_SIGNAL(1.f, 12);
+    results[n++] = run_bench("kiss_fft", bench_kiss_fft, k, min_time);
+    results[n++] = run_bench("forward_transform", bench_forward_transform, k, min_time);
+    results[n++] = run_bench("inverse_transform", bench_inverse_transform, k, min_time);
+    results[n++] = run_bench("compute_band_energy", bench_band_energy, k, min_time);
+    results[n++] = run_bench("compute_pitch_xcorr", bench_pitch_xcorr, k, min_time);
+    kiss_fft_free(k->cfg);
+    free(k);
+
+    init_rnn(&rnn, nb_neurons, density);
+    results[n++] = run_bench("compute_rnn", bench_compute_rnn, &rnn, min_time);
+    rnn_free(&rnn.rnn);
+    free(rnn.neurons);
+
+    for (i=0;i<(int)(sizeof(complexities)/sizeof(complexities[0]));i++) {
+        init_pipeline(&pipeline, complexities[i]);
+        results[n++] = run_bench(pipeline_names[i], bench_process_frame, &pipeline, min_time);
+        if (i == 0) stream_bytes = rnnoise_get_memory(pipeline.st);
+        free_pipeline(&pipeline);
+    }
+
+    printf("%d bytes per stream\n", stream_bytes);
+    printf("%-24s %14s %18s %12s\n", "benchmark", "ns/frame", "frames/s/core", "RTF");
+    for (i=0;i<n;i++) {
+        printf("%-24s %14.1f %18.1f %12.6f\n", results[i].name, results[i].ns_per_frame,
+               1e9/results[i].ns_per_frame, results[i].ns_per_frame/FRAME_NS);
+    }
+    if (json_path) {
+        FILE *f = strcmp(json_path, "-") ? fopen(json_path, "w") : stdout;
+        if (!f) {
+            perror(json_path);
+            return 1;
+        }
+        write_json(f, results, n, nb_neurons, density, stream_bytes);
+        if (f != stdout) fclose(f);
+    }
+    return 0;
+}
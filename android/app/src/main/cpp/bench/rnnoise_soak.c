@@ -0,0 +1,379 @@
+/* Concurrent-call soak harness.
+
+   Usage: rnnoise_soak [-n STREAMS] [-t THREADS] [-d SECONDS] [--budget-ms MS]
+                       [--input FILE] [--degrade] [--find-max] [--json FILE]
+
+   Simulates STREAMS calls, each releasing one frame every 10 ms at a
+   staggered phase, served by THREADS worker threads. Latency is measured
+   from a frame's release to the end of its processing, so a thread that
+   falls behind shows up as queueing delay rather than hiding it. Frames
+   come from a recorded corpus (16-bit mono WAV or raw PCM, --input) or a
+   synthetic noisy tone; each stream starts at a different offset.
+
+   With --degrade, frames go through the deadline scheduler, which steps
+   down to cheaper modes instead of missing the budget. With --find-max, the
+   harness searches for the largest stream count whose p99 latency stays
+   within the budget and reports it per core. */
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "rnnoise.h"
+#include "scheduler.h"
+
+#define FRAME_NS 10000000LL
+/* Latency histogram: 1 us buckets up to 100 ms, plus an overflow bucket. */
+#define HIST_BUCKET_NS 1000LL
+#define HIST_BUCKETS 100001
+
+typedef struct {
+    DenoiseState *st;
+    long long offset;
+    long long next_release;
+    short out[];
+} Stream;
+
+typedef struct {
+    const short *corpus;
+    long long corpus_len;
+    int frame_size;
+    long long budget_ns;
+    long long end;
+    int degrade;
+} SoakConfig;
+
+typedef struct {
+    const SoakConfig *cfg;
+    Stream **streams;
+    int nb_streams;
+    unsigned *hist;
+    long long frames;
+    long long misses;
+    long long max_ns;
+    RNNoiseSchedStats sched;
+} Worker;
+
+typedef struct {
+    int nb_streams;
+    int nb_threads;
+    long long frames;
+    long long misses;
+    double p50_ms, p99_ms, p999_ms, max_ms;
+    long long degradations;
+    long long bytes_per_stream;
+} SoakResult;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(long long t) {
+    struct timespec ts;
+    ts.tv_sec = t/1000000000LL;
+    ts.tv_nsec = t%1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+}
+
+static long long rss_bytes(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+    return (long long)resident*sysconf(_SC_PAGESIZE);
+}
+
+static void record(Worker *w, long long latency) {
+    long long b = latency/HIST_BUCKET_NS;
+    w->hist[b < HIST_BUCKETS-1 ? b : HIST_BUCKETS-1]++;
+    w->frames++;
+    if (latency > w->cfg->budget_ns) w->misses++;
+    if (latency > w->max_ns) w->max_ns = latency;
+}
+
+static const short *next_frame(const SoakConfig *cfg, Stream *s) {
+    const short *in = &cfg->corpus[s->offset];
+    s->offset += cfg->frame_size;
+    if (s->offset + cfg->frame_size > cfg->corpus_len) s->offset = 0;
+    return in;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    const SoakConfig *cfg = w->cfg;
+    RNNoiseScheduler *sched = NULL;
+    long long *release = malloc(w->nb_streams*sizeof(*release));
+    int i;
+
+    if (cfg->degrade) sched = rnnoise_sched_create(w->nb_streams, 0);
+    for (;;) {
+        long long next = w->streams[0]->next_release;
+        int due = 0;
+        for (i=1;i<w->nb_streams;i++)
+            if (w->streams[i]->next_release < next) next = w->streams[i]->next_release;
+        if (next >= cfg->end) break;
+        sleep_until(next);
+
+        long long now = now_ns();
+        for (i=0;i<w->nb_streams;i++) {
+            Stream *s = w->streams[i];
+            if (s->next_release > now) continue;
+            release[due] = s->next_release;
+            s->next_release += FRAME_NS;
+            if (sched) {
+                rnnoise_sched_submit(sched, s->st, s->out, next_frame(cfg, s), release[due] + cfg->budget_ns, NULL);
+            } else {
+                rnnoise_process_frame(s->st, s->out, next_frame(cfg, s));
+                record(w, now_ns() - release[due]);
+            }
+            due++;
+        }
+        if (sched) {
+            /* The scheduler runs frames earliest-deadline first, which here is
+               release order, so latencies are attributed in the same order. */
+            long long done;
+            rnnoise_sched_run(sched);
+            done = now_ns();
+            for (i=0;i<due;i++) record(w, done - release[i]);
+        }
+    }
+    if (sched) {
+        rnnoise_sched_get_stats(sched, &w->sched);
+        rnnoise_sched_destroy(sched);
+    }
+    free(release);
+    return NULL;
+}
+
+static double percentile_ms(const unsigned *hist, long long total, double p) {
+    long long target = (long long)ceil(total*p), seen = 0;
+    int b;
+    if (total == 0) return 0;
+    for (b=0;b<HIST_BUCKETS;b++) {
+        seen += hist[b];
+        if (seen >= target) return (b+1)*HIST_BUCKET_NS/1e6;
+    }
+    return HIST_BUCKETS*HIST_BUCKET_NS/1e6;
+}
+
+static SoakResult run_soak(const SoakConfig *base, int nb_streams, int nb_threads, double seconds) {
+    SoakConfig cfg = *base;
+    SoakResult r;
+    Stream **streams = malloc(nb_streams*sizeof(*streams));
+    Worker *workers = calloc(nb_threads, sizeof(*workers));
+    pthread_t *threads = malloc(nb_threads*sizeof(*threads));
+    unsigned *hist = calloc(HIST_BUCKETS, sizeof(*hist));
+    long long rss_before, start, t;
+    int i, b;
+
+    memset(&r, 0, sizeof(r));
+    r.nb_streams = nb_streams;
+    r.nb_threads = nb_threads;
+
+    rss_before = rss_bytes();
+    start = now_ns() + 50000000LL;
+    for (i=0;i<nb_streams;i++) {
+        streams[i] = malloc(sizeof(Stream) + cfg.frame_size*sizeof(short));
+        streams[i]->st = rnnoise_create(NULL);
+        streams[i]->offset = (cfg.corpus_len/nb_streams*(long long)i)/cfg.frame_size*cfg.frame_size;
+        if (streams[i]->offset + cfg.frame_size > cfg.corpus_len) streams[i]->offset = 0;
+        /* Spread the releases over the frame period like independent calls. */
+        streams[i]->next_release = start + FRAME_NS*i/nb_streams;
+        /* Touch the state so it is resident before measuring. */
+        memset(streams[i]->out, 0, cfg.frame_size*sizeof(short));
+        rnnoise_process_frame(streams[i]->st, streams[i]->out, streams[i]->out);
+    }
+    r.bytes_per_stream = (rss_bytes() - rss_before)/nb_streams;
+
+    cfg.end = start + (long long)(seconds*1e9);
+    for (t=0;t<nb_threads;t++) {
+        Worker *w = &workers[t];
+        w->cfg = &cfg;
+        w->hist = calloc(HIST_BUCKETS, sizeof(*w->hist));
+        w->streams = malloc(nb_streams*sizeof(*w->streams));
+        for (i=t;i<nb_streams;i+=nb_threads) w->streams[w->nb_streams++] = streams[i];
+    }
+    for (t=0;t<nb_threads;t++) {
+        if (workers[t].nb_streams > 0) pthread_create(&threads[t], NULL, worker_main, &workers[t]);
+    }
+    for (t=0;t<nb_threads;t++) {
+        Worker *w = &workers[t];
+        if (w->nb_streams == 0) continue;
+        pthread_join(threads[t], NULL);
+        for (b=0;b<HIST_BUCKETS;b++) hist[b] += w->hist[b];
+        r.frames += w->frames;
+        r.misses += w->misses;
+        r.degradations += w->sched.degradations;
+        if (w->max_ns/1e6 > r.max_ms) r.max_ms = w->max_ns/1e6;
+        free(w->hist);
+        free(w->streams);
+    }
+    r.p50_ms = percentile_ms(hist, r.frames, .5);
+    r.p99_ms = percentile_ms(hist, r.frames, .99);
+    r.p999_ms = percentile_ms(hist, r.frames, .999);
+
+    for (i=0;i<nb_streams;i++) {
+        rnnoise_destroy(streams[i]->st);
+        free(streams[i]);
+    }
+    free(streams);
+    free(workers);
+    free(threads);
+    free(hist);
+    return r;
+}
+
+static short *load_corpus(const char *path, long long *len) {
+    FILE *f = fopen(path, "rb");
+    long size;
+    short *pcm;
+    size_t skip = 0;
+    char hdr[12];
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    /* Skip a canonical 44-byte WAV header; the payload is assumed to be
+       16-bit mono PCM. */
+    if (fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr) && !memcmp(hdr, "RIFF", 4) && !memcmp(hdr + 8, "WAVE", 4))
+        skip = 44;
+    fseek(f, skip, SEEK_SET);
+    *len = (size - skip)/sizeof(short);
+    pcm = malloc(*len*sizeof(short));
+    if (fread(pcm, sizeof(short), *len, f) != (size_t)*len) {
+        free(pcm);
+        pcm = NULL;
+    }
+    fclose(f);
+    return pcm;
+}
+
+static short *synth_corpus(long long len) {
+    long long i;
+    short *pcm = malloc(len*sizeof(short));
+    unsigned seed = 1;
+    for (i=0;i<len;i++) {
+        /* A 2 s on / 1 s off "talker" over broadband noise. */
+        float talk = (i/48000)%3 < 2 ? 6000*sinf(2*M_PI*180*i/48000.f)*(.6f + .4f*sinf(2*M_PI*3*i/48000.f)) : 0;
+        seed = seed*1103515245 + 12345;
+        pcm[i] = (short)(talk + ((int)(seed>>16)%2001 - 1000));
+    }
+    return pcm;
+}
+
+static void print_result(const SoakResult *r) {
+    printf("streams %5d threads %3d  frames %9lld  p50 %7.3f ms  p99 %7.3f ms  p999 %7.3f ms  max %8.3f ms  "
+           "misses %lld (%.4f%%)  degraded %lld  mem/stream %lld B\n",
+           r->nb_streams, r->nb_threads, r->frames, r->p50_ms, r->p99_ms, r->p999_ms, r->max_ms,
+           r->misses, r->frames ? 100.*r->misses/r->frames : 0., r->degradations, r->bytes_per_stream);
+}
+
+static void write_json(FILE *f, const SoakResult *r, int n, long long budget_ns, int max_streams) {
+    int i;
+    fprintf(f, "{\n  \"budget_ms\": %.3f,\n", budget_ns/1e6);
+    if (max_streams >= 0)
+        fprintf(f, "  \"max_streams\": %d,\n  \"max_streams_per_core\": %.2f,\n", max_streams,
+                (double)max_streams/r[0].nb_threads);
+    fprintf(f, "  \"runs\": [\n");
+    for (i=0;i<n;i++) {
+        fprintf(f, "    {\"streams\": %d, \"threads\": %d, \"frames\": %lld, \"p50_ms\": %.3f, \"p99_ms\": %.3f, "
+                "\"p999_ms\": %.3f, \"max_ms\": %.3f, \"misses\": %lld, \"degradations\": %lld, "
+                "\"bytes_per_stream\": %lld}%s\n",
+                r[i].nb_streams, r[i].nb_threads, r[i].frames, r[i].p50_ms, r[i].p99_ms, r[i].p999_ms,
+                r[i].max_ms, r[i].misses, r[i].degradations, r[i].bytes_per_stream, i+1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+#define MAX_RUNS 64
+
+int main(int argc, char **argv) {
+    SoakConfig cfg;
+    SoakResult runs[MAX_RUNS];
+    int nb_runs = 0;
+    int nb_streams = 8, nb_threads = 1, find_max = 0, max_streams = -1;
+    double seconds = 10, budget_ms = 10;
+    const char *input = NULL, *json_path = NULL;
+    short *corpus;
+    int i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i], "-n") && i+1 < argc) nb_streams = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && i+1 < argc) nb_threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && i+1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--budget-ms") && i+1 < argc) budget_ms = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--input") && i+1 < argc) input = argv[++i];
+        else if (!strcmp(argv[i], "--json") && i+1 < argc) json_path = argv[++i];
+        else if (!strcmp(argv[i], "--degrade")) cfg.degrade = 1;
+        else if (!strcmp(argv[i], "--find-max")) find_max = 1;
+        else {
+            fprintf(stderr, "usage: %s [-n STREAMS] [-t THREADS] [-d SECONDS] [--budget-ms MS] "
+                    "[--input FILE] [--degrade] [--find-max] [--json FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (nb_streams < 1 || nb_threads < 1) return 1;
+
+    cfg.frame_size = rnnoise_get_frame_size();
+    cfg.budget_ns = (long long)(budget_ms*1e6);
+    if (input) {
+        corpus = load_corpus(input, &cfg.corpus_len);
+        if (!corpus || cfg.corpus_len < cfg.frame_size) {
+            fprintf(stderr, "%s: cannot load corpus\n", input);
+            return 1;
+        }
+    } else {
+        cfg.corpus_len = 30*48000;
+        corpus = synth_corpus(cfg.corpus_len);
+    }
+    cfg.corpus = corpus;
+
+    if (!find_max) {
+        runs[nb_runs] = run_soak(&cfg, nb_streams, nb_threads, seconds);
+        print_result(&runs[nb_runs++]);
+    } else {
+        /* Double until p99 breaks the budget, then bisect. */
+        int lo = 0, hi = 0, n = nb_streams;
+        while (nb_runs < MAX_RUNS) {
+            runs[nb_runs] = run_soak(&cfg, n, nb_threads, seconds);
+            print_result(&runs[nb_runs]);
+            if (runs[nb_runs++].p99_ms*1e6 <= cfg.budget_ns) {
+                lo = n;
+                n *= 2;
+            } else {
+                hi = n;
+                break;
+            }
+        }
+        while (hi - lo > 1 && nb_runs < MAX_RUNS) {
+            int mid = (lo + hi)/2;
+            runs[nb_runs] = run_soak(&cfg, mid, nb_threads, seconds);
+            print_result(&runs[nb_runs]);
+            if (runs[nb_runs++].p99_ms*1e6 <= cfg.budget_ns) lo = mid;
+            else hi = mid;
+        }
+        max_streams = lo;
+        printf("max streams with p99 <= %.3f ms: %d on %d threads (%.2f per core)\n",
+               budget_ms, max_streams, nb_threads, (double)max_streams/nb_threads);
+    }
+
+    if (json_path) {
+        FILE *f = strcmp(json_path, "-") ? fopen(json_path, "w") : stdout;
+        if (!f) {
+            perror(json_path);
+            return 1;
+        }
+        write_json(f, runs, nb_runs, cfg.budget_ns, max_streams);
+        if (f != stdout) fclose(f);
+    }
+    free(corpus);
+    return 0;
+}
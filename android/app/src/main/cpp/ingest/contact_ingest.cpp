@@ -0,0 +1,273 @@
+#include "contact_ingest.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <new>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+struct ContactTable {
+    const char *data;
+    size_t size;
+    std::atomic<int64_t> progress;
+    std::vector<uint8_t> names, phones;
+    std::vector<uint32_t> name_offsets, phone_offsets;
+};
+
+namespace {
+
+/* Progress is published every 64 kB so polling stays cheap for the parser. */
+const size_t kProgressStep = 1 << 16;
+
+inline bool is_special(char c) {
+    return c == ',' || c == '"' || c == '\n' || c == '\r';
+}
+
+/* Returns the first ',', '"', '\n' or '\r' in [p, end), or end. */
+const char *find_special(const char *p, const char *end) {
+#if defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(','), quote = _mm_set1_epi8('"');
+    const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, quote)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t comma = vdupq_n_u8(','), quote = vdupq_n_u8('"');
+    const uint8x16_t lf = vdupq_n_u8('\n'), cr = vdupq_n_u8('\r');
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, comma), vceqq_u8(v, quote)),
+                                  vorrq_u8(vceqq_u8(v, lf), vceqq_u8(v, cr)));
+        /* Narrowing shift packs the 16 byte lanes into 4 bits each. */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask) return p + (__builtin_ctzll(mask) >> 2);
+    }
+#endif
+    for (; p < end; p++) {
+        if (is_special(*p)) return p;
+    }
+    return end;
+}
+
+struct Field {
+    const char *begin;
+    const char *end;
+};
+
+inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+Field trim(Field f) {
+    while (f.begin < f.end && is_space(*f.begin)) f.begin++;
+    while (f.end > f.begin && is_space(f.end[-1])) f.end--;
+    return f;
+}
+
+/* Reads one field starting at p and leaves p on the delimiter that ended it.
+   Quoted fields with "" escapes are unescaped into scratch; everything else
+   is returned in place. */
+Field read_field(const char *&p, const char *end, std::string &scratch) {
+    Field f;
+    if (p < end && *p == '"') {
+        scratch.clear();
+        p++;
+        for (;;) {
+            const char *q = static_cast<const char *>(memchr(p, '"', end - p));
+            if (q == NULL) {
+                scratch.append(p, end - p);
+                p = end;
+                break;
+            }
+            scratch.append(p, q - p);
+            p = q + 1;
+            if (p < end && *p == '"') {
+                scratch.push_back('"');
+                p++;
+            } else {
+                break;
+            }
+        }
+        /* Anything between the closing quote and the delimiter is kept. */
+        while (p < end && *p != ',' && *p != '\n' && *p != '\r') scratch.push_back(*p++);
+        f.begin = scratch.data();
+        f.end = scratch.data() + scratch.size();
+        return f;
+    }
+    f.begin = p;
+    for (;;) {
+        p = find_special(p, end);
+        if (p < end && *p == '"') {
+            /* A stray quote inside an unquoted field is literal. */
+            p++;
+            continue;
+        }
+        break;
+    }
+    f.end = p;
+    return f;
+}
+
+/* Same rules as the Dart importer: trim, drop a ".0" left by spreadsheet
+   exports, then keep only the digits. A leading '+' is kept as well so that
+   callai_phone_normalize() can tell international numbers apart. */
+void append_phone(std::vector<uint8_t> &out, Field f) {
+    size_t start = out.size();
+    f = trim(f);
+    if (f.end - f.begin >= 2 && f.end[-2] == '.' && f.end[-1] == '0') f.end -= 2;
+    if (f.begin < f.end && *f.begin == '+') {
+        out.push_back('+');
+        f.begin++;
+    }
+    for (const char *c = f.begin; c < f.end; c++) {
+        if (*c >= '0' && *c <= '9') out.push_back(static_cast<uint8_t>(*c));
+    }
+    /* No digits at all counts as an empty number. */
+    if (out.size() == start + 1) out.resize(start);
+}
+
+}  // namespace
+
+ContactTable *callai_ingest_open(const char *path) {
+    struct stat sb;
+    void *data = NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (sb.st_size > 0) {
+        data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+        madvise(data, sb.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    ContactTable *table = new ContactTable();
+    table->data = static_cast<const char *>(data);
+    table->size = sb.st_size;
+    table->progress.store(0, std::memory_order_relaxed);
+    return table;
+}
+
+int callai_ingest_run(ContactTable *table) {
+    const char *p = table->data;
+    const char *end = p + table->size;
+    const char *last_progress = p;
+    std::string name_scratch, phone_scratch, scratch;
+    bool header = true;
+
+    /* Offsets are 32-bit. */
+    if (table->size > UINT32_MAX) return CALLAI_INGEST_ERR_MEMORY;
+    table->names.clear();
+    table->phones.clear();
+    table->name_offsets.assign(1, 0);
+    table->phone_offsets.assign(1, 0);
+    if (table->size >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;
+    try {
+        /* Most rows are a short name and a 10 digit number. */
+        table->names.reserve(table->size / 2);
+        table->phones.reserve(table->size / 4);
+        table->name_offsets.reserve(table->size / 24 + 1);
+        table->phone_offsets.reserve(table->size / 24 + 1);
+
+        while (p < end) {
+            Field name = {NULL, NULL}, phone = {NULL, NULL};
+            int columns = 0;
+            /* Before any row can be skipped, so runs of skipped rows still
+               advance the progress. */
+            if (static_cast<size_t>(p - last_progress) >= kProgressStep) {
+                last_progress = p;
+                table->progress.store(p - table->data, std::memory_order_relaxed);
+            }
+            for (;;) {
+                Field f = read_field(p, end, scratch);
+                if (columns == 0) {
+                    name_scratch.assign(f.begin, f.end - f.begin);
+                } else if (columns == 1) {
+                    phone_scratch.assign(f.begin, f.end - f.begin);
+                }
+                columns++;
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                break;
+            }
+            if (p < end && *p == '\r') p++;
+            if (p < end && *p == '\n') p++;
+
+            if (header) {
+                if (columns < 2) return CALLAI_INGEST_ERR_FORMAT;
+                header = false;
+                continue;
+            }
+            name.begin = name_scratch.data();
+            name.end = name.begin + name_scratch.size();
+            name = trim(name);
+            if (columns < 2 || (name.begin < name.end && *name.begin == '#')) continue;
+
+            size_t phone_start = table->phones.size();
+            phone.begin = phone_scratch.data();
+            phone.end = phone.begin + phone_scratch.size();
+            append_phone(table->phones, phone);
+            if (name.begin == name.end || table->phones.size() == phone_start) {
+                table->phones.resize(phone_start);
+                continue;
+            }
+            table->names.insert(table->names.end(), name.begin, name.end);
+            table->name_offsets.push_back(static_cast<uint32_t>(table->names.size()));
+            table->phone_offsets.push_back(static_cast<uint32_t>(table->phones.size()));
+        }
+    } catch (const std::bad_alloc &) {
+        return CALLAI_INGEST_ERR_MEMORY;
+    }
+    table->progress.store(table->size, std::memory_order_release);
+    return header ? CALLAI_INGEST_ERR_FORMAT : CALLAI_INGEST_OK;
+}
+
+int64_t callai_ingest_progress(const ContactTable *table) {
+    return table->progress.load(std::memory_order_acquire);
+}
+
+int64_t callai_ingest_size(const ContactTable *table) {
+    return table->size;
+}
+
+int32_t callai_ingest_rows(const ContactTable *table) {
+    return static_cast<int32_t>(table->name_offsets.size()) - 1;
+}
+
+const uint8_t *callai_ingest_column(const ContactTable *table, int32_t column,
+                                    const uint32_t **offsets) {
+    if (column == CALLAI_INGEST_PHONE) {
+        *offsets = table->phone_offsets.data();
+        return table->phones.data();
+    }
+    *offsets = table->name_offsets.data();
+    return table->names.data();
+}
+
+void callai_ingest_close(ContactTable *table) {
+    if (table == NULL) return;
+    if (table->data) munmap(const_cast<char *>(table->data), table->size);
+    delete table;
+}
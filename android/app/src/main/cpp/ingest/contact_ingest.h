@@ -0,0 +1,76 @@
+#ifndef CONTACT_INGEST_H
+#define CONTACT_INGEST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define CALLAI_EXPORT __attribute__((visibility("default")))
+#else
+#define CALLAI_EXPORT
+#endif
+
+/** Contact list import for large CSV files, called from Dart through FFI.
+    The file is memory-mapped and scanned for delimiters with SIMD; the first
+    two columns (name, phone number) are stored as a columnar table. */
+typedef struct ContactTable ContactTable;
+
+#define CALLAI_INGEST_NAME 0
+#define CALLAI_INGEST_PHONE 1
+
+#define CALLAI_INGEST_OK 0
+/** The file could not be opened or mapped. */
+#define CALLAI_INGEST_ERR_IO -1
+/** The header row has fewer than two columns. */
+#define CALLAI_INGEST_ERR_FORMAT -2
+#define CALLAI_INGEST_ERR_MEMORY -3
+
+/**
+ * Maps a CSV file for import. Parsing happens in callai_ingest_run().
+ *
+ * @param[in] path File path (UTF-8).
+ * @return A table, or `NULL` if the file cannot be mapped.
+ */
+CALLAI_EXPORT ContactTable *callai_ingest_open(const char *path);
+
+/**
+ * Parses the whole file. Meant to run on a background isolate while another
+ * isolate polls callai_ingest_progress().
+ *
+ * Rows are skipped if they are the header, start with '#', or have an empty
+ * name or phone number. Phone numbers keep only their digits and a leading
+ * '+' (a trailing ".0" from spreadsheet exports is dropped first).
+ *
+ * @return `CALLAI_INGEST_OK` or a `CALLAI_INGEST_ERR_*` code.
+ */
+CALLAI_EXPORT int callai_ingest_run(ContactTable *table);
+
+/** Returns the number of bytes parsed so far; safe from any thread. */
+CALLAI_EXPORT int64_t callai_ingest_progress(const ContactTable *table);
+
+CALLAI_EXPORT int64_t callai_ingest_size(const ContactTable *table);
+
+CALLAI_EXPORT int32_t callai_ingest_rows(const ContactTable *table);
+
+/**
+ * Gets one column. Row `i` is `data[offsets[i]]` to `data[offsets[i+1]]`
+ * (UTF-8, not terminated); `offsets` has `rows + 1` entries. Both arrays
+ * belong to the table.
+ *
+ * @param[in] column `CALLAI_INGEST_NAME` or `CALLAI_INGEST_PHONE`.
+ * @param[out] offsets Receives the offset array.
+ * @return The column data.
+ */
+CALLAI_EXPORT const uint8_t *callai_ingest_column(const ContactTable *table, int32_t column,
+                                                  const uint32_t **offsets);
+
+CALLAI_EXPORT void callai_ingest_close(ContactTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,256 @@
+#include "phone_index.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct PhoneSet {
+    uint64_t *slots;
+    uint64_t mask;
+    int64_t size;
+};
+
+namespace {
+
+const int kMinDigits = 8;
+const int kMaxDigits = 15;
+const int kNationalDigits = 10;
+const int kValueBits = 56;
+
+const char kMagic[8] = {'C', 'A', 'P', 'H', 'O', 'N', 'E', '1'};
+
+/* splitmix64 finalizer; keys are dense decimal values, so the low bits need
+   mixing before masking. */
+inline uint64_t hash_key(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+
+uint64_t capacity_for(int64_t count) {
+    uint64_t cap = 16;
+    /* Linear probing stays short below half load. */
+    while (cap < static_cast<uint64_t>(count) * 2) cap <<= 1;
+    return cap;
+}
+
+/* Inserts into a table known to have room. */
+int insert_slot(uint64_t *slots, uint64_t mask, uint64_t key) {
+    uint64_t i = hash_key(key) & mask;
+    while (slots[i] != 0) {
+        if (slots[i] == key) return 0;
+        i = (i + 1) & mask;
+    }
+    slots[i] = key;
+    return 1;
+}
+
+bool reserve(PhoneSet *set, int64_t count) {
+    uint64_t cap = capacity_for(count);
+    uint64_t old_cap = set->mask + 1;
+    uint64_t *slots;
+    if (cap <= old_cap) return true;
+    slots = static_cast<uint64_t *>(calloc(cap, sizeof(uint64_t)));
+    if (slots == NULL) return false;
+    for (uint64_t i = 0; i < old_cap; i++) {
+        if (set->slots[i] != 0) insert_slot(slots, cap - 1, set->slots[i]);
+    }
+    free(set->slots);
+    set->slots = slots;
+    set->mask = cap - 1;
+    return true;
+}
+
+}  // namespace
+
+uint64_t callai_phone_normalize(const char *raw, int32_t len, int32_t default_cc) {
+    char digits[kMaxDigits + 8];
+    char cc[8];
+    const char *end = raw + len;
+    const char *d;
+    int n = 0, cc_len = 0, prefix = 0;
+    bool international = false;
+    uint64_t value = 0;
+
+    while (end > raw && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    if (end - raw >= 2 && end[-2] == '.' && end[-1] == '0') end -= 2;
+    for (const char *c = raw; c < end; c++) {
+        if (*c >= '0' && *c <= '9') {
+            if (n == static_cast<int>(sizeof(digits))) return CALLAI_PHONE_INVALID;
+            digits[n++] = *c;
+        } else if (*c == '+' && n == 0) {
+            international = true;
+        }
+    }
+    d = digits;
+    if (!international && n >= 2 && d[0] == '0' && d[1] == '0') {
+        international = true;
+        d += 2;
+        n -= 2;
+    }
+    if (!international) {
+        for (int v = default_cc; v > 0 && cc_len < static_cast<int>(sizeof(cc)); v /= 10) {
+            cc[cc_len++] = static_cast<char>('0' + v % 10);
+        }
+        for (int i = 0; i < cc_len / 2; i++) {
+            char t = cc[i];
+            cc[i] = cc[cc_len - 1 - i];
+            cc[cc_len - 1 - i] = t;
+        }
+        if (n > 0 && d[0] == '0') {
+            d++;
+            n--;
+        }
+        if (!(n == cc_len + kNationalDigits && memcmp(d, cc, cc_len) == 0)) prefix = cc_len;
+    }
+    if (prefix + n < kMinDigits || prefix + n > kMaxDigits) return CALLAI_PHONE_INVALID;
+    for (int i = 0; i < prefix; i++) value = value * 10 + (cc[i] - '0');
+    for (int i = 0; i < n; i++) value = value * 10 + (d[i] - '0');
+    if ((prefix > 0 ? cc[0] : d[0]) == '0') return CALLAI_PHONE_INVALID;
+    return static_cast<uint64_t>(prefix + n) << kValueBits | value;
+}
+
+int32_t callai_phone_format(uint64_t key, char *out, int32_t cap) {
+    int n = static_cast<int>(key >> kValueBits);
+    uint64_t value = key & ((1ULL << kValueBits) - 1);
+    if (n < kMinDigits || n > kMaxDigits || cap < n + 2) return 0;
+    out[0] = '+';
+    for (int i = n; i >= 1; i--) {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    out[n + 1] = 0;
+    return n + 1;
+}
+
+PhoneSet *callai_phone_set_create(int64_t expected) {
+    PhoneSet *set = static_cast<PhoneSet *>(calloc(1, sizeof(PhoneSet)));
+    uint64_t cap = capacity_for(expected);
+    if (set == NULL) return NULL;
+    set->slots = static_cast<uint64_t *>(calloc(cap, sizeof(uint64_t)));
+    if (set->slots == NULL) {
+        free(set);
+        return NULL;
+    }
+    set->mask = cap - 1;
+    return set;
+}
+
+void callai_phone_set_destroy(PhoneSet *set) {
+    if (set == NULL) return;
+    free(set->slots);
+    free(set);
+}
+
+int32_t callai_phone_set_insert(PhoneSet *set, uint64_t key) {
+    int added;
+    if (key == CALLAI_PHONE_INVALID) return 0;
+    if (!reserve(set, set->size + 1)) return -1;
+    added = insert_slot(set->slots, set->mask, key);
+    set->size += added;
+    return added;
+}
+
+int32_t callai_phone_set_contains(const PhoneSet *set, uint64_t key) {
+    uint64_t i = hash_key(key) & set->mask;
+    if (key == CALLAI_PHONE_INVALID) return 0;
+    while (set->slots[i] != 0) {
+        if (set->slots[i] == key) return 1;
+        i = (i + 1) & set->mask;
+    }
+    return 0;
+}
+
+int64_t callai_phone_set_size(const PhoneSet *set) {
+    return set->size;
+}
+
+int32_t callai_phone_set_load(PhoneSet *set, const char *path) {
+    struct stat sb;
+    const uint8_t *data;
+    uint64_t count;
+    int32_t ret = CALLAI_INGEST_OK;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return CALLAI_INGEST_OK;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        return CALLAI_INGEST_ERR_IO;
+    }
+    if (sb.st_size < 16) {
+        close(fd);
+        return CALLAI_INGEST_ERR_FORMAT;
+    }
+    data = static_cast<const uint8_t *>(mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
+    if (data == MAP_FAILED) return CALLAI_INGEST_ERR_IO;
+
+    memcpy(&count, data + 8, sizeof(count));
+    if (memcmp(data, kMagic, sizeof(kMagic)) != 0
+        || count != (static_cast<uint64_t>(sb.st_size) - 16) / sizeof(uint64_t)) {
+        ret = CALLAI_INGEST_ERR_FORMAT;
+    } else if (!reserve(set, set->size + static_cast<int64_t>(count))) {
+        ret = CALLAI_INGEST_ERR_MEMORY;
+    } else {
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t key;
+            memcpy(&key, data + 16 + i * sizeof(key), sizeof(key));
+            if (key != CALLAI_PHONE_INVALID) set->size += insert_slot(set->slots, set->mask, key);
+        }
+    }
+    munmap(const_cast<uint8_t *>(data), sb.st_size);
+    return ret;
+}
+
+int32_t callai_phone_set_save(const PhoneSet *set, const char *path) {
+    std::string tmp = std::string(path) + ".tmp";
+    uint64_t count = set->size;
+    bool ok;
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL) return CALLAI_INGEST_ERR_IO;
+    ok = fwrite(kMagic, sizeof(kMagic), 1, f) == 1 && fwrite(&count, sizeof(count), 1, f) == 1;
+    for (uint64_t i = 0; ok && i <= set->mask; i++) {
+        if (set->slots[i] != 0) ok = fwrite(&set->slots[i], sizeof(uint64_t), 1, f) == 1;
+    }
+    ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        unlink(tmp.c_str());
+        return CALLAI_INGEST_ERR_IO;
+    }
+    return CALLAI_INGEST_OK;
+}
+
+int32_t callai_phone_dedup(const ContactTable *table, const PhoneSet *called,
+                           int32_t default_cc, uint64_t *keys, uint8_t *status) {
+    const uint32_t *offsets;
+    const uint8_t *phones = callai_ingest_column(table, CALLAI_INGEST_PHONE, &offsets);
+    int32_t rows = callai_ingest_rows(table);
+    int32_t fresh = 0;
+    PhoneSet *seen = callai_phone_set_create(rows);
+    if (seen == NULL) return CALLAI_INGEST_ERR_MEMORY;
+
+    for (int32_t i = 0; i < rows; i++) {
+        uint64_t key = callai_phone_normalize(reinterpret_cast<const char *>(phones + offsets[i]),
+                                              offsets[i + 1] - offsets[i], default_cc);
+        keys[i] = key;
+        if (key == CALLAI_PHONE_INVALID) {
+            status[i] = CALLAI_PHONE_BAD;
+        } else if (called != NULL && callai_phone_set_contains(called, key)) {
+            status[i] = CALLAI_PHONE_CALLED;
+        } else if (insert_slot(seen->slots, seen->mask, key)) {
+            status[i] = CALLAI_PHONE_NEW;
+            fresh++;
+        } else {
+            status[i] = CALLAI_PHONE_DUPLICATE;
+        }
+    }
+    callai_phone_set_destroy(seen);
+    return fresh;
+}
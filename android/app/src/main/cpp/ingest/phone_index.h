@@ -0,0 +1,96 @@
+#ifndef PHONE_INDEX_H
+#define PHONE_INDEX_H
+
+#include <stdint.h>
+#include "contact_ingest.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Phone numbers are keyed by their E.164 digits packed into 64 bits: the
+    digit count in the top byte and the numeric value below it. 0 is never a
+    valid key. */
+#define CALLAI_PHONE_INVALID 0
+
+/** Statuses written by callai_phone_dedup(). */
+#define CALLAI_PHONE_NEW 0
+#define CALLAI_PHONE_DUPLICATE 1
+#define CALLAI_PHONE_CALLED 2
+#define CALLAI_PHONE_BAD 3
+
+/** Open-addressing hash set of phone keys. Lookups may run on several threads
+    at once, but nothing may read while another thread inserts. */
+typedef struct PhoneSet PhoneSet;
+
+/**
+ * Normalizes a phone number as typed or exported into an E.164 key.
+ *
+ * Spaces, dashes, brackets and a trailing ".0" from spreadsheet exports are
+ * ignored. A leading '+' or "00" means the number already has a country code.
+ * Otherwise one leading trunk '0' is dropped and the default country code is
+ * prepended, unless the number is already `default_cc` followed by a
+ * 10 digit national number.
+ *
+ * @param[in] raw Phone number (UTF-8, not necessarily terminated).
+ * @param[in] len Length of `raw` in bytes.
+ * @param[in] default_cc Country calling code for national numbers, e.g. 91.
+ * @return The key, or `CALLAI_PHONE_INVALID` if the result is not 8 to 15 digits.
+ */
+CALLAI_EXPORT uint64_t callai_phone_normalize(const char *raw, int32_t len, int32_t default_cc);
+
+/**
+ * Formats a key as "+<digits>".
+ *
+ * @param[out] out Receives the terminated string; 17 bytes are always enough.
+ * @return The string length, or 0 if the key is invalid or `cap` too small.
+ */
+CALLAI_EXPORT int32_t callai_phone_format(uint64_t key, char *out, int32_t cap);
+
+/**
+ * @param[in] expected Number of keys to size the table for; it grows as needed.
+ * @return A new set, or `NULL` if out of memory.
+ */
+CALLAI_EXPORT PhoneSet *callai_phone_set_create(int64_t expected);
+
+CALLAI_EXPORT void callai_phone_set_destroy(PhoneSet *set);
+
+/** @return 1 if the key was added, 0 if it was already there, -1 if out of memory. */
+CALLAI_EXPORT int32_t callai_phone_set_insert(PhoneSet *set, uint64_t key);
+
+CALLAI_EXPORT int32_t callai_phone_set_contains(const PhoneSet *set, uint64_t key);
+
+CALLAI_EXPORT int64_t callai_phone_set_size(const PhoneSet *set);
+
+/**
+ * Adds the keys saved by callai_phone_set_save(). A missing file is not an
+ * error.
+ *
+ * @return `CALLAI_INGEST_OK`, `CALLAI_INGEST_ERR_IO`, `CALLAI_INGEST_ERR_FORMAT`
+ *         or `CALLAI_INGEST_ERR_MEMORY`.
+ */
+CALLAI_EXPORT int32_t callai_phone_set_load(PhoneSet *set, const char *path);
+
+/** Writes the keys to a temporary file and renames it over `path`.
+    @return `CALLAI_INGEST_OK` or `CALLAI_INGEST_ERR_IO`. */
+CALLAI_EXPORT int32_t callai_phone_set_save(const PhoneSet *set, const char *path);
+
+/**
+ * Normalizes and deduplicates an imported phone column.
+ *
+ * @param[in] table Parsed contact list; its phone column is normalized.
+ * @param[in] called Numbers already called, or `NULL`.
+ * @param[in] default_cc Country calling code for national numbers.
+ * @param[out] keys Receives one key per row (`CALLAI_PHONE_INVALID` for bad numbers).
+ * @param[out] status Receives one `CALLAI_PHONE_*` status per row. Only the
+ *                    first row with a given number is `CALLAI_PHONE_NEW`.
+ * @return The number of `CALLAI_PHONE_NEW` rows, or `CALLAI_INGEST_ERR_MEMORY`.
+ */
+CALLAI_EXPORT int32_t callai_phone_dedup(const ContactTable *table, const PhoneSet *called,
+                                         int32_t default_cc, uint64_t *keys, uint8_t *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,24 +1,476 @@
 #include <jni.h>
 #include "rnnoise.h"
+#include "trace.h"
+#include "endpoint.h"
+#include "bargein.h"
+#include "jitter.h"
+#include "recorder.h"
 
-extern "C" {
+namespace {
 
-JNIEXPORT jlong JNICALL
-Java_com_shailesh_callai_RNNoise_create(JNIEnv *env, jobject thiz) {
+const char *kRNNoiseClass = "com/shailesh/callai/RNNoise";
+
+const int STATS_LONGS = 7 + RNNOISE_NB_MODES + 2 * RNNOISE_NB_STAGES + RNNOISE_STATS_BUCKETS
+                        + RNNOISE_NB_STAGES * RNNOISE_STATS_BUCKETS;
+
+/* Names for traceEvent(); the trace buffers keep the pointer until flush,
+   so events from Kotlin pick from a fixed set instead of passing strings. */
+const char *const kTraceEventNames[] = {"capture", "playback"};
+
+/* Samples recordingRead() decodes per crossing: one 100 ms block at 48 kHz. */
+const int kRecordingChunk = 4800;
+
+/* State handles processStreams() copies out of the Java array at a time. */
+const jsize kStreamChunk = 64;
+
+/* Cached at load time so the audio thread never does a class lookup. */
+jclass illegal_argument_class;
+
+void throw_illegal_argument(JNIEnv *env, const char *msg) {
+    env->ThrowNew(illegal_argument_class, msg);
+}
+
+/* Returns the address of a direct buffer holding at least `bytes` bytes.
+   GetDirectBufferCapacity counts elements, so the caller passes the element
+   size implied by the parameter type in the method signature (1 for a
+   ByteBuffer, 4 for a FloatBuffer). */
+void *direct_address(JNIEnv *env, jobject buffer, jlong bytes, jlong element_size) {
+    void *addr = buffer ? env->GetDirectBufferAddress(buffer) : NULL;
+    if (addr == NULL) {
+        throw_illegal_argument(env, "expected a direct buffer");
+        return NULL;
+    }
+    if (env->GetDirectBufferCapacity(buffer) * element_size < bytes) {
+        throw_illegal_argument(env, "buffer is too small");
+        return NULL;
+    }
+    return addr;
+}
+
+jlong create(JNIEnv *env, jobject thiz) {
     return (jlong) rnnoise_create(NULL);
 }
 
-JNIEXPORT jfloat JNICALL
-Java_com_shailesh_callai_RNNoise_processFrame(JNIEnv *env, jobject thiz, jlong state, jshortArray frame) {
-    jshort *frame_ptr = env->GetShortArrayElements(frame, NULL);
+jint frameSize(JNIEnv *env, jobject thiz) {
+    return rnnoise_get_frame_size();
+}
+
+jfloat processFrame(JNIEnv *env, jobject thiz, jlong state, jshortArray frame) {
+    if (env->GetArrayLength(frame) < rnnoise_get_frame_size()) {
+        throw_illegal_argument(env, "array is smaller than one frame");
+        return 0;
+    }
+    /* No JNI calls are made until the array is released, so the critical
+       variant can pin the array instead of copying it. */
+    jshort *frame_ptr = (jshort *) env->GetPrimitiveArrayCritical(frame, NULL);
+    if (frame_ptr == NULL)
+        return 0;
     float vad_prob = rnnoise_process_frame((DenoiseState *) state, frame_ptr, frame_ptr);
-    env->ReleaseShortArrayElements(frame, frame_ptr, 0);
+    env->ReleasePrimitiveArrayCritical(frame, frame_ptr, 0);
     return vad_prob;
 }
 
-JNIEXPORT void JNICALL
-Java_com_shailesh_callai_RNNoise_destroy(JNIEnv *env, jobject thiz, jlong state) {
+jfloat processFrameDirect(JNIEnv *env, jobject thiz, jlong state, jobject input, jobject output) {
+    jlong bytes = rnnoise_get_frame_size() * sizeof(short);
+    const short *in = (const short *) direct_address(env, input, bytes, 1);
+    if (in == NULL)
+        return 0;
+    short *out = (short *) direct_address(env, output, bytes, 1);
+    if (out == NULL)
+        return 0;
+    return rnnoise_process_frame((DenoiseState *) state, out, in);
+}
+
+/* Processes `frames` consecutive frames of one stream in a single crossing. */
+void processFrames(JNIEnv *env, jobject thiz, jlong state, jobject input, jobject output,
+                   jint frames, jobject vad) {
+    jlong bytes = (jlong) frames * rnnoise_get_frame_size() * sizeof(short);
+    const short *in = (const short *) direct_address(env, input, bytes, 1);
+    if (in == NULL)
+        return;
+    short *out = (short *) direct_address(env, output, bytes, 1);
+    if (out == NULL)
+        return;
+    float *vad_prob = (float *) direct_address(env, vad, frames * sizeof(float), sizeof(float));
+    if (vad_prob == NULL)
+        return;
+    rnnoise_process_frames((DenoiseState *) state, out, in, frames, vad_prob);
+}
+
+/* Processes one frame for each of `states`, with frames laid out stream after
+   stream in the buffers. */
+void processStreams(JNIEnv *env, jobject thiz, jlongArray states, jobject input, jobject output,
+                    jobject vad) {
+    jsize streams = env->GetArrayLength(states);
+    jlong bytes = (jlong) streams * rnnoise_get_frame_size() * sizeof(short);
+    const short *in = (const short *) direct_address(env, input, bytes, 1);
+    if (in == NULL)
+        return;
+    short *out = (short *) direct_address(env, output, bytes, 1);
+    if (out == NULL)
+        return;
+    float *vad_prob = (float *) direct_address(env, vad, streams * sizeof(float), sizeof(float));
+    if (vad_prob == NULL)
+        return;
+    /* Handles are copied out a chunk at a time rather than pinning the array
+       for all the frames; all of them are checked before any is used. */
+    jlong st[kStreamChunk];
+    for (jsize first = 0; first < streams; first += kStreamChunk) {
+        jsize n = streams - first < kStreamChunk ? streams - first : kStreamChunk;
+        env->GetLongArrayRegion(states, first, n, st);
+        for (jsize i = 0; i < n; i++) {
+            if (st[i] == 0) {
+                throw_illegal_argument(env, "state handle is 0");
+                return;
+            }
+        }
+    }
+    for (jsize first = 0; first < streams; first += kStreamChunk) {
+        jsize n = streams - first < kStreamChunk ? streams - first : kStreamChunk;
+        env->GetLongArrayRegion(states, first, n, st);
+        for (jsize i = 0; i < n; i++) {
+            jsize offset = (first + i) * rnnoise_get_frame_size();
+            vad_prob[first + i] = rnnoise_process_frame((DenoiseState *) st[i], out + offset, in + offset);
+        }
+    }
+}
+
+/* Flattens RNNoiseStats into `out`; the layout is decoded by RNNoise.Stats. */
+jboolean getStats(JNIEnv *env, jobject thiz, jlong state, jlongArray out) {
+    RNNoiseStats stats;
+    jlong raw[STATS_LONGS];
+    int n = 0;
+    if (rnnoise_get_stats((DenoiseState *) state, &stats) != 0)
+        return JNI_FALSE;
+    if (env->GetArrayLength(out) < STATS_LONGS) {
+        throw_illegal_argument(env, "stats array is too small");
+        return JNI_FALSE;
+    }
+    raw[n++] = stats.frames;
+    raw[n++] = stats.frame_ns;
+    raw[n++] = stats.frame_max_ns;
+    raw[n++] = stats.vad_frames;
+    raw[n++] = stats.rnn_frames;
+    raw[n++] = stats.interpolated_frames;
+    raw[n++] = stats.spectral_subtraction_frames;
+    for (int i = 0; i < RNNOISE_NB_MODES; i++)
+        raw[n++] = stats.mode_frames[i];
+    for (int i = 0; i < RNNOISE_NB_STAGES; i++)
+        raw[n++] = stats.stage_ns[i];
+    for (int i = 0; i < RNNOISE_NB_STAGES; i++)
+        raw[n++] = stats.stage_max_ns[i];
+    for (int i = 0; i < RNNOISE_STATS_BUCKETS; i++)
+        raw[n++] = stats.frame_hist[i];
+    for (int i = 0; i < RNNOISE_NB_STAGES; i++)
+        for (int b = 0; b < RNNOISE_STATS_BUCKETS; b++)
+            raw[n++] = stats.stage_hist[i][b];
+    env->SetLongArrayRegion(out, 0, n, raw);
+    return JNI_TRUE;
+}
+
+void resetStats(JNIEnv *env, jobject thiz, jlong state) {
+    rnnoise_reset_stats((DenoiseState *) state);
+}
+
+void setComplexity(JNIEnv *env, jobject thiz, jlong state, jint complexity) {
+    rnnoise_set_complexity((DenoiseState *) state, complexity);
+}
+
+jboolean featuresEnable(JNIEnv *env, jobject thiz, jlong state, jint nb_mels, jint nb_mfcc, jint nb_stack) {
+    return rnnoise_features_enable((DenoiseState *) state, nb_mels, nb_mfcc, nb_stack) == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+/* Wraps the native feature window without copying; the view is only valid
+   until the next frame of the state is processed. */
+jobject getFeatures(JNIEnv *env, jobject thiz, jlong state) {
+    int size;
+    const float *features = rnnoise_get_features((DenoiseState *) state, &size);
+    if (features == NULL)
+        return NULL;
+    return env->NewDirectByteBuffer((void *) features, (jlong) size * sizeof(float));
+}
+
+void agcEnable(JNIEnv *env, jobject thiz, jlong state, jfloat target_db, jfloat max_gain_db) {
+    rnnoise_agc_enable((DenoiseState *) state, target_db, max_gain_db);
+}
+
+jboolean aecEnable(JNIEnv *env, jobject thiz, jlong state, jint partitions) {
+    return rnnoise_aec_enable((DenoiseState *) state, partitions) == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+/* Takes the 16-bit PCM byte array handed to AudioTrack as-is. */
+jint pushEchoReference(JNIEnv *env, jobject thiz, jlong state, jbyteArray pcm, jint bytes, jint sample_rate) {
+    if (bytes < 0 || bytes > env->GetArrayLength(pcm)) {
+        throw_illegal_argument(env, "byte count out of range");
+        return -1;
+    }
+    jbyte *data = (jbyte *) env->GetPrimitiveArrayCritical(pcm, NULL);
+    if (data == NULL)
+        return -1;
+    int n = rnnoise_aec_push_reference((DenoiseState *) state, (const short *) data, bytes / 2, sample_rate);
+    env->ReleasePrimitiveArrayCritical(pcm, data, JNI_ABORT);
+    return n;
+}
+
+jlong endpointCreate(JNIEnv *env, jobject thiz, jint min_speech_ms, jint hangover_ms) {
+    return (jlong) rnnoise_endpoint_create(min_speech_ms, hangover_ms);
+}
+
+jint endpointUpdate(JNIEnv *env, jobject thiz, jlong endpointer, jfloat vad_prob) {
+    return rnnoise_endpoint_update((RNNoiseEndpointer *) endpointer, vad_prob);
+}
+
+void endpointReset(JNIEnv *env, jobject thiz, jlong endpointer) {
+    rnnoise_endpoint_reset((RNNoiseEndpointer *) endpointer);
+}
+
+void endpointDestroy(JNIEnv *env, jobject thiz, jlong endpointer) {
+    rnnoise_endpoint_destroy((RNNoiseEndpointer *) endpointer);
+}
+
+jlong bargeinCreate(JNIEnv *env, jobject thiz, jint min_speech_ms) {
+    return (jlong) rnnoise_bargein_create(min_speech_ms);
+}
+
+void bargeinPushReference(JNIEnv *env, jobject thiz, jlong detector, jbyteArray pcm, jint bytes, jint sample_rate) {
+    if (bytes < 0 || bytes > env->GetArrayLength(pcm)) {
+        throw_illegal_argument(env, "byte count out of range");
+        return;
+    }
+    jbyte *data = (jbyte *) env->GetPrimitiveArrayCritical(pcm, NULL);
+    if (data == NULL)
+        return;
+    rnnoise_bargein_push_reference((RNNoiseBargeIn *) detector, (const short *) data, bytes / 2, sample_rate);
+    env->ReleasePrimitiveArrayCritical(pcm, data, JNI_ABORT);
+}
+
+jint bargeinUpdate(JNIEnv *env, jobject thiz, jlong detector, jshortArray frame, jfloat vad_prob) {
+    if (env->GetArrayLength(frame) < rnnoise_get_frame_size()) {
+        throw_illegal_argument(env, "array is smaller than one frame");
+        return 0;
+    }
+    jshort *frame_ptr = (jshort *) env->GetPrimitiveArrayCritical(frame, NULL);
+    if (frame_ptr == NULL)
+        return 0;
+    int event = rnnoise_bargein_update((RNNoiseBargeIn *) detector, frame_ptr, vad_prob);
+    env->ReleasePrimitiveArrayCritical(frame, frame_ptr, JNI_ABORT);
+    return event;
+}
+
+void bargeinDestroy(JNIEnv *env, jobject thiz, jlong detector) {
+    rnnoise_bargein_destroy((RNNoiseBargeIn *) detector);
+}
+
+jlong jitterCreate(JNIEnv *env, jobject thiz, jint sample_rate, jint min_delay_ms, jint max_delay_ms) {
+    return (jlong) rnnoise_jitter_create(sample_rate, min_delay_ms, max_delay_ms);
+}
+
+jint jitterFrameSize(JNIEnv *env, jobject thiz, jlong jb) {
+    return rnnoise_jitter_frame_size((RNNoiseJitterBuffer *) jb);
+}
+
+jint jitterPut(JNIEnv *env, jobject thiz, jlong jb, jbyteArray pcm, jint bytes) {
+    if (bytes < 0 || bytes > env->GetArrayLength(pcm)) {
+        throw_illegal_argument(env, "byte count out of range");
+        return -1;
+    }
+    jbyte *data = (jbyte *) env->GetPrimitiveArrayCritical(pcm, NULL);
+    if (data == NULL)
+        return -1;
+    int n = rnnoise_jitter_put((RNNoiseJitterBuffer *) jb, (const short *) data, bytes / 2);
+    env->ReleasePrimitiveArrayCritical(pcm, data, JNI_ABORT);
+    return n;
+}
+
+jint jitterGet(JNIEnv *env, jobject thiz, jlong jb, jbyteArray pcm) {
+    if (env->GetArrayLength(pcm) < 2 * rnnoise_jitter_frame_size((RNNoiseJitterBuffer *) jb)) {
+        throw_illegal_argument(env, "array is smaller than one frame");
+        return -1;
+    }
+    jbyte *data = (jbyte *) env->GetPrimitiveArrayCritical(pcm, NULL);
+    if (data == NULL)
+        return -1;
+    int status = rnnoise_jitter_get((RNNoiseJitterBuffer *) jb, (short *) data);
+    env->ReleasePrimitiveArrayCritical(pcm, data, 0);
+    return status;
+}
+
+void jitterFlush(JNIEnv *env, jobject thiz, jlong jb) {
+    rnnoise_jitter_flush((RNNoiseJitterBuffer *) jb);
+}
+
+void jitterDestroy(JNIEnv *env, jobject thiz, jlong jb) {
+    rnnoise_jitter_destroy((RNNoiseJitterBuffer *) jb);
+}
+
+jlong recorderOpen(JNIEnv *env, jobject thiz, jstring dir, jint sample_rate) {
+    const char *d = env->GetStringUTFChars(dir, NULL);
+    if (d == NULL)
+        return 0;
+    RNNoiseRecorder *rec = rnnoise_recorder_open(d, sample_rate);
+    env->ReleaseStringUTFChars(dir, d);
+    return (jlong) rec;
+}
+
+jint recorderWrite(JNIEnv *env, jobject thiz, jlong rec, jbyteArray pcm, jint bytes) {
+    if (bytes < 0 || bytes > env->GetArrayLength(pcm)) {
+        throw_illegal_argument(env, "byte count out of range");
+        return -1;
+    }
+    jbyte *data = (jbyte *) env->GetPrimitiveArrayCritical(pcm, NULL);
+    if (data == NULL)
+        return -1;
+    int n = rnnoise_recorder_write((RNNoiseRecorder *) rec, (const short *) data, bytes / 2);
+    env->ReleasePrimitiveArrayCritical(pcm, data, JNI_ABORT);
+    return n;
+}
+
+jlong recorderDropped(JNIEnv *env, jobject thiz, jlong rec) {
+    return rnnoise_recorder_dropped((RNNoiseRecorder *) rec);
+}
+
+jboolean recorderClose(JNIEnv *env, jobject thiz, jlong rec) {
+    return rnnoise_recorder_close((RNNoiseRecorder *) rec) == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+jlong recordingOpen(JNIEnv *env, jobject thiz, jstring dir) {
+    const char *d = env->GetStringUTFChars(dir, NULL);
+    if (d == NULL)
+        return 0;
+    RNNoiseRecording *r = rnnoise_recording_open(d);
+    env->ReleaseStringUTFChars(dir, d);
+    return (jlong) r;
+}
+
+jint recordingSampleRate(JNIEnv *env, jobject thiz, jlong recording) {
+    return rnnoise_recording_sample_rate((RNNoiseRecording *) recording);
+}
+
+jlong recordingLength(JNIEnv *env, jobject thiz, jlong recording) {
+    return rnnoise_recording_length((RNNoiseRecording *) recording);
+}
+
+/* Fills `pcm` from `position` on; returns the number of samples read. Reading
+   may fault in a segment file and decodes whole blocks, so it goes through a
+   native buffer rather than holding the array pinned with GC blocked. */
+jint recordingRead(JNIEnv *env, jobject thiz, jlong recording, jlong position, jbyteArray pcm) {
+    short chunk[kRecordingChunk];
+    jsize samples = env->GetArrayLength(pcm) / 2;
+    jsize done = 0;
+    while (done < samples) {
+        int want = samples - done < kRecordingChunk ? samples - done : kRecordingChunk;
+        int n = rnnoise_recording_read((RNNoiseRecording *) recording, position + done, chunk, want);
+        if (n <= 0)
+            return done > 0 ? done : n;
+        env->SetByteArrayRegion(pcm, done * 2, n * 2, (const jbyte *) chunk);
+        done += n;
+    }
+    return done;
+}
+
+void recordingClose(JNIEnv *env, jobject thiz, jlong recording) {
+    rnnoise_recording_close((RNNoiseRecording *) recording);
+}
+
+void setStreamId(JNIEnv *env, jobject thiz, jlong state, jint stream_id) {
+    rnnoise_set_stream_id((DenoiseState *) state, (unsigned) stream_id);
+}
+
+jboolean traceStart(JNIEnv *env, jobject thiz, jstring path) {
+    const char *p = env->GetStringUTFChars(path, NULL);
+    if (p == NULL)
+        return JNI_FALSE;
+    int rc = rnnoise_trace_start(p);
+    env->ReleaseStringUTFChars(path, p);
+    return rc == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+jint traceFlush(JNIEnv *env, jobject thiz) {
+    return rnnoise_trace_flush();
+}
+
+jboolean traceStop(JNIEnv *env, jobject thiz) {
+    return rnnoise_trace_stop() == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+void traceEvent(JNIEnv *env, jobject thiz, jint kind, jint stream_id, jlong seq, jlong start_ns, jlong dur_ns) {
+    if (kind < 0 || kind >= (jint) (sizeof(kTraceEventNames) / sizeof(kTraceEventNames[0]))) {
+        throw_illegal_argument(env, "unknown trace event kind");
+        return;
+    }
+    rnnoise_trace_event(kTraceEventNames[kind], (unsigned) stream_id, (unsigned long long) seq, start_ns, dur_ns);
+}
+
+void destroy(JNIEnv *env, jobject thiz, jlong state) {
     rnnoise_destroy((DenoiseState *) state);
 }
 
-} 
\ No newline at end of file
+const JNINativeMethod kMethods[] = {
+    {"create", "()J", (void *) create},
+    {"frameSize", "()I", (void *) frameSize},
+    {"processFrame", "(J[S)F", (void *) processFrame},
+    {"processFrameDirect", "(JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)F", (void *) processFrameDirect},
+    {"processFrames", "(JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;ILjava/nio/FloatBuffer;)V", (void *) processFrames},
+    {"processStreams", "([JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/FloatBuffer;)V", (void *) processStreams},
+    {"getStats", "(J[J)Z", (void *) getStats},
+    {"resetStats", "(J)V", (void *) resetStats},
+    {"setComplexity", "(JI)V", (void *) setComplexity},
+    {"featuresEnable", "(JIII)Z", (void *) featuresEnable},
+    {"getFeatures", "(J)Ljava/nio/ByteBuffer;", (void *) getFeatures},
+    {"agcEnable", "(JFF)V", (void *) agcEnable},
+    {"aecEnable", "(JI)Z", (void *) aecEnable},
+    {"pushEchoReference", "(J[BII)I", (void *) pushEchoReference},
+    {"endpointCreate", "(II)J", (void *) endpointCreate},
+    {"endpointUpdate", "(JF)I", (void *) endpointUpdate},
+    {"endpointReset", "(J)V", (void *) endpointReset},
+    {"endpointDestroy", "(J)V", (void *) endpointDestroy},
+    {"bargeinCreate", "(I)J", (void *) bargeinCreate},
+    {"bargeinPushReference", "(J[BII)V", (void *) bargeinPushReference},
+    {"bargeinUpdate", "(J[SF)I", (void *) bargeinUpdate},
+    {"bargeinDestroy", "(J)V", (void *) bargeinDestroy},
+    {"jitterCreate", "(III)J", (void *) jitterCreate},
+    {"jitterFrameSize", "(J)I", (void *) jitterFrameSize},
+    {"jitterPut", "(J[BI)I", (void *) jitterPut},
+    {"jitterGet", "(J[B)I", (void *) jitterGet},
+    {"jitterFlush", "(J)V", (void *) jitterFlush},
+    {"jitterDestroy", "(J)V", (void *) jitterDestroy},
+    {"recorderOpen", "(Ljava/lang/String;I)J", (void *) recorderOpen},
+    {"recorderWrite", "(J[BI)I", (void *) recorderWrite},
+    {"recorderDropped", "(J)J", (void *) recorderDropped},
+    {"recorderClose", "(J)Z", (void *) recorderClose},
+    {"recordingOpen", "(Ljava/lang/String;)J", (void *) recordingOpen},
+    {"recordingSampleRate", "(J)I", (void *) recordingSampleRate},
+    {"recordingLength", "(J)J", (void *) recordingLength},
+    {"recordingRead", "(JJ[B)I", (void *) recordingRead},
+    {"recordingClose", "(J)V", (void *) recordingClose},
+    {"setStreamId", "(JI)V", (void *) setStreamId},
+    {"traceStart", "(Ljava/lang/String;)Z", (void *) traceStart},
+    {"traceFlush", "()I", (void *) traceFlush},
+    {"traceStop", "()Z", (void *) traceStop},
+    {"traceEvent", "(IIJJJ)V", (void *) traceEvent},
+    {"destroy", "(J)V", (void *) destroy},
+};
+
+}
+
+extern "C" JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env;
+    if (vm->GetEnv((void **) &env, JNI_VERSION_1_6) != JNI_OK)
+        return JNI_ERR;
+
+    jclass exception = env->FindClass("java/lang/IllegalArgumentException");
+    if (exception == NULL)
+        return JNI_ERR;
+    illegal_argument_class = (jclass) env->NewGlobalRef(exception);
+    env->DeleteLocalRef(exception);
+
+    jclass clazz = env->FindClass(kRNNoiseClass);
+    if (clazz == NULL)
+        return JNI_ERR;
+    jint rc = env->RegisterNatives(clazz, kMethods, sizeof(kMethods) / sizeof(kMethods[0]));
+    env->DeleteLocalRef(clazz);
+    if (rc != JNI_OK)
+        return JNI_ERR;
+    return JNI_VERSION_1_6;
+}
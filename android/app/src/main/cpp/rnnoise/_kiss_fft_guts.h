@@ -20,7 +20,11 @@ struct kiss_fft_state{
     int nfft;
     int inverse;
     int factors[2*MAXFACTORS];
-    kiss_fft_cpx twiddles[1];
+#ifdef FIXED_POINT
+    /* 1/nfft in Q31, applied by the inverse transform. */
+    opus_val32 inv_nfft;
+#endif
+    kiss_twiddle_cpx twiddles[1];
 };
 
 void kf_work(kiss_fft_cpx *fout, const kiss_fft_cpx *fin, const size_t fstride, int in_stride, int *factors, const kiss_fft_cfg st); 
\ No newline at end of file
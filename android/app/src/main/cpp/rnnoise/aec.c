@@ -0,0 +1,145 @@
+#include "aec.h"
+#include "arch.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Only the non-negative bins are adapted; the rest follow by symmetry. */
+#define NB_BINS (FRAME_SIZE/2 + 1)
+
+/* Reference queue length in samples (2.7 s). A power of two, so the free
+   running head and tail counters stay consistent when they wrap. */
+#define REF_CAPACITY (1<<17)
+
+/* Normalized step size of the frequency-domain NLMS update. */
+#define AEC_MU .3f
+/* Smoothing of the per-bin reference power used for normalization. */
+#define POWER_SMOOTH .9f
+/* Regularization of the normalization, relative to a full-scale bin. */
+#define POWER_FLOOR 1e3f
+
+struct EchoCanceller {
+    int nb_partitions;
+    /* Index of the newest reference spectrum in ref. */
+    int pos;
+    kiss_fft_cpx *weights;
+    kiss_fft_cpx *ref;
+    float power[NB_BINS];
+    /* Single-producer/single-consumer sample queue. */
+    unsigned head;
+    unsigned tail;
+    short queue[REF_CAPACITY];
+};
+
+EchoCanceller *aec_create(int nb_partitions) {
+    EchoCanceller *aec;
+    if (nb_partitions <= 0) return NULL;
+    aec = calloc(1, sizeof(*aec));
+    if (!aec) return NULL;
+    aec->nb_partitions = nb_partitions;
+    aec->weights = calloc(nb_partitions*NB_BINS, sizeof(*aec->weights));
+    aec->ref = calloc(nb_partitions*NB_BINS, sizeof(*aec->ref));
+    if (!aec->weights || !aec->ref) {
+        aec_destroy(aec);
+        return NULL;
+    }
+    return aec;
+}
+
+void aec_destroy(EchoCanceller *aec) {
+    if (!aec) return;
+    free(aec->weights);
+    free(aec->ref);
+    free(aec);
+}
+
+int aec_memory(const EchoCanceller *aec) {
+    if (!aec) return 0;
+    return (int)(sizeof(*aec) + 2*aec->nb_partitions*NB_BINS*sizeof(kiss_fft_cpx));
+}
+
+int aec_push_reference(EchoCanceller *aec, const short *pcm, int nb_samples) {
+    int i;
+    unsigned head = aec->head;
+    unsigned tail = __atomic_load_n(&aec->tail, __ATOMIC_ACQUIRE);
+    int room = REF_CAPACITY - (int)(head - tail);
+    nb_samples = OPUS_MIN32(nb_samples, room);
+    for (i=0;i<nb_samples;i++)
+        aec->queue[(head + i) & (REF_CAPACITY-1)] = pcm[i];
+    __atomic_store_n(&aec->head, head + nb_samples, __ATOMIC_RELEASE);
+    return nb_samples;
+}
+
+/* Pops one frame of reference, or silence if playback has not kept up. */
+static void pop_reference(EchoCanceller *aec, float *x) {
+    int i;
+    unsigned tail = aec->tail;
+    unsigned head = __atomic_load_n(&aec->head, __ATOMIC_ACQUIRE);
+    if (head - tail < FRAME_SIZE) {
+        memset(x, 0, FRAME_SIZE*sizeof(*x));
+        return;
+    }
+    for (i=0;i<FRAME_SIZE;i++)
+        x[i] = aec->queue[(tail + i) & (REF_CAPACITY-1)];
+    __atomic_store_n(&aec->tail, tail + FRAME_SIZE, __ATOMIC_RELEASE);
+}
+
+void aec_skip(EchoCanceller *aec) {
+    float r[FRAME_SIZE];
+    pop_reference(aec, r);
+}
+
+void aec_process(EchoCanceller *aec, kiss_fft_cpx *X) {
+    int i, p;
+    float r[FRAME_SIZE];
+    kiss_fft_cpx R[FRAME_SIZE];
+    kiss_fft_cpx E[NB_BINS];
+    float Ex = 0, Ee = 0;
+    int P = aec->nb_partitions;
+
+    pop_reference(aec, r);
+    apply_window(r);
+    forward_transform(R, r);
+    aec->pos = (aec->pos + 1) % P;
+    RNN_COPY(&aec->ref[aec->pos*NB_BINS], R, NB_BINS);
+
+    /* Echo estimate and error, summed over the partitions (newest first). */
+    for (i=0;i<NB_BINS;i++) {
+        float yr = 0, yi = 0;
+        for (p=0;p<P;p++) {
+            const kiss_fft_cpx *w = &aec->weights[p*NB_BINS + i];
+            const kiss_fft_cpx *ref = &aec->ref[((aec->pos - p + P) % P)*NB_BINS + i];
+            yr += w->r*ref->r - w->i*ref->i;
+            yi += w->r*ref->i + w->i*ref->r;
+        }
+        E[i].r = X[i].r - yr;
+        E[i].i = X[i].i - yi;
+        Ex += X[i].r*X[i].r + X[i].i*X[i].i;
+        Ee += E[i].r*E[i].r + E[i].i*E[i].i;
+        aec->power[i] = POWER_SMOOTH*aec->power[i] + (1-POWER_SMOOTH)*(R[i].r*R[i].r + R[i].i*R[i].i);
+    }
+
+    /* A filter that adds energy has diverged (or the far end went silent
+       during double talk): pass the microphone through and shrink it. */
+    if (Ee > Ex) {
+        for (i=0;i<P*NB_BINS;i++) {
+            aec->weights[i].r *= .5f;
+            aec->weights[i].i *= .5f;
+        }
+        return;
+    }
+
+    for (i=0;i<NB_BINS;i++) {
+        float mu = AEC_MU/(P*aec->power[i] + POWER_FLOOR);
+        for (p=0;p<P;p++) {
+            kiss_fft_cpx *w = &aec->weights[p*NB_BINS + i];
+            const kiss_fft_cpx *ref = &aec->ref[((aec->pos - p + P) % P)*NB_BINS + i];
+            w->r += mu*(E[i].r*ref->r + E[i].i*ref->i);
+            w->i += mu*(E[i].i*ref->r - E[i].r*ref->i);
+        }
+        X[i] = E[i];
+        if (i != 0 && i != FRAME_SIZE/2) {
+            X[FRAME_SIZE-i].r = E[i].r;
+            X[FRAME_SIZE-i].i = -E[i].i;
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef AEC_H
+#define AEC_H
+
+#include "common.h"
+
+/* Partitioned-block frequency-domain echo canceller working on the frame
+   spectra of the denoiser. The playback reference is queued from the
+   playback thread and consumed one frame per processed microphone frame. */
+typedef struct EchoCanceller EchoCanceller;
+
+#ifdef FIXED_POINT
+/* The adaptive filters are float-only; aec.c is left out of the fixed-point
+   build and rnnoise_aec_enable() fails there. */
+#define aec_create(nb_partitions) ((EchoCanceller*)NULL)
+#define aec_destroy(aec) ((void)(aec))
+#define aec_memory(aec) 0
+#define aec_push_reference(aec, pcm, nb_samples) ((void)(aec), (void)(pcm), (void)(nb_samples), -1)
+#define aec_skip(aec) ((void)(aec))
+#define aec_process(aec, X) ((void)(aec))
+#else
+EchoCanceller *aec_create(int nb_partitions);
+
+void aec_destroy(EchoCanceller *aec);
+
+/* Bytes owned by aec. */
+int aec_memory(const EchoCanceller *aec);
+
+/* Queues reference samples at 48 kHz; returns the number accepted. Safe to
+   call from one thread concurrently with aec_process(). */
+int aec_push_reference(EchoCanceller *aec, const short *pcm, int nb_samples);
+
+/* Consumes one frame of reference without processing, for frames that
+   bypass the transform, so that the reference stays aligned. */
+void aec_skip(EchoCanceller *aec);
+
+/* Removes the echo estimate from the microphone spectrum X in place. */
+void aec_process(EchoCanceller *aec, kiss_fft_cpx *X);
+#endif
+
+#endif
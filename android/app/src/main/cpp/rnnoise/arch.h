@@ -62,4 +62,69 @@
 
 #define SATURATE16(x) (OPUS_CLAMP16(x, -32768, 32767))
 
+#ifdef FIXED_POINT
+
+typedef short opus_int16;
+typedef int opus_int32;
+typedef unsigned opus_uint32;
+typedef long long opus_int64;
+
+/* 16-bit samples and coefficients, 32-bit accumulators. */
+typedef opus_int16 opus_val16;
+typedef opus_int32 opus_val32;
+typedef opus_int64 opus_val64;
+
+#define QCONST16(x, bits) ((opus_val16)(.5 + (x)*(((opus_val32)1) << (bits))))
+#define QCONST32(x, bits) ((opus_val32)(.5 + (x)*(((opus_val64)1) << (bits))))
+
+#define EXTEND32(x) ((opus_val32)(x))
+#define EXTRACT16(x) ((opus_val16)(x))
+
+#define SHR32(a, shift) ((a) >> (shift))
+#define SHL32(a, shift) ((opus_int32)((opus_uint32)(a) << (shift)))
+#define PSHR32(a, shift) (SHR32((a) + ((EXTEND32(1) << (shift)) >> 1), shift))
+#define VSHR32(a, shift) (((shift) > 0) ? SHR32(a, shift) : SHL32(a, -(shift)))
+#define SHR64(a, shift) ((a) >> (shift))
+#define PSHR64(a, shift) (SHR64((a) + (((opus_val64)1 << (shift)) >> 1), shift))
+
+#define ADD32(a, b) ((opus_val32)(a) + (opus_val32)(b))
+
+#define MULT16_16(a, b) ((opus_val32)(opus_val16)(a)*(opus_val32)(opus_val16)(b))
+#define MAC16_16(c, a, b) (ADD32((c), MULT16_16((a), (b))))
+#define MULT16_32(a, b) ((opus_val64)(opus_val16)(a)*(opus_val64)(b))
+#define MULT32_32(a, b) ((opus_val64)(a)*(opus_val64)(b))
+#define MULT16_32_Q15(a, b) ((opus_val32)SHR64(MULT16_32((a), (b)), 15))
+
+/* Number of bits needed to hold x > 0. */
+#define EC_ILOG(x) (32 - __builtin_clz(x))
+
+#else
+
+typedef float opus_val16;
+typedef float opus_val32;
+typedef float opus_val64;
+
+#define QCONST16(x, bits) (x)
+#define QCONST32(x, bits) (x)
+
+#define EXTEND32(x) (x)
+#define EXTRACT16(x) (x)
+
+#define SHR32(a, shift) (a)
+#define SHL32(a, shift) (a)
+#define PSHR32(a, shift) (a)
+#define VSHR32(a, shift) (a)
+#define SHR64(a, shift) (a)
+#define PSHR64(a, shift) (a)
+
+#define ADD32(a, b) ((a) + (b))
+
+#define MULT16_16(a, b) ((opus_val32)(a)*(opus_val32)(b))
+#define MAC16_16(c, a, b) ((c) + (opus_val32)(a)*(opus_val32)(b))
+#define MULT16_32(a, b) ((a)*(b))
+#define MULT32_32(a, b) ((a)*(b))
+#define MULT16_32_Q15(a, b) ((a)*(b))
+
+#endif
+
 #endif 
\ No newline at end of file
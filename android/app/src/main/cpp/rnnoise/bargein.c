@@ -0,0 +1,94 @@
+#include "bargein.h"
+#include "arch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FRAME_SIZE 480
+#define FRAME_MS 10
+
+/* Playback keeps counting as active for this long after the last pushed
+   sample should have played, to cover the output buffer and echo tail. */
+#define PLAYBACK_TAIL_NS 200000000LL
+#define VAD_THRESHOLD .6f
+/* Microphone energy must exceed the expected echo by this factor (6 dB). */
+#define ECHO_MARGIN 4.f
+/* Echo coupling (microphone over playback energy) tracking: quick to follow
+   decreases, slow to follow increases so that a caller talking does not
+   immediately raise the bar for detecting them. */
+#define COUPLING_UP .02f
+#define COUPLING_DOWN .2f
+#define COUPLING_INIT 1.f
+#define ENERGY_FLOOR 1.f
+
+struct RNNoiseBargeIn {
+    int min_speech_frames;
+    int speech_frames;
+    int fired;
+    float coupling;
+    /* Written by the playback thread. */
+    float ref_energy;
+    long long playing_until;
+};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static float frame_energy(const short *pcm, int n) {
+    int i;
+    float E = 0;
+    for (i=0;i<n;i++)
+        E += (float)pcm[i]*pcm[i];
+    return n > 0 ? E/n : 0;
+}
+
+RNNoiseBargeIn *rnnoise_bargein_create(int min_speech_ms) {
+    RNNoiseBargeIn *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->min_speech_frames = OPUS_MAX32(1, (min_speech_ms + FRAME_MS - 1)/FRAME_MS);
+    b->coupling = COUPLING_INIT;
+    return b;
+}
+
+void rnnoise_bargein_destroy(RNNoiseBargeIn *b) {
+    free(b);
+}
+
+void rnnoise_bargein_push_reference(RNNoiseBargeIn *b, const short *pcm, int nb_samples, int sample_rate) {
+    long long now = now_ns();
+    long long until = __atomic_load_n(&b->playing_until, __ATOMIC_RELAXED);
+    float E = frame_energy(pcm, nb_samples);
+    if (sample_rate <= 0) return;
+    /* Chunks queue behind each other in the output buffer. */
+    until = OPUS_MAX32(until, now) + (long long)nb_samples*1000000000LL/sample_rate;
+    __atomic_store(&b->ref_energy, &E, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->playing_until, until, __ATOMIC_RELEASE);
+}
+
+int rnnoise_bargein_update(RNNoiseBargeIn *b, const short *frame, float vad_prob) {
+    float mic, ref, ratio;
+    long long until = __atomic_load_n(&b->playing_until, __ATOMIC_ACQUIRE);
+    if (now_ns() > until + PLAYBACK_TAIL_NS) {
+        /* Nothing playing: re-arm for the next response. */
+        b->speech_frames = 0;
+        b->fired = 0;
+        return RNNOISE_EVENT_NONE;
+    }
+    __atomic_load(&b->ref_energy, &ref, __ATOMIC_RELAXED);
+    mic = frame_energy(frame, FRAME_SIZE);
+    ratio = mic/(ref + ENERGY_FLOOR);
+    if (vad_prob >= VAD_THRESHOLD && ratio > ECHO_MARGIN*b->coupling) {
+        if (++b->speech_frames >= b->min_speech_frames && !b->fired) {
+            b->fired = 1;
+            return RNNOISE_EVENT_BARGE_IN;
+        }
+        return RNNOISE_EVENT_NONE;
+    }
+    b->speech_frames = 0;
+    if (ref > ENERGY_FLOOR)
+        b->coupling += (ratio < b->coupling ? COUPLING_DOWN : COUPLING_UP)*(ratio - b->coupling);
+    return RNNOISE_EVENT_NONE;
+}
@@ -0,0 +1,56 @@
+#ifndef BARGEIN_H
+#define BARGEIN_H
+
+#include "rnnoise.h"
+#include "endpoint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Detects the caller talking over playback. Each denoised microphone frame
+    is compared against the energy of the audio being played, so that echo of
+    the playback (which the VAD also sees as speech) is not mistaken for the
+    caller. */
+typedef struct RNNoiseBargeIn RNNoiseBargeIn;
+
+/** Returned by rnnoise_bargein_update(); numbered after the events of
+    endpoint.h so both can share one callback. */
+#define RNNOISE_EVENT_BARGE_IN 3
+
+/**
+ * Creates a barge-in detector.
+ *
+ * @param[in] min_speech_ms Caller speech needed before an interruption is
+ *                          reported.
+ * @return A detector, or `NULL` on allocation failure.
+ */
+RNNOISE_EXPORT RNNoiseBargeIn *rnnoise_bargein_create(int min_speech_ms);
+
+RNNOISE_EXPORT void rnnoise_bargein_destroy(RNNoiseBargeIn *b);
+
+/**
+ * Reports audio handed to the playback device. May be called from the
+ * playback thread while another thread calls rnnoise_bargein_update().
+ *
+ * @param[in] pcm Playback samples.
+ * @param[in] nb_samples Number of samples.
+ * @param[in] sample_rate Rate of `pcm`, used to time how long it plays.
+ */
+RNNOISE_EXPORT void rnnoise_bargein_push_reference(RNNoiseBargeIn *b, const short *pcm, int nb_samples, int sample_rate);
+
+/**
+ * Advances by one microphone frame.
+ *
+ * @param[in] frame The denoised frame (`rnnoise_get_frame_size()` samples).
+ * @param[in] vad_prob Its voice activity probability.
+ * @return `RNNOISE_EVENT_BARGE_IN` on the frame the caller is detected
+ *         talking over playback, otherwise `RNNOISE_EVENT_NONE` (0).
+ */
+RNNOISE_EXPORT int rnnoise_bargein_update(RNNoiseBargeIn *b, const short *frame, float vad_prob);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,45 +1,155 @@
 #include "common.h"
 #include "kiss_fft.h"
 #include <math.h>
+#include <pthread.h>
 
+/* Read-only tables shared by every stream, set up on first use. */
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
 static kiss_fft_cfg fft_forward;
 static kiss_fft_cfg fft_inverse;
+#ifndef FIXED_POINT
+static float window[FRAME_SIZE];
+#endif
 
-void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
+static void init_tables(void) {
+    fft_forward = kiss_fft_alloc(FRAME_SIZE, 0, NULL, NULL);
+    fft_inverse = kiss_fft_alloc(FRAME_SIZE, 1, NULL, NULL);
+#ifndef FIXED_POINT
+    {
+        int i;
+        for (i = 0; i < FRAME_SIZE; i++) {
+            window[i] = 0.5f * (1.0f - cosf((2.0f * M_PI * i) / (FRAME_SIZE - 1)));
+        }
+    }
+#endif
+}
+
+#ifdef FIXED_POINT
+/* Block scaling targets: the forward input stays below 2^31/FRAME_SIZE so
+   the transform cannot overflow, and the inverse input uses 30 bits. */
+#define FORWARD_PEAK_BITS 22
+#define INVERSE_PEAK_BITS 30
+
+/* apply_window()'s Hann window in Q15. */
+static const opus_val16 window_q15[FRAME_SIZE] = {
+    0, 1, 6, 13, 23, 35, 51, 69, 90, 114, 141, 170,
+    203, 238, 275, 316, 360, 406, 455, 506, 561, 618, 677, 740,
+    805, 873, 944, 1017, 1093, 1171, 1252, 1336, 1422, 1511, 1603, 1697,
+    1793, 1892, 1994, 2098, 2204, 2313, 2424, 2538, 2654, 2772, 2893, 3016,
+    3142, 3269, 3399, 3532, 3666, 3802, 3941, 4082, 4225, 4370, 4517, 4667,
+    4818, 4971, 5126, 5283, 5442, 5603, 5766, 5931, 6097, 6265, 6435, 6607,
+    6780, 6955, 7131, 7309, 7489, 7670, 7853, 8037, 8223, 8410, 8599, 8788,
+    8979, 9172, 9365, 9560, 9756, 9953, 10151, 10351, 10551, 10752, 10955, 11158,
+    11362, 11567, 11773, 11979, 12187, 12395, 12604, 12813, 13023, 13234, 13445, 13657,
+    13869, 14081, 14294, 14508, 14721, 14935, 15149, 15364, 15578, 15793, 16008, 16223,
+    16438, 16653, 16867, 17082, 17297, 17511, 17726, 17940, 18154, 18367, 18580, 18793,
+    19005, 19217, 19429, 19640, 19850, 20060, 20269, 20477, 20685, 20892, 21098, 21304,
+    21508, 21712, 21915, 22116, 22317, 22517, 22716, 22914, 23110, 23305, 23500, 23693,
+    23884, 24075, 24264, 24452, 24638, 24823, 25006, 25188, 25369, 25548, 25725, 25901,
+    26075, 26247, 26418, 26587, 26755, 26920, 27084, 27246, 27405, 27564, 27720, 27874,
+    28026, 28176, 28324, 28471, 28615, 28757, 28896, 29034, 29170, 29303, 29434, 29563,
+    29689, 29814, 29935, 30055, 30172, 30287, 30400, 30510, 30618, 30723, 30825, 30926,
+    31023, 31119, 31211, 31302, 31389, 31474, 31557, 31636, 31714, 31788, 31860, 31929,
+    31996, 32060, 32121, 32179, 32235, 32288, 32338, 32386, 32431, 32473, 32512, 32548,
+    32582, 32613, 32641, 32666, 32689, 32708, 32725, 32739, 32751, 32759, 32765, 32767,
+    32767, 32765, 32759, 32751, 32739, 32725, 32708, 32689, 32666, 32641, 32613, 32582,
+    32548, 32512, 32473, 32431, 32386, 32338, 32288, 32235, 32179, 32121, 32060, 31996,
+    31929, 31860, 31788, 31714, 31636, 31557, 31474, 31389, 31302, 31211, 31119, 31023,
+    30926, 30825, 30723, 30618, 30510, 30400, 30287, 30172, 30055, 29935, 29814, 29689,
+    29563, 29434, 29303, 29170, 29034, 28896, 28757, 28615, 28471, 28324, 28176, 28026,
+    27874, 27720, 27564, 27405, 27246, 27084, 26920, 26755, 26587, 26418, 26247, 26075,
+    25901, 25725, 25548, 25369, 25188, 25006, 24823, 24638, 24452, 24264, 24075, 23884,
+    23693, 23500, 23305, 23110, 22914, 22716, 22517, 22317, 22116, 21915, 21712, 21508,
+    21304, 21098, 20892, 20685, 20477, 20269, 20060, 19850, 19640, 19429, 19217, 19005,
+    18793, 18580, 18367, 18154, 17940, 17726, 17511, 17297, 17082, 16867, 16653, 16438,
+    16223, 16008, 15793, 15578, 15364, 15149, 14935, 14721, 14508, 14294, 14081, 13869,
+    13657, 13445, 13234, 13023, 12813, 12604, 12395, 12187, 11979, 11773, 11567, 11362,
+    11158, 10955, 10752, 10551, 10351, 10151, 9953, 9756, 9560, 9365, 9172, 8979,
+    8788, 8599, 8410, 8223, 8037, 7853, 7670, 7489, 7309, 7131, 6955, 6780,
+    6607, 6435, 6265, 6097, 5931, 5766, 5603, 5442, 5283, 5126, 4971, 4818,
+    4667, 4517, 4370, 4225, 4082, 3941, 3802, 3666, 3532, 3399, 3269, 3142,
+    3016, 2893, 2772, 2654, 2538, 2424, 2313, 2204, 2098, 1994, 1892, 1793,
+    1697, 1603, 1511, 1422, 1336, 1252, 1171, 1093, 1017, 944, 873, 805,
+    740, 677, 618, 561, 506, 455, 406, 360, 316, 275, 238, 203,
+    170, 141, 114, 90, 69, 51, 35, 23, 13, 6, 1, 0
+};
+
+/* Shift that brings the largest magnitude in x to the given number of bits. */
+static int block_shift(const opus_val32 *x, int n, int bits) {
     int i;
+    opus_val32 maxabs = 0;
+    for (i = 0; i < n; i++) {
+        maxabs = OPUS_MAX32(maxabs, x[i] < 0 ? -(x[i] + 1) : x[i]);
+    }
+    return maxabs == 0 ? 0 : bits - EC_ILOG(maxabs);
+}
+#endif
+
+void compute_band_energy(float *bandE, const kiss_fft_cpx *X, int shift) {
+    int i;
+    float scale = SPECTRUM_SCALE(shift);
     for (i = 0; i < NB_BANDS; i++) {
-        bandE[i] = X[i].r * X[i].r + X[i].i * X[i].i;
+        bandE[i] = bin_energy(X[i], scale);
     }
 }
 
-void apply_window(float *x) {
+void apply_window(opus_val32 *x) {
     int i;
+#ifdef FIXED_POINT
+    for (i = 0; i < FRAME_SIZE; i++) {
+        x[i] = MULT16_16(EXTRACT16(x[i]), window_q15[i]);
+    }
+#else
+    pthread_once(&tables_once, init_tables);
     for (i = 0; i < FRAME_SIZE; i++) {
-        x[i] *= 0.5f * (1.0f - cosf((2.0f * M_PI * i) / (FRAME_SIZE - 1)));
+        x[i] *= window[i];
     }
+#endif
 }
 
-void forward_transform(kiss_fft_cpx *X, const float *x) {
-    if (!fft_forward) {
-        fft_forward = kiss_fft_alloc(FRAME_SIZE, 0, NULL, NULL);
-    }
+int forward_transform(kiss_fft_cpx *X, const opus_val32 *x) {
+    pthread_once(&tables_once, init_tables);
     kiss_fft_cpx in[FRAME_SIZE];
     int i;
+#ifdef FIXED_POINT
+    int shift = block_shift(x, FRAME_SIZE, FORWARD_PEAK_BITS);
+    for (i = 0; i < FRAME_SIZE; i++) {
+        in[i].r = VSHR32(x[i], -shift);
+        in[i].i = 0;
+    }
+    kiss_fft(fft_forward, in, X);
+    return WINDOW_SHIFT + shift;
+#else
     for (i = 0; i < FRAME_SIZE; i++) {
         in[i].r = x[i];
         in[i].i = 0;
     }
     kiss_fft(fft_forward, in, X);
+    return 0;
+#endif
 }
 
-void inverse_transform(float *x, const kiss_fft_cpx *X) {
-    if (!fft_inverse) {
-        fft_inverse = kiss_fft_alloc(FRAME_SIZE, 1, NULL, NULL);
-    }
+void inverse_transform(opus_val32 *x, const kiss_fft_cpx *X, int shift) {
+    pthread_once(&tables_once, init_tables);
     kiss_fft_cpx out[FRAME_SIZE];
-    kiss_fft(fft_inverse, X, out);
     int i;
+#ifdef FIXED_POINT
+    kiss_fft_cpx in[FRAME_SIZE];
+    int norm = block_shift(&X[0].r, 2*FRAME_SIZE, INVERSE_PEAK_BITS);
     for (i = 0; i < FRAME_SIZE; i++) {
-        x[i] = out[i].r / FRAME_SIZE;
+        in[i].r = VSHR32(X[i].r, -norm);
+        in[i].i = VSHR32(X[i].i, -norm);
     }
-} 
\ No newline at end of file
+    kiss_fft(fft_inverse, in, out);
+    shift += norm;
+    for (i = 0; i < FRAME_SIZE; i++) {
+        x[i] = shift > 0 ? PSHR32(out[i].r, shift) : SHL32(out[i].r, -shift);
+    }
+#else
+    (void)shift;
+    kiss_fft(fft_inverse, X, out);
+    for (i = 0; i < FRAME_SIZE; i++) {
+        x[i] = out[i].r;
+    }
+#endif
+}
@@ -30,6 +30,7 @@
 #include "arch.h"
 #include "rnn.h"
 #include "kiss_fft.h"
+#include "rnnoise.h"
 
 #define FRAME_SIZE 480
 #define NB_BANDS 22
@@ -47,21 +48,87 @@
 #define LP_GAIN .99f
 #define HP_GAIN .9f
 
+/* Cache line size assumed for the layout of per-stream state. */
+#define CACHE_LINE_SIZE 64
+
+/* Per-stream state. Whatever streams can share (network weights, window
+   and FFT plans) lives outside and is only pointed to; rnnoise_get_memory()
+   reports what is left. The state updated on every frame comes first, and
+   DenoiseState is aligned and padded to whole cache lines so that streams
+   run on different threads never share one. */
 typedef struct {
     float noise_std[NB_BANDS];
-    float speech_std[NB_BANDS];
-    float features[NB_BANDS+1];
-    RNNState rnn;
-    float vad_prob;
     float gain_lp[NB_BANDS];
+    float rnn_gain[NB_BANDS];
+    float rnn_gain_prev[NB_BANDS];
+    float vad_prob;
+    float agc_gain;
+    /* Set when the previous frame ran the RNN (for the alternate-frame tiers). */
+    int rnn_fresh;
+    int complexity;
+    /* Weights of the model in use, or NULL, and this stream's recurrent
+       state; set by the model registry (see model.h). */
+    const RNNState *rnn;
+    opus_val16 *neurons;
+    /* Echo canceller, allocated by rnnoise_aec_enable(). Swapped atomically,
+       since the playback thread may be pushing reference into it. */
+    struct EchoCanceller *aec;
+    /* Advanced each time aec is replaced. */
+    unsigned long long aec_epoch;
+    /* One past the aec_epoch seen by a push in progress, 0 when idle. */
+    unsigned long long aec_push_epoch;
+    /* Recognition features, allocated by rnnoise_features_enable(). */
+    struct FeatureExtractor *feature_extractor;
+    struct ModelReader *model_reader;
+    RNNoiseModel *model;
+    /* Automatic gain control; disabled while agc_target is 0. */
+    float agc_target;
+    float agc_max_gain;
+#if defined(RNNOISE_STATS) || defined(RNNOISE_TRACE)
+    long long stats_frame_start;
+    long long stats_stage_start;
+#endif
+#ifdef RNNOISE_TRACE
+    unsigned stream_id;
+    unsigned long long frame_seq;
+#endif
+#ifdef RNNOISE_STATS
+    RNNoiseStats stats;
+#endif
 } DenoiseStateInternal;
 
-void compute_band_energy(float *bandE, const kiss_fft_cpx *X);
-
-void apply_window(float *x);
-
-void forward_transform(kiss_fft_cpx *X, const float *x);
-
-void inverse_transform(float *x, const kiss_fft_cpx *X);
+#ifdef FIXED_POINT
+/* Window output is Q15 relative to the 16-bit input samples. */
+#define WINDOW_SHIFT 15
+
+/* Converts bin powers of a spectrum in Q(shift) to float. */
+#define SPECTRUM_SCALE(shift) ldexpf(1.f, 2 - 2*(shift))
+
+/* Power of one bin; dropping a bit first keeps the sum of squares within
+   64 bits. */
+static OPUS_INLINE float bin_energy(kiss_fft_cpx X, float scale) {
+    opus_val32 r = SHR32(X.r, 1);
+    opus_val32 i = SHR32(X.i, 1);
+    return scale*(float)(MULT32_32(r, r) + MULT32_32(i, i));
+}
+#else
+#define SPECTRUM_SCALE(shift) ((void)(shift), 1.f)
+static OPUS_INLINE float bin_energy(kiss_fft_cpx X, float scale) {
+    return scale*(X.r*X.r + X.i*X.i);
+}
+#endif
+
+/* In the fixed-point build spectra are block floating point: each one
+   carries the Q format returned by forward_transform(). The float build
+   uses 0 throughout. */
+void compute_band_energy(float *bandE, const kiss_fft_cpx *X, int shift);
+
+void apply_window(opus_val32 *x);
+
+/* Returns the Q format of X. */
+int forward_transform(kiss_fft_cpx *X, const opus_val32 *x);
+
+/* Writes the signal in the scale of the input samples. */
+void inverse_transform(opus_val32 *x, const kiss_fft_cpx *X, int shift);
 
 #endif 
\ No newline at end of file
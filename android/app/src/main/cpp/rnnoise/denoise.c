@@ -29,6 +29,7 @@
 #endif
 
 #include <math.h>
+#include <sched.h>
 #include <stdio.h>
 #include "rnnoise.h"
 #include "common.h"
@@ -36,6 +37,11 @@
 #include "pitch.h"
 #include "kiss_fft.h"
 #include "rnn.h"
+#include "aec.h"
+#include "mel.h"
+#include "model.h"
+#include "stats.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -60,46 +66,447 @@
 
 struct DenoiseState {
     DenoiseStateInternal internal;
-};
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+int rnnoise_get_frame_size(void) {
+    return FRAME_SIZE;
+}
 
 DenoiseState *rnnoise_create(void *model) {
-    DenoiseState *st = malloc(sizeof(DenoiseState));
+    DenoiseState *st;
+    /* Models come from a registry, see rnnoise_model_attach(). */
+    (void)model;
+    if (posix_memalign((void**)&st, CACHE_LINE_SIZE, sizeof(DenoiseState)))
+        return NULL;
     memset(&st->internal, 0, sizeof(DenoiseStateInternal));
+    st->internal.complexity = RNNOISE_MAX_COMPLEXITY;
+#ifdef RNNOISE_TRACE
+    {
+        static unsigned next_stream_id;
+        st->internal.stream_id = __atomic_fetch_add(&next_stream_id, 1, __ATOMIC_RELAXED);
+    }
+#endif
     return st;
 }
 
 void rnnoise_destroy(DenoiseState *st) {
+    aec_destroy(st->internal.aec);
+    features_destroy(st->internal.feature_extractor);
+    model_detach(&st->internal);
     free(st);
 }
 
+int rnnoise_get_memory(const DenoiseState *st) {
+    const DenoiseStateInternal *internal = &st->internal;
+    return (int)sizeof(DenoiseState) + aec_memory(internal->aec)
+           + features_memory(internal->feature_extractor) + model_memory(internal);
+}
+
+int rnnoise_get_stats(const DenoiseState *st, RNNoiseStats *stats) {
+#ifdef RNNOISE_STATS
+    *stats = st->internal.stats;
+    return 0;
+#else
+    (void)st;
+    memset(stats, 0, sizeof(*stats));
+    return -1;
+#endif
+}
+
+void rnnoise_reset_stats(DenoiseState *st) {
+#ifdef RNNOISE_STATS
+    memset(&st->internal.stats, 0, sizeof(st->internal.stats));
+#else
+    (void)st;
+#endif
+}
+
+void rnnoise_set_stream_id(DenoiseState *st, unsigned stream_id) {
+#ifdef RNNOISE_TRACE
+    st->internal.stream_id = stream_id;
+#else
+    (void)st;
+    (void)stream_id;
+#endif
+}
+
+/* Complexity tiers:
+    0-1   spectral subtraction on coarse bands
+    2-3   RNN every other frame on coarse bands
+    4-5   RNN every other frame
+    6-7   RNN every frame, no pitch analysis
+    8-10  full pipeline */
+#define USE_RNN(c) ((c) >= 2)
+#define COARSE_BANDS(c) ((c) < 4)
+#define RNN_EVERY_FRAME(c) ((c) >= 6)
+#define USE_PITCH(c) ((c) >= 8)
+
+void rnnoise_set_complexity(DenoiseState *st, int complexity) {
+    st->internal.complexity = OPUS_CLAMP16(complexity, 0, RNNOISE_MAX_COMPLEXITY);
+}
+
+int rnnoise_get_complexity(const DenoiseState *st) {
+    return st->internal.complexity;
+}
+
+int rnnoise_features_enable(DenoiseState *st, int nb_mels, int nb_mfcc, int nb_stack) {
+    FeatureExtractor *fe = NULL;
+    if (nb_mels > 0) {
+        fe = features_create(nb_mels, nb_mfcc, nb_stack);
+        if (!fe) return -1;
+    }
+    features_destroy(st->internal.feature_extractor);
+    st->internal.feature_extractor = fe;
+    return 0;
+}
+
+const float *rnnoise_get_features(const DenoiseState *st, int *size) {
+    if (!st->internal.feature_extractor) return NULL;
+    return features_get(st->internal.feature_extractor, size);
+}
+
+/* AGC smoothing per frame: gain cuts take effect within a few frames,
+   boosts over about half a second. */
+#define AGC_ATTACK .5f
+#define AGC_RELEASE .02f
+#define AGC_MIN_GAIN .1f
+/* Band energy of a full-scale tone after the Hann window: (N/4)^2 in the
+   bin it falls on and (N/8)^2 in each neighbour. */
+#define AGC_FULL_SCALE (1.5f*32767.f*FRAME_SIZE/4*32767.f*FRAME_SIZE/4)
+
+void rnnoise_agc_enable(DenoiseState *st, float target_db, float max_gain_db) {
+    DenoiseStateInternal *internal = &st->internal;
+    if (target_db == 0) {
+        internal->agc_target = 0;
+        return;
+    }
+    internal->agc_target = AGC_FULL_SCALE*powf(10.f, target_db/10.f);
+    internal->agc_max_gain = powf(10.f, max_gain_db/20.f);
+    if (internal->agc_gain == 0) internal->agc_gain = 1;
+}
+
+/* Updates the AGC gain from the denoised band energies during speech and
+   folds it into the band gains. */
+static void agc_gains(DenoiseStateInternal *st, float *g, const float *Ex) {
+    int i;
+    if (st->vad_prob >= .5f) {
+        float level = 0;
+        float target;
+        for (i=0;i<NB_BANDS;i++)
+            level += Ex[i]*g[i]*g[i];
+        target = sqrtf(st->agc_target/(level + 1e-9f));
+        target = OPUS_MAX32(AGC_MIN_GAIN, OPUS_MIN32(st->agc_max_gain, target));
+        st->agc_gain += (target < st->agc_gain ? AGC_ATTACK : AGC_RELEASE)*(target - st->agc_gain);
+    }
+    for (i=0;i<NB_BANDS;i++)
+        g[i] *= st->agc_gain;
+}
+
+int rnnoise_aec_enable(DenoiseState *st, int nb_partitions) {
+    EchoCanceller *aec = NULL;
+    EchoCanceller *old;
+    unsigned long long epoch, e;
+    if (nb_partitions > 0) {
+        aec = aec_create(nb_partitions);
+        if (!aec) return -1;
+    }
+    /* Same grace period as a model publication: a push that announced an
+       older epoch may still hold the old canceller, later ones cannot. */
+    old = __atomic_exchange_n(&st->internal.aec, aec, __ATOMIC_SEQ_CST);
+    epoch = __atomic_add_fetch(&st->internal.aec_epoch, 1, __ATOMIC_SEQ_CST);
+    while ((e = __atomic_load_n(&st->internal.aec_push_epoch, __ATOMIC_SEQ_CST)) != 0 && e <= epoch)
+        sched_yield();
+    aec_destroy(old);
+    return 0;
+}
+
+int rnnoise_model_attach(DenoiseState *st, RNNoiseModelRegistry *reg, int switch_mode) {
+    if (!reg) {
+        model_detach(&st->internal);
+        return 0;
+    }
+    return model_attach(&st->internal, reg, switch_mode);
+}
+
+/* Upsamples to 48 kHz by linear interpolation, in blocks so that a call
+   never needs more than a frame of stack. The last input sample is held
+   rather than carried over, which is inaudible in a reference signal. */
+static int push_resampled(EchoCanceller *aec, const short *pcm, int nb_samples, int factor) {
+    int i, j, k;
+    int queued = 0;
+    short buf[FRAME_SIZE];
+    if (factor == 1) return aec_push_reference(aec, pcm, nb_samples);
+    for (i=0;i<nb_samples;i+=j) {
+        int n = OPUS_MIN32(nb_samples - i, FRAME_SIZE/factor);
+        for (j=0;j<n;j++) {
+            int cur = pcm[i+j];
+            int next = i+j+1 < nb_samples ? pcm[i+j+1] : cur;
+            for (k=0;k<factor;k++)
+                buf[j*factor + k] = (short)(cur + (next - cur)*k/factor);
+        }
+        k = aec_push_reference(aec, buf, n*factor);
+        queued += k;
+        if (k < n*factor) break;
+    }
+    return queued/factor;
+}
+
+int rnnoise_aec_push_reference(DenoiseState *st, const short *pcm, int nb_samples, int sample_rate) {
+    int ret = -1;
+    EchoCanceller *aec;
+    /* At least one input sample must fit in a block. */
+    if (sample_rate < 48000/FRAME_SIZE || 48000 % sample_rate != 0) return -1;
+    __atomic_store_n(&st->internal.aec_push_epoch,
+                     __atomic_load_n(&st->internal.aec_epoch, __ATOMIC_SEQ_CST) + 1, __ATOMIC_SEQ_CST);
+    aec = __atomic_load_n(&st->internal.aec, __ATOMIC_SEQ_CST);
+    if (aec) ret = push_resampled(aec, pcm, nb_samples, 48000/sample_rate);
+    __atomic_store_n(&st->internal.aec_push_epoch, 0, __ATOMIC_RELEASE);
+    return ret;
+}
+
+/* Band energies with pairs of adjacent bands merged. */
+static void compute_band_energy_coarse(float *bandE, const kiss_fft_cpx *X, int shift) {
+    int i;
+    float scale = SPECTRUM_SCALE(shift);
+    for (i=0;i<NB_BANDS;i+=2) {
+        float E = .5f*(bin_energy(X[i], scale) + bin_energy(X[i+1], scale));
+        bandE[i] = bandE[i+1] = E;
+    }
+}
+
+static void compute_features(float *features, const float *Ex, float pitch_corr) {
+    int i;
+    for (i=0;i<NB_BANDS;i++)
+        features[i] = log10f(1e-2f + Ex[i]);
+    features[NB_BANDS] = pitch_corr;
+}
+
+/* Tracks the per-band noise level, following decreases quickly and increases
+   slowly so that speech does not leak into the estimate. */
+static void update_noise(DenoiseStateInternal *st, const float *Ex) {
+    int i;
+    for (i=0;i<NB_BANDS;i++) {
+        float E = sqrtf(Ex[i]);
+        if (st->noise_std[i] == 0 || E < st->noise_std[i])
+            st->noise_std[i] = E;
+        else
+            st->noise_std[i] = (1-B_SMOOTH*(1-st->vad_prob))*st->noise_std[i] + B_SMOOTH*(1-st->vad_prob)*E;
+        st->noise_std[i] = OPUS_MAX32(st->noise_std[i], NOISE_FLOOR);
+    }
+}
+
+/* Cheap gain estimate used when the RNN is skipped: spectral subtraction
+   against the tracked noise level, with an SNR-based activity estimate. */
+static float spectral_subtraction_gains(const DenoiseStateInternal *st, float *g, const float *Ex, int coarse) {
+    int i;
+    int step = coarse ? 2 : 1;
+    float snr = 0;
+    for (i=0;i<NB_BANDS;i+=step) {
+        float N = st->noise_std[i]*st->noise_std[i];
+        float r = N/(Ex[i] + 1e-9f);
+        g[i] = sqrtf(OPUS_MAX32(ACTIVITY_FLOOR, 1.f - r));
+        if (coarse) g[i+1] = g[i];
+        snr += log10f(1e-2f + 1.f/(r + 1e-9f));
+    }
+    snr *= (float)step/NB_BANDS;
+    return 1.f/(1.f + expf(-4.f*(snr - .5f)));
+}
+
+static int has_rnn(const DenoiseStateInternal *st) {
+    return st->rnn != NULL;
+}
+
+static float rnn_gains(DenoiseStateInternal *st, float *g, const float *Ex, float pitch_corr) {
+    int i;
+    float features[NB_BANDS+1];
+    opus_val16 out[NB_BANDS+1];
+    compute_features(features, Ex, pitch_corr);
+#ifdef FIXED_POINT
+    {
+        opus_val16 in[NB_BANDS+1];
+        for (i=0;i<NB_BANDS+1;i++)
+            in[i] = SATURATE16((int)floorf(.5f + features[i]*(1<<ACTIVATION_SHIFT)));
+        compute_rnn(st->rnn, st->neurons, in, out);
+        for (i=0;i<NB_BANDS;i++)
+            g[i] = out[i]*(1.f/32768);
+        return st->rnn->nb_outputs > NB_BANDS ? out[NB_BANDS]*(1.f/32768) : st->vad_prob;
+    }
+#else
+    compute_rnn(st->rnn, st->neurons, features, out);
+    for (i=0;i<NB_BANDS;i++)
+        g[i] = out[i];
+    return st->rnn->nb_outputs > NB_BANDS ? out[NB_BANDS] : st->vad_prob;
+#endif
+}
+
+/* Runs the RNN at the given complexity. The alternate-frame tiers reuse the
+   midpoint of the last two RNN outputs on every other frame. */
+static float complexity_gains(DenoiseStateInternal *st, float *g, const float *Ex, const opus_val16 *pitch_buf, int c) {
+    int i;
+    float vad;
+    float pitch_corr = 0;
+    if (!RNN_EVERY_FRAME(c) && st->rnn_fresh) {
+        for (i=0;i<NB_BANDS;i++)
+            g[i] = .5f*(st->rnn_gain[i] + st->rnn_gain_prev[i]);
+        st->rnn_fresh = 0;
+        STATS_INC(st, interpolated_frames);
+        return st->vad_prob;
+    }
+    if (USE_PITCH(c)) {
+        pitch_corr = compute_pitch_corr(pitch_buf);
+        STATS_END_STAGE(st, RNNOISE_STAGE_PITCH);
+    }
+    vad = rnn_gains(st, g, Ex, pitch_corr);
+    STATS_INC(st, rnn_frames);
+    RNN_COPY(st->rnn_gain_prev, st->rnn_gain, NB_BANDS);
+    RNN_COPY(st->rnn_gain, g, NB_BANDS);
+    st->rnn_fresh = 1;
+    return vad;
+}
+
+/* Maps the band gains onto the (conjugate-symmetric) bins of X. Returns
+   the new Q format of X: in the fixed-point build gains above 1 lower it
+   instead of growing the values. */
+static int apply_gains(kiss_fft_cpx *X, const float *g, int shift) {
+    int i;
+#ifdef FIXED_POINT
+    opus_val16 gq[NB_BANDS];
+    float gmax = 1.f;
+    int headroom = 0;
+    for (i=0;i<NB_BANDS;i++)
+        gmax = OPUS_MAX32(gmax, g[i]);
+    while (gmax > 1.f) {
+        gmax *= .5f;
+        headroom++;
+    }
+    for (i=0;i<NB_BANDS;i++)
+        gq[i] = SATURATE16((int)floorf(.5f + ldexpf(g[i], 15-headroom)));
+    for (i=0;i<=FRAME_SIZE/2;i++) {
+        opus_val16 gain = gq[OPUS_MIN16(i, NB_BANDS-1)];
+        X[i].r = MULT16_32_Q15(gain, X[i].r);
+        X[i].i = MULT16_32_Q15(gain, X[i].i);
+        if (i != 0 && i != FRAME_SIZE/2) {
+            X[FRAME_SIZE-i].r = MULT16_32_Q15(gain, X[FRAME_SIZE-i].r);
+            X[FRAME_SIZE-i].i = MULT16_32_Q15(gain, X[FRAME_SIZE-i].i);
+        }
+    }
+    return shift - headroom;
+#else
+    for (i=0;i<=FRAME_SIZE/2;i++) {
+        float gain = g[OPUS_MIN16(i, NB_BANDS-1)];
+        X[i].r *= gain;
+        X[i].i *= gain;
+        if (i != 0 && i != FRAME_SIZE/2) {
+            X[FRAME_SIZE-i].r *= gain;
+            X[FRAME_SIZE-i].i *= gain;
+        }
+    }
+    return shift;
+#endif
+}
+
 float rnnoise_process_frame(DenoiseState *st, short *out, const short *in) {
+    return rnnoise_process_frame_mode(st, out, in, RNNOISE_MODE_FULL);
+}
+
+void rnnoise_process_frames(DenoiseState *st, short *out, const short *in, int nb_frames, float *vad_prob) {
+    int i;
+    for (i=0;i<nb_frames;i++) {
+        float vad = rnnoise_process_frame(st, &out[i*FRAME_SIZE], &in[i*FRAME_SIZE]);
+        if (vad_prob) vad_prob[i] = vad;
+    }
+}
+
+float rnnoise_process_frame_mode(DenoiseState *st, short *out, const short *in, int mode) {
     int i;
-    float x[FRAME_SIZE];
+    int shift;
+    opus_val32 x[FRAME_SIZE];
+    opus_val16 pitch_buf[PITCH_FRAME_SIZE];
     kiss_fft_cpx X[FRAME_SIZE];
-    kiss_fft_cpx P[NB_BANDS];
-    float Ex[NB_BANDS], Ep[NB_BANDS];
+    float Ex[NB_BANDS];
     float g[NB_BANDS];
-    
+    DenoiseStateInternal *internal = &st->internal;
+    int c = internal->complexity;
+
+    if (mode < RNNOISE_MODE_FULL)
+        mode = RNNOISE_MODE_FULL;
+    STATS_BEGIN_FRAME(internal);
+    if (internal->model_reader)
+        model_poll(internal);
+    if (mode >= RNNOISE_MODE_PASSTHROUGH) {
+        if (internal->aec)
+            aec_skip(internal->aec);
+        /* Windowed like the other modes, so switching to and from
+           passthrough does not click. */
+        for (i=0;i<FRAME_SIZE;i++)
+            x[i] = in[i];
+        apply_window(x);
+        for (i=0;i<FRAME_SIZE;i++)
+#ifdef FIXED_POINT
+            out[i] = SATURATE16(PSHR32(x[i], WINDOW_SHIFT));
+#else
+            out[i] = SATURATE16(x[i]);
+#endif
+        STATS_END_FRAME(internal, RNNOISE_MODE_PASSTHROUGH, internal->vad_prob);
+        return internal->vad_prob;
+    }
+
     for (i=0;i<FRAME_SIZE;i++)
         x[i] = in[i];
+    if (USE_PITCH(c)) {
+        for (i=0;i<PITCH_FRAME_SIZE;i++)
+            pitch_buf[i] = in[FRAME_SIZE-PITCH_FRAME_SIZE+i];
+    }
     apply_window(x);
-    forward_transform(X, x);
-    compute_band_energy(Ex, X);
+    STATS_END_STAGE(internal, RNNOISE_STAGE_WINDOW);
+    shift = forward_transform(X, x);
+    if (internal->aec)
+        aec_process(internal->aec, X);
+    STATS_END_STAGE(internal, RNNOISE_STAGE_FFT);
 
-    DenoiseStateInternal *internal = &st->internal;
-    // Process frame using internal state
-    for (i=0;i<NB_BANDS;i++) {
-        P[i].r *= g[i];
-        P[i].i *= g[i];
+    if (mode == RNNOISE_MODE_REUSE_GAINS) {
+        RNN_COPY(g, internal->gain_lp, NB_BANDS);
+    } else {
+        float vad;
+        if (COARSE_BANDS(c))
+            compute_band_energy_coarse(Ex, X, shift);
+        else
+            compute_band_energy(Ex, X, shift);
+        STATS_END_STAGE(internal, RNNOISE_STAGE_BAND_ENERGY);
+        if (mode == RNNOISE_MODE_FULL && USE_RNN(c) && has_rnn(internal)) {
+            vad = complexity_gains(internal, g, Ex, pitch_buf, c);
+        } else {
+            vad = spectral_subtraction_gains(internal, g, Ex, COARSE_BANDS(c));
+            /* Keeps the interpolation history valid when switching tiers. */
+            RNN_COPY(internal->rnn_gain, g, NB_BANDS);
+            internal->rnn_fresh = 0;
+            STATS_INC(internal, spectral_subtraction_frames);
+        }
+        STATS_END_STAGE(internal, RNNOISE_STAGE_RNN);
+        internal->vad_prob = vad;
+        update_noise(internal, Ex);
+        for (i=0;i<NB_BANDS;i++) {
+            g[i] = OPUS_MAX32(g[i], .6f*internal->gain_lp[i]);
+            internal->gain_lp[i] = g[i];
+        }
+    }
+    if (internal->agc_target != 0) {
+        if (mode == RNNOISE_MODE_REUSE_GAINS) {
+            for (i=0;i<NB_BANDS;i++)
+                g[i] *= internal->agc_gain;
+        } else {
+            agc_gains(internal, g, Ex);
+        }
     }
-    inverse_transform(x, P);
+    shift = apply_gains(X, g, shift);
+    if (internal->feature_extractor)
+        features_process(internal->feature_extractor, X, shift);
+    STATS_END_STAGE(internal, RNNOISE_STAGE_GAIN);
+    inverse_transform(x, X, shift);
+    STATS_END_STAGE(internal, RNNOISE_STAGE_IFFT);
     for (i=0;i<FRAME_SIZE;i++)
         out[i] = SATURATE16(x[i]);
+    STATS_END_STAGE(internal, RNNOISE_STAGE_OUTPUT);
+    STATS_END_FRAME(internal, mode, internal->vad_prob);
     return internal->vad_prob;
 }
-
-static const float band_gains[NB_BANDS] = {1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, .8f, .7f, .6f, .5f, .4f, .3f, .2f, .1f, .05f};
-/* This is the window used by the L_ LPC function in the full-band codec. */
-static const float analysis_window[FRAME_SIZE] = {
-   0.00000000e+00f,   0.00000000e+00f,   0.00000000e+00f,   0.00000000e+00f
-}; 
\ No newline at end of file
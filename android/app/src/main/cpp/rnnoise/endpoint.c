@@ -0,0 +1,75 @@
+#include "endpoint.h"
+#include "arch.h"
+#include <stdlib.h>
+
+#define FRAME_MS 10
+
+/* The onset threshold sits this far above the tracked background VAD level,
+   within [ONSET_MIN, ONSET_MAX]; the offset threshold is HYSTERESIS lower so
+   that speech does not flicker on and off around a single value. */
+#define ONSET_MARGIN .35f
+#define ONSET_MIN .5f
+#define ONSET_MAX .9f
+#define HYSTERESIS .2f
+/* Background level smoothing, applied only outside speech. */
+#define BACKGROUND_SMOOTH .02f
+
+struct RNNoiseEndpointer {
+    int min_speech_frames;
+    int hangover_frames;
+    int in_speech;
+    int speech_frames;
+    int silence_frames;
+    float background;
+};
+
+RNNoiseEndpointer *rnnoise_endpoint_create(int min_speech_ms, int hangover_ms) {
+    RNNoiseEndpointer *ep = calloc(1, sizeof(*ep));
+    if (!ep) return NULL;
+    ep->min_speech_frames = OPUS_MAX32(1, (min_speech_ms + FRAME_MS - 1)/FRAME_MS);
+    ep->hangover_frames = OPUS_MAX32(1, (hangover_ms + FRAME_MS - 1)/FRAME_MS);
+    rnnoise_endpoint_reset(ep);
+    return ep;
+}
+
+void rnnoise_endpoint_destroy(RNNoiseEndpointer *ep) {
+    free(ep);
+}
+
+void rnnoise_endpoint_reset(RNNoiseEndpointer *ep) {
+    ep->in_speech = 0;
+    ep->speech_frames = 0;
+    ep->silence_frames = 0;
+    ep->background = 0;
+}
+
+int rnnoise_endpoint_update(RNNoiseEndpointer *ep, float vad_prob) {
+    float onset = OPUS_MIN32(ONSET_MAX, OPUS_MAX32(ONSET_MIN, ep->background + ONSET_MARGIN));
+    if (!ep->in_speech) {
+        if (vad_prob >= onset) {
+            if (++ep->speech_frames >= ep->min_speech_frames) {
+                ep->in_speech = 1;
+                ep->silence_frames = 0;
+                return RNNOISE_EVENT_SPEECH_START;
+            }
+        } else {
+            ep->speech_frames = 0;
+            ep->background += BACKGROUND_SMOOTH*(vad_prob - ep->background);
+        }
+        return RNNOISE_EVENT_NONE;
+    }
+    if (vad_prob < onset - HYSTERESIS) {
+        if (++ep->silence_frames >= ep->hangover_frames) {
+            ep->in_speech = 0;
+            ep->speech_frames = 0;
+            return RNNOISE_EVENT_END_OF_TURN;
+        }
+    } else {
+        ep->silence_frames = 0;
+    }
+    return RNNOISE_EVENT_NONE;
+}
+
+int rnnoise_endpoint_in_speech(const RNNoiseEndpointer *ep) {
+    return ep->in_speech;
+}
@@ -0,0 +1,50 @@
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+
+#include "rnnoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Turn endpointing on the per-frame VAD probability of a denoiser state.
+    Feed it the value returned by rnnoise_process_frame() for every frame. */
+typedef struct RNNoiseEndpointer RNNoiseEndpointer;
+
+#define RNNOISE_EVENT_NONE 0
+/** Enough consecutive speech frames were seen to count as speech. */
+#define RNNOISE_EVENT_SPEECH_START 1
+/** Speech was followed by the hangover period of non-speech. */
+#define RNNOISE_EVENT_END_OF_TURN 2
+
+/**
+ * Creates an endpointer.
+ *
+ * @param[in] min_speech_ms Speech needed before a start is reported; shorter
+ *                          bursts (clicks, coughs) are ignored.
+ * @param[in] hangover_ms Non-speech needed after speech to end the turn.
+ * @return An endpointer, or `NULL` on allocation failure.
+ */
+RNNOISE_EXPORT RNNoiseEndpointer *rnnoise_endpoint_create(int min_speech_ms, int hangover_ms);
+
+RNNOISE_EXPORT void rnnoise_endpoint_destroy(RNNoiseEndpointer *ep);
+
+/** Forgets the current turn and the learned background level. */
+RNNOISE_EXPORT void rnnoise_endpoint_reset(RNNoiseEndpointer *ep);
+
+/**
+ * Advances by one frame.
+ *
+ * @param[in] vad_prob Voice activity probability of the frame.
+ * @return One of the `RNNOISE_EVENT_*` values.
+ */
+RNNOISE_EXPORT int rnnoise_endpoint_update(RNNoiseEndpointer *ep, float vad_prob);
+
+/** Returns 1 between a speech start and the matching end of turn. */
+RNNOISE_EXPORT int rnnoise_endpoint_in_speech(const RNNoiseEndpointer *ep);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
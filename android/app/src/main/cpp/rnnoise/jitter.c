@@ -0,0 +1,332 @@
+#include "jitter.h"
+#include "arch.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* A talk spurt starts when audio arrives after the buffer ran empty and
+   nothing arrived for this long. */
+#define IDLE_NS 200000000LL
+/* The jitter peak decays by 50 ms per second without new peaks. */
+#define PEAK_DECAY_PER_S 50000000LL
+/* Concealment covers at most 3 frames (60 ms), fading to PLC_DECAY per frame. */
+#define PLC_MAX_FRAMES 3
+#define PLC_DECAY .5f
+#define RING_SECONDS 4
+#define MAX_DELAY_MS 10000
+/* The low-water mark rises by an eighth of a frame per frame. */
+#define RISE_DIVISOR 8
+
+struct RNNoiseJitterBuffer {
+    int rate;
+    int frame;
+    int tmin;
+    int tmax;
+    int overlap;
+    int min_delay;
+    int max_delay;
+    /* A power of two, so ring indices stay continuous when head and tail
+       wrap around. */
+    int capacity;
+    short *ring;
+    /* Producer side. */
+    unsigned head;
+    long long t0;
+    long long last_put;
+    long long put_samples;
+    long long min_late;
+    long long peak;
+    long long overflow_samples;
+    int target;
+    /* How far (in samples) arrivals are ahead of real time, e.g. TTS that
+       renders faster than it plays; buffering that much is not delay. */
+    int lead;
+    /* Consumer side. */
+    unsigned tail;
+    int flush;
+    int playing;
+    /* Buffer level low-water mark, rising by RISE_PER_FRAME per frame, so
+       that audio arriving in bursts is not mistaken for excess delay. */
+    int low_level;
+    int concealed;
+    int plc_period;
+    float *window;
+    short *history;
+    short *scratch;
+    long long frames[RNNOISE_JITTER_NB_STATUS];
+};
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+RNNoiseJitterBuffer *rnnoise_jitter_create(int sample_rate, int min_delay_ms, int max_delay_ms) {
+    int i;
+    RNNoiseJitterBuffer *jb;
+    if (sample_rate < 8000 || sample_rate > 48000 || min_delay_ms < 0 || max_delay_ms < min_delay_ms
+        || max_delay_ms > MAX_DELAY_MS)
+        return NULL;
+    jb = calloc(1, sizeof(*jb));
+    if (!jb) return NULL;
+    jb->rate = sample_rate;
+    jb->frame = sample_rate/50;
+    jb->tmin = sample_rate/400;
+    jb->tmax = sample_rate/100;
+    jb->overlap = jb->tmax;
+    jb->min_delay = min_delay_ms*sample_rate/1000;
+    jb->max_delay = max_delay_ms*sample_rate/1000;
+    for (jb->capacity=1;jb->capacity<RING_SECONDS*sample_rate + jb->max_delay;jb->capacity<<=1);
+    jb->target = jb->min_delay;
+    jb->ring = malloc(jb->capacity*sizeof(*jb->ring));
+    jb->window = malloc(jb->overlap*sizeof(*jb->window));
+    /* History holds two maximum pitch periods for the concealment search;
+       scratch holds the most a frame can consume (accelerate). */
+    jb->history = calloc(2*jb->tmax, sizeof(*jb->history));
+    jb->scratch = malloc((jb->frame + jb->tmax)*sizeof(*jb->scratch));
+    if (!jb->ring || !jb->window || !jb->history || !jb->scratch) {
+        rnnoise_jitter_destroy(jb);
+        return NULL;
+    }
+    for (i=0;i<jb->overlap;i++)
+        jb->window[i] = .5f - .5f*cosf(M_PI*(i + .5f)/jb->overlap);
+    return jb;
+}
+
+void rnnoise_jitter_destroy(RNNoiseJitterBuffer *jb) {
+    if (!jb) return;
+    free(jb->ring);
+    free(jb->window);
+    free(jb->history);
+    free(jb->scratch);
+    free(jb);
+}
+
+int rnnoise_jitter_frame_size(const RNNoiseJitterBuffer *jb) {
+    return jb->frame;
+}
+
+/* Tracks how late audio arrives compared to real time since the start of
+   the talk spurt; the spread of that lateness is the jitter to absorb. */
+static void update_target(RNNoiseJitterBuffer *jb, long long now, int level) {
+    long long late, jitter;
+    long long last = __atomic_load_n(&jb->last_put, __ATOMIC_RELAXED);
+    if (level == 0 && now - last > IDLE_NS) {
+        jb->t0 = now;
+        jb->put_samples = 0;
+        jb->min_late = 0;
+    }
+    late = now - jb->t0 - jb->put_samples*1000000000LL/jb->rate;
+    jb->min_late = OPUS_MIN32(jb->min_late, late);
+    jitter = late - jb->min_late;
+    __atomic_store_n(&jb->lead, (int)(OPUS_MAX32(-late, 0)*jb->rate/1000000000LL), __ATOMIC_RELAXED);
+    jb->peak = OPUS_MAX32(jitter, jb->peak - (now - last)*PEAK_DECAY_PER_S/1000000000LL);
+    jb->peak = OPUS_MAX32(jb->peak, 0);
+    __atomic_store_n(&jb->target, (int)OPUS_MAX32(jb->min_delay, OPUS_MIN32(jb->max_delay,
+                     jb->peak*jb->rate/1000000000LL + jb->frame)), __ATOMIC_RELAXED);
+}
+
+int rnnoise_jitter_put(RNNoiseJitterBuffer *jb, const short *pcm, int nb_samples) {
+    return rnnoise_jitter_put_at(jb, pcm, nb_samples, now_ns());
+}
+
+int rnnoise_jitter_put_at(RNNoiseJitterBuffer *jb, const short *pcm, int nb_samples, long long now) {
+    int i, room;
+    unsigned head = jb->head;
+    int level = (int)(head - __atomic_load_n(&jb->tail, __ATOMIC_ACQUIRE));
+    update_target(jb, now, level);
+    jb->put_samples += nb_samples;
+    room = jb->capacity - level;
+    if (nb_samples > room) {
+        __atomic_fetch_add(&jb->overflow_samples, nb_samples - room, __ATOMIC_RELAXED);
+        nb_samples = room;
+    }
+    for (i=0;i<nb_samples;i++)
+        jb->ring[(head + i) & (jb->capacity - 1)] = pcm[i];
+    __atomic_store_n(&jb->head, head + nb_samples, __ATOMIC_RELEASE);
+    __atomic_store_n(&jb->last_put, now, __ATOMIC_RELAXED);
+    return nb_samples;
+}
+
+void rnnoise_jitter_flush(RNNoiseJitterBuffer *jb) {
+    __atomic_store_n(&jb->flush, 1, __ATOMIC_RELEASE);
+}
+
+static void peek(const RNNoiseJitterBuffer *jb, short *x, int n) {
+    int i;
+    for (i=0;i<n;i++)
+        x[i] = jb->ring[(jb->tail + i) & (jb->capacity - 1)];
+}
+
+static void consume(RNNoiseJitterBuffer *jb, int n) {
+    __atomic_store_n(&jb->tail, jb->tail + n, __ATOMIC_RELEASE);
+}
+
+/* Lag in [tmin, tmax] at which x[lag..lag+n) best matches x[0..n). */
+static int best_lag(const RNNoiseJitterBuffer *jb, const short *x, int n) {
+    int i, lag;
+    int best = jb->tmin;
+    float best_score = -1e30f;
+    for (lag=jb->tmin;lag<=jb->tmax;lag++) {
+        float xy = 0, yy = 1;
+        for (i=0;i<n;i++) {
+            xy += (float)x[i]*x[lag+i];
+            yy += (float)x[lag+i]*x[lag+i];
+        }
+        if (xy*fabsf(xy) > best_score*yy) {
+            best_score = xy*fabsf(xy)/yy;
+            best = lag;
+        }
+    }
+    return best;
+}
+
+/* Pitch period of the end of the history, for concealment. */
+static int history_period(const RNNoiseJitterBuffer *jb) {
+    int i, T;
+    int W = jb->tmax;
+    const short *a = &jb->history[W];
+    int best = jb->tmin;
+    float best_score = -1e30f;
+    for (T=jb->tmin;T<=jb->tmax;T++) {
+        float xy = 0, yy = 1;
+        for (i=0;i<W;i++) {
+            xy += (float)a[i]*a[i - T];
+            yy += (float)a[i - T]*a[i - T];
+        }
+        if (xy*fabsf(xy) > best_score*yy) {
+            best_score = xy*fabsf(xy)/yy;
+            best = T;
+        }
+    }
+    return best;
+}
+
+/* Repeats the last pitch period of the history, fading by PLC_DECAY over
+   n samples. */
+static void conceal(const RNNoiseJitterBuffer *jb, short *out, int n) {
+    int i;
+    int H = 2*jb->tmax;
+    int T = jb->plc_period;
+    for (i=0;i<n;i++) {
+        float s = i < T ? jb->history[H - T + i] : out[i - T];
+        out[i] = (short)s;
+    }
+    for (i=0;i<n;i++)
+        out[i] = (short)(out[i]*(1.f - (1.f - PLC_DECAY)*i/jb->frame));
+}
+
+/* Whether audio arrived within the last `ns`; once the producer has gone
+   quiet, running dry is the end of the stream rather than a gap. */
+static int producer_active(const RNNoiseJitterBuffer *jb, long long now, long long ns) {
+    return now - __atomic_load_n(&jb->last_put, __ATOMIC_RELAXED) < ns;
+}
+
+static void update_history(RNNoiseJitterBuffer *jb, const short *out) {
+    int H = 2*jb->tmax;
+    if (jb->frame >= H) {
+        memcpy(jb->history, &out[jb->frame - H], H*sizeof(*out));
+    } else {
+        memmove(jb->history, &jb->history[jb->frame], (H - jb->frame)*sizeof(*jb->history));
+        memcpy(&jb->history[H - jb->frame], out, jb->frame*sizeof(*out));
+    }
+}
+
+static int get_frame(RNNoiseJitterBuffer *jb, short *out, long long now) {
+    int i, T, status;
+    int N = jb->frame;
+    int W = jb->overlap;
+    short *x = jb->scratch;
+    int level = (int)(__atomic_load_n(&jb->head, __ATOMIC_ACQUIRE) - jb->tail);
+    int target = __atomic_load_n(&jb->target, __ATOMIC_RELAXED);
+
+    jb->low_level = OPUS_MIN32(level, jb->low_level + N/RISE_DIVISOR);
+
+    if (__atomic_exchange_n(&jb->flush, 0, __ATOMIC_ACQUIRE)) {
+        consume(jb, level);
+        level = 0;
+        jb->playing = 0;
+        jb->concealed = 0;
+    }
+    if (!jb->playing) {
+        if (level < OPUS_MAX32(target, N)) {
+            memset(out, 0, N*sizeof(*out));
+            return RNNOISE_JITTER_SILENCE;
+        }
+        jb->playing = 1;
+        jb->concealed = 0;
+        jb->low_level = 0;
+    }
+    if (level < N) {
+        if (jb->concealed < PLC_MAX_FRAMES && producer_active(jb, now, IDLE_NS + (long long)target*1000000000LL/jb->rate)) {
+            if (jb->concealed == 0)
+                jb->plc_period = history_period(jb);
+            conceal(jb, out, N);
+            jb->concealed++;
+            return RNNOISE_JITTER_CONCEAL;
+        }
+        /* End of stream or a gap too long to hide: play out any tail and
+           wait for a new talk spurt. */
+        peek(jb, out, level);
+        memset(&out[level], 0, (N - level)*sizeof(*out));
+        consume(jb, level);
+        jb->playing = 0;
+        jb->concealed = 0;
+        return RNNOISE_JITTER_SILENCE;
+    }
+
+    if (jb->low_level - __atomic_load_n(&jb->lead, __ATOMIC_RELAXED) > target + jb->tmax && level >= N + jb->tmax) {
+        /* Drop one pitch period: crossfade into the audio T samples ahead. */
+        peek(jb, x, N + jb->tmax);
+        T = best_lag(jb, x, W);
+        for (i=0;i<W;i++)
+            out[i] = (short)(x[i]*(1 - jb->window[i]) + x[T + i]*jb->window[i]);
+        memcpy(&out[W], &x[T + W], (N - W)*sizeof(*out));
+        consume(jb, N + T);
+        status = RNNOISE_JITTER_ACCELERATE;
+    } else if (level < target/2 && producer_active(jb, now, (long long)target*1000000000LL/jb->rate)) {
+        /* Repeat one pitch period to avoid running dry mid-stream. */
+        peek(jb, x, N);
+        T = best_lag(jb, x, W);
+        memcpy(out, x, T*sizeof(*out));
+        for (i=0;i<W;i++)
+            out[T + i] = (short)(x[T + i]*(1 - jb->window[i]) + x[i]*jb->window[i]);
+        memcpy(&out[T + W], &x[W], (N - T - W)*sizeof(*out));
+        consume(jb, N - T);
+        status = RNNOISE_JITTER_STRETCH;
+    } else {
+        peek(jb, out, N);
+        consume(jb, N);
+        status = RNNOISE_JITTER_NORMAL;
+    }
+    if (jb->concealed) {
+        /* Merge from the concealment into the real audio; the scratch
+           buffer is free again at this point. */
+        conceal(jb, x, W);
+        for (i=0;i<W;i++)
+            out[i] = (short)(x[i]*(1 - jb->window[i]) + out[i]*jb->window[i]);
+        jb->concealed = 0;
+    }
+    return status;
+}
+
+int rnnoise_jitter_get(RNNoiseJitterBuffer *jb, short *out) {
+    return rnnoise_jitter_get_at(jb, out, now_ns());
+}
+
+int rnnoise_jitter_get_at(RNNoiseJitterBuffer *jb, short *out, long long now) {
+    int status = get_frame(jb, out, now);
+    update_history(jb, out);
+    jb->frames[status]++;
+    return status;
+}
+
+void rnnoise_jitter_get_stats(const RNNoiseJitterBuffer *jb, RNNoiseJitterStats *stats) {
+    int level = (int)(__atomic_load_n(&jb->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&jb->tail, __ATOMIC_ACQUIRE));
+    memcpy(stats->frames, jb->frames, sizeof(stats->frames));
+    stats->overflow_samples = __atomic_load_n(&jb->overflow_samples, __ATOMIC_RELAXED);
+    stats->target_ms = __atomic_load_n(&jb->target, __ATOMIC_RELAXED)*1000/jb->rate;
+    stats->level_ms = level*1000/jb->rate;
+}
@@ -0,0 +1,93 @@
+#ifndef JITTER_H
+#define JITTER_H
+
+#include "rnnoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Adaptive jitter buffer for streamed playback. One thread puts audio as it
+    arrives; the playback thread takes fixed 20 ms frames. The buffer delay
+    follows the measured arrival jitter: excess audio is played faster and a
+    low buffer slower (WSOLA time-scaling), and gaps are concealed by pitch
+    repetition. The two sides only share a lock-free ring. */
+typedef struct RNNoiseJitterBuffer RNNoiseJitterBuffer;
+
+/* How rnnoise_jitter_get() produced a frame. */
+#define RNNOISE_JITTER_NORMAL 0
+/** Shortened by about a pitch period to reduce delay. */
+#define RNNOISE_JITTER_ACCELERATE 1
+/** Lengthened by about a pitch period to avoid running dry. */
+#define RNNOISE_JITTER_STRETCH 2
+/** Synthesized to cover missing audio. */
+#define RNNOISE_JITTER_CONCEAL 3
+/** Silence while buffering or idle. */
+#define RNNOISE_JITTER_SILENCE 4
+#define RNNOISE_JITTER_NB_STATUS 5
+
+typedef struct {
+    long long frames[RNNOISE_JITTER_NB_STATUS];
+    /** Samples dropped because the ring was full. */
+    long long overflow_samples;
+    /** Current target and actual buffer delay, in ms. */
+    int target_ms;
+    int level_ms;
+} RNNoiseJitterStats;
+
+/**
+ * Creates a jitter buffer.
+ *
+ * @param[in] sample_rate Sample rate of the stream (8000 to 48000).
+ * @param[in] min_delay_ms Lower bound of the target delay.
+ * @param[in] max_delay_ms Upper bound of the target delay, at most 10 s.
+ * @return A jitter buffer, or `NULL` on bad arguments or allocation failure.
+ */
+RNNOISE_EXPORT RNNoiseJitterBuffer *rnnoise_jitter_create(int sample_rate, int min_delay_ms, int max_delay_ms);
+
+RNNOISE_EXPORT void rnnoise_jitter_destroy(RNNoiseJitterBuffer *jb);
+
+/** Returns the number of samples rnnoise_jitter_get() produces (20 ms). */
+RNNOISE_EXPORT int rnnoise_jitter_frame_size(const RNNoiseJitterBuffer *jb);
+
+/**
+ * Queues arriving audio. Producer side.
+ *
+ * @return The number of samples accepted.
+ */
+RNNOISE_EXPORT int rnnoise_jitter_put(RNNoiseJitterBuffer *jb, const short *pcm, int nb_samples);
+
+/**
+ * Like rnnoise_jitter_put(), with the arrival time given instead of read
+ * from the clock, e.g. the receive timestamp of a packet.
+ *
+ * @param[in] now Arrival time on the CLOCK_MONOTONIC clock, in ns.
+ * @return The number of samples accepted.
+ */
+RNNOISE_EXPORT int rnnoise_jitter_put_at(RNNoiseJitterBuffer *jb, const short *pcm, int nb_samples, long long now);
+
+/**
+ * Produces the next frame for playback. Consumer side.
+ *
+ * @param[out] out `rnnoise_jitter_frame_size()` samples.
+ * @return One of the `RNNOISE_JITTER_*` status values.
+ */
+RNNOISE_EXPORT int rnnoise_jitter_get(RNNoiseJitterBuffer *jb, short *out);
+
+/**
+ * Like rnnoise_jitter_get(), at the given time on the CLOCK_MONOTONIC clock
+ * in ns. Both sides must use the same clock.
+ */
+RNNOISE_EXPORT int rnnoise_jitter_get_at(RNNoiseJitterBuffer *jb, short *out, long long now);
+
+/** Discards all queued audio at the next rnnoise_jitter_get(). Safe from any
+    thread, e.g. on barge-in. */
+RNNOISE_EXPORT void rnnoise_jitter_flush(RNNoiseJitterBuffer *jb);
+
+RNNOISE_EXPORT void rnnoise_jitter_get_stats(const RNNoiseJitterBuffer *jb, RNNoiseJitterStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
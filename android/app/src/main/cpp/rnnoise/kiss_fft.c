@@ -18,7 +18,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 kiss_fft_cfg kiss_fft_alloc(int nfft, int inverse_fft, void *mem, size_t *lenmem) {
     kiss_fft_cfg st = NULL;
-    size_t memneeded = sizeof(struct kiss_fft_state) + sizeof(kiss_fft_cpx) * (nfft - 1);
+    size_t memneeded = sizeof(struct kiss_fft_state) + sizeof(kiss_twiddle_cpx) * (nfft - 1);
 
     if (lenmem == NULL) {
         st = (kiss_fft_cfg) malloc(memneeded);
@@ -31,14 +31,22 @@ kiss_fft_cfg kiss_fft_alloc(int nfft, int inverse_fft, void *mem, size_t *lenmem
         int i;
         st->nfft = nfft;
         st->inverse = inverse_fft;
+#ifdef FIXED_POINT
+        st->inv_nfft = QCONST32(1./nfft, 31);
+#endif
 
         for (i = 0; i < nfft; ++i) {
             const double pi = 3.141592653589793238462643383279502884197169399375105820974944;
             double phase = -2 * pi * i / nfft;
             if (st->inverse)
                 phase *= -1;
+#ifdef FIXED_POINT
+            st->twiddles[i].r = (kiss_twiddle_scalar) SATURATE16(floor(.5 + 32768 * cos(phase)));
+            st->twiddles[i].i = (kiss_twiddle_scalar) SATURATE16(floor(.5 + 32768 * sin(phase)));
+#else
             st->twiddles[i].r = (float) cos(phase);
             st->twiddles[i].i = (float) sin(phase);
+#endif
         }
     }
     return st;
@@ -51,23 +59,46 @@ void kiss_fft_stride(kiss_fft_cfg st, const kiss_fft_cpx *fin, kiss_fft_cpx *fou
         return;
     }
     
-    // Copy input to output
+    kiss_fft_cpx tmp[st->nfft];
     for (i = 0; i < st->nfft; i++) {
-        fout[i] = fin[i * in_stride];
+        tmp[i] = fin[i * in_stride];
     }
 
-    // Perform FFT
+#ifdef FIXED_POINT
+    // Products are exact in 64 bits; only the final sum is rounded
+    for (i = 0; i < st->nfft; i++) {
+        opus_val64 sum_r = 0, sum_i = 0;
+        int k = 0;
+        for (j = 0; j < st->nfft; j++) {
+            kiss_twiddle_cpx twiddle = st->twiddles[k];
+            sum_r += MULT16_32(twiddle.r, tmp[j].r) - MULT16_32(twiddle.i, tmp[j].i);
+            sum_i += MULT16_32(twiddle.i, tmp[j].r) + MULT16_32(twiddle.r, tmp[j].i);
+            k += i;
+            if (k >= st->nfft)
+                k -= st->nfft;
+        }
+        sum_r = PSHR64(sum_r, 15);
+        sum_i = PSHR64(sum_i, 15);
+        if (st->inverse) {
+            // Scale for inverse FFT
+            sum_r = SHR64(sum_r * st->inv_nfft, 31);
+            sum_i = SHR64(sum_i * st->inv_nfft, 31);
+        }
+        fout[i].r = (kiss_fft_scalar) sum_r;
+        fout[i].i = (kiss_fft_scalar) sum_i;
+    }
+#else
+    // Perform FFT; the twiddles already carry the sign for the inverse
     for (i = 0; i < st->nfft; i++) {
         kiss_fft_cpx sum = {0, 0};
+        int k = 0;
         for (j = 0; j < st->nfft; j++) {
-            float phase = 2 * M_PI * i * j / st->nfft;
-            kiss_fft_cpx twiddle;
-            twiddle.r = cosf(phase);
-            twiddle.i = -sinf(phase);
-            float real = fout[j].r * twiddle.r - fout[j].i * twiddle.i;
-            float imag = fout[j].r * twiddle.i + fout[j].i * twiddle.r;
-            sum.r += real;
-            sum.i += imag;
+            kiss_twiddle_cpx twiddle = st->twiddles[k];
+            sum.r += tmp[j].r * twiddle.r - tmp[j].i * twiddle.i;
+            sum.i += tmp[j].r * twiddle.i + tmp[j].i * twiddle.r;
+            k += i;
+            if (k >= st->nfft)
+                k -= st->nfft;
         }
         fout[i] = sum;
     }
@@ -79,6 +110,7 @@ void kiss_fft_stride(kiss_fft_cfg st, const kiss_fft_cpx *fin, kiss_fft_cpx *fou
             fout[i].i /= st->nfft;
         }
     }
+#endif
 }
 
 void kiss_fft(kiss_fft_cfg cfg, const kiss_fft_cpx *fin, kiss_fft_cpx *fout) {
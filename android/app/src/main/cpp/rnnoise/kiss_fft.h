@@ -17,6 +17,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #include <stdlib.h>
 #include <math.h>
+#include "arch.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,11 +38,27 @@ extern "C" {
 #define KISS_FFT_SUCCESS 0
 #define KISS_FFT_FAILURE -1
 
+#ifdef FIXED_POINT
+/* 32-bit data with Q15 twiddles, accumulated in 64 bits. For the forward
+   transform the caller keeps |fin| below 2^31/nfft so that the output
+   cannot overflow. */
+typedef opus_val32 kiss_fft_scalar;
+typedef opus_val16 kiss_twiddle_scalar;
+#else
+typedef float kiss_fft_scalar;
+typedef float kiss_twiddle_scalar;
+#endif
+
 typedef struct {
-    float r;
-    float i;
+    kiss_fft_scalar r;
+    kiss_fft_scalar i;
 } kiss_fft_cpx;
 
+typedef struct {
+    kiss_twiddle_scalar r;
+    kiss_twiddle_scalar i;
+} kiss_twiddle_cpx;
+
 typedef struct kiss_fft_state *kiss_fft_cfg;
 
 kiss_fft_cfg kiss_fft_alloc(int nfft, int inverse_fft, void *mem, size_t *lenmem);
@@ -0,0 +1,235 @@
+#include "mel.h"
+#include "arch.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_BINS (FRAME_SIZE/2 + 1)
+#define SAMPLE_RATE 48000.f
+#define MEL_FMIN 20.f
+#define MEL_FMAX 8000.f
+#define LOG_FLOOR 1e-6f
+
+/* Each triangular filter covers a contiguous run of bins, so the filterbank
+   is stored sparsely: filter i weights bins [start[i], start[i]+len[i]) with
+   weights[offset[i]...]. The filterbank and DCT are read-only and shared by
+   every stream with the same nb_mels and nb_mfcc. */
+typedef struct MelTables {
+    int nb_mels;
+    int nb_mfcc;
+    /* Guarded by tables_lock. */
+    int refcount;
+    struct MelTables *next;
+    int *start;
+    int *len;
+    int *offset;
+    float *weights;
+    float *dct;
+} MelTables;
+
+static MelTables *tables_list;
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct FeatureExtractor {
+    MelTables *tables;
+    int dim;
+    int nb_stack;
+    /* Frames seen so far, modulo nb_stack. */
+    int pos;
+    /* Each frame is written twice, nb_stack vectors apart, so the latest
+       nb_stack frames are always contiguous. */
+    float *stack;
+};
+
+static float hz_to_mel(float hz) {
+    return 2595.f*log10f(1.f + hz/700.f);
+}
+
+static float mel_to_hz(float mel) {
+    return 700.f*(powf(10.f, mel/2595.f) - 1.f);
+}
+
+/* Natural log from the float exponent and an atanh series for the mantissa:
+   log(m) = 2*atanh((m-1)/(m+1)). Branch-free so the loop over mel bands
+   vectorizes; accurate to ~1e-5. */
+static OPUS_INLINE float fast_log(float x) {
+    union { float f; unsigned i; } u;
+    float e, z, z2;
+    u.f = x;
+    e = (float)((int)(u.i >> 23) - 127);
+    u.i = (u.i & 0x007fffff) | 0x3f800000;
+    z = (u.f - 1.f)/(u.f + 1.f);
+    z2 = z*z;
+    return .69314718f*e + 2.f*z*(1.f + z2*(1.f/3 + z2*(1.f/5 + z2*(1.f/7))));
+}
+
+static int build_filterbank(MelTables *t) {
+    int i, k;
+    int nb_weights = 0;
+    float mel_lo = hz_to_mel(MEL_FMIN);
+    float mel_hi = hz_to_mel(MEL_FMAX);
+    float bin_hz = SAMPLE_RATE/FRAME_SIZE;
+    float *edges = malloc((t->nb_mels + 2)*sizeof(*edges));
+    if (!edges) return -1;
+    for (i=0;i<t->nb_mels+2;i++)
+        edges[i] = mel_to_hz(mel_lo + (mel_hi - mel_lo)*i/(t->nb_mels + 1))/bin_hz;
+    for (i=0;i<t->nb_mels;i++) {
+        int lo = (int)ceilf(edges[i]);
+        int hi = (int)floorf(edges[i+2]);
+        /* Filters narrower than a bin still get the nearest bin. */
+        if (hi < lo) lo = hi = (int)floorf(edges[i+1] + .5f);
+        t->start[i] = lo;
+        t->len[i] = OPUS_MIN32(hi, NB_BINS-1) - lo + 1;
+        nb_weights += t->len[i];
+    }
+    t->weights = malloc(nb_weights*sizeof(*t->weights));
+    if (!t->weights) {
+        free(edges);
+        return -1;
+    }
+    nb_weights = 0;
+    for (i=0;i<t->nb_mels;i++) {
+        t->offset[i] = nb_weights;
+        for (k=0;k<t->len[i];k++) {
+            float b = (float)(t->start[i] + k);
+            float w;
+            if (b <= edges[i+1])
+                w = (b - edges[i])/(edges[i+1] - edges[i]);
+            else
+                w = (edges[i+2] - b)/(edges[i+2] - edges[i+1]);
+            t->weights[nb_weights++] = t->len[i] == 1 ? 1.f : OPUS_MAX32(0.f, w);
+        }
+    }
+    free(edges);
+    return 0;
+}
+
+static void tables_free(MelTables *t) {
+    free(t->start);
+    free(t->len);
+    free(t->offset);
+    free(t->weights);
+    free(t->dct);
+    free(t);
+}
+
+static MelTables *tables_create(int nb_mels, int nb_mfcc) {
+    int i, j;
+    MelTables *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    t->nb_mels = nb_mels;
+    t->nb_mfcc = nb_mfcc;
+    t->start = malloc(nb_mels*sizeof(*t->start));
+    t->len = malloc(nb_mels*sizeof(*t->len));
+    t->offset = malloc(nb_mels*sizeof(*t->offset));
+    t->dct = nb_mfcc ? malloc(nb_mfcc*nb_mels*sizeof(*t->dct)) : NULL;
+    if (!t->start || !t->len || !t->offset || (nb_mfcc && !t->dct) || build_filterbank(t)) {
+        tables_free(t);
+        return NULL;
+    }
+    /* Orthonormal DCT-II. */
+    for (i=0;i<nb_mfcc;i++) {
+        float scale = sqrtf((i == 0 ? 1.f : 2.f)/nb_mels);
+        for (j=0;j<nb_mels;j++)
+            t->dct[i*nb_mels + j] = scale*cosf(M_PI*i*(j + .5f)/nb_mels);
+    }
+    return t;
+}
+
+static MelTables *tables_get(int nb_mels, int nb_mfcc) {
+    MelTables *t;
+    pthread_mutex_lock(&tables_lock);
+    for (t = tables_list; t; t = t->next)
+        if (t->nb_mels == nb_mels && t->nb_mfcc == nb_mfcc) break;
+    if (!t && (t = tables_create(nb_mels, nb_mfcc)) != NULL) {
+        t->next = tables_list;
+        tables_list = t;
+    }
+    if (t) t->refcount++;
+    pthread_mutex_unlock(&tables_lock);
+    return t;
+}
+
+static void tables_release(MelTables *t) {
+    MelTables **p;
+    pthread_mutex_lock(&tables_lock);
+    if (--t->refcount == 0) {
+        for (p = &tables_list; *p != t; p = &(*p)->next);
+        *p = t->next;
+        tables_free(t);
+    }
+    pthread_mutex_unlock(&tables_lock);
+}
+
+FeatureExtractor *features_create(int nb_mels, int nb_mfcc, int nb_stack) {
+    FeatureExtractor *fe;
+    if (nb_mels <= 0 || nb_mels > RNNOISE_MAX_MELS || nb_mfcc < 0 || nb_mfcc > nb_mels
+        || nb_stack <= 0 || nb_stack > RNNOISE_MAX_FEATURE_STACK)
+        return NULL;
+    fe = calloc(1, sizeof(*fe));
+    if (!fe) return NULL;
+    fe->dim = nb_mfcc ? nb_mfcc : nb_mels;
+    fe->nb_stack = nb_stack;
+    fe->tables = tables_get(nb_mels, nb_mfcc);
+    fe->stack = calloc(2*nb_stack*fe->dim, sizeof(*fe->stack));
+    if (!fe->tables || !fe->stack) {
+        features_destroy(fe);
+        return NULL;
+    }
+    return fe;
+}
+
+void features_destroy(FeatureExtractor *fe) {
+    if (!fe) return;
+    if (fe->tables) tables_release(fe->tables);
+    free(fe->stack);
+    free(fe);
+}
+
+int features_memory(const FeatureExtractor *fe) {
+    if (!fe) return 0;
+    return (int)(sizeof(*fe) + 2*fe->nb_stack*fe->dim*sizeof(*fe->stack));
+}
+
+void features_process(FeatureExtractor *fe, const kiss_fft_cpx *X, int shift) {
+    int i, k;
+    const MelTables *t = fe->tables;
+    float P[NB_BINS];
+    float mel[RNNOISE_MAX_MELS];
+    float *out;
+    float scale = SPECTRUM_SCALE(shift);
+    for (k=0;k<NB_BINS;k++)
+        P[k] = bin_energy(X[k], scale);
+    for (i=0;i<t->nb_mels;i++) {
+        const float *w = &t->weights[t->offset[i]];
+        const float *p = &P[t->start[i]];
+        float E = LOG_FLOOR;
+        for (k=0;k<t->len[i];k++)
+            E += w[k]*p[k];
+        mel[i] = E;
+    }
+    for (i=0;i<t->nb_mels;i++)
+        mel[i] = fast_log(mel[i]);
+
+    fe->pos = (fe->pos + 1) % fe->nb_stack;
+    out = &fe->stack[(fe->pos + fe->nb_stack - 1)*fe->dim];
+    if (t->nb_mfcc) {
+        for (i=0;i<t->nb_mfcc;i++) {
+            const float *d = &t->dct[i*t->nb_mels];
+            float c = 0;
+            for (k=0;k<t->nb_mels;k++)
+                c += d[k]*mel[k];
+            out[i] = c;
+        }
+    } else {
+        memcpy(out, mel, fe->dim*sizeof(*out));
+    }
+    if (fe->pos != 0)
+        memcpy(&fe->stack[(fe->pos - 1)*fe->dim], out, fe->dim*sizeof(*out));
+}
+
+const float *features_get(const FeatureExtractor *fe, int *size) {
+    if (size) *size = fe->nb_stack*fe->dim;
+    return &fe->stack[fe->pos*fe->dim];
+}
@@ -0,0 +1,24 @@
+#ifndef MEL_H
+#define MEL_H
+
+#include "common.h"
+
+/* Streaming log-mel / MFCC features computed from the denoised spectrum of
+   each frame, so recognizers get features without a second STFT. */
+typedef struct FeatureExtractor FeatureExtractor;
+
+FeatureExtractor *features_create(int nb_mels, int nb_mfcc, int nb_stack);
+
+void features_destroy(FeatureExtractor *fe);
+
+/* Bytes owned by fe, leaving out the filterbank shared with other streams. */
+int features_memory(const FeatureExtractor *fe);
+
+/* Adds the features of one frame given its spectrum X in Q(shift). */
+void features_process(FeatureExtractor *fe, const kiss_fft_cpx *X, int shift);
+
+/* Returns the last nb_stack feature vectors, oldest first, as one contiguous
+   array valid until the next features_process(). */
+const float *features_get(const FeatureExtractor *fe, int *size);
+
+#endif
@@ -0,0 +1,194 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model.h"
+
+/* Publication is RCU-style. A stream picking up the current model
+   announces the registry epoch in its reader while it loads the pointer
+   and takes a reference; a publisher swaps the pointer, advances the epoch
+   and waits until no reader still announces an older one before dropping
+   the registry's reference to the previous model. Streams only read the
+   generation counter on frames without a switch. */
+
+struct RNNoiseModel {
+    int refcount;
+    /* Weights only; each stream has its own neurons. */
+    RNNState rnn;
+};
+
+struct ModelReader {
+    RNNoiseModelRegistry *reg;
+    /* Registry epoch while picking up a model, 0 otherwise. */
+    unsigned long long epoch;
+    /* Registry generation of the model in use. */
+    unsigned generation;
+    int switch_mode;
+    opus_val16 *neurons;
+    int neurons_capacity;
+    ModelReader *next;
+};
+
+struct RNNoiseModelRegistry {
+    RNNoiseModel *current;
+    /* Advanced by each publication; streams poll it once per frame. */
+    unsigned generation;
+    unsigned long long epoch;
+    /* Serializes publishers and guards the reader list. */
+    pthread_mutex_t lock;
+    ModelReader *readers;
+};
+
+RNNoiseModel *rnnoise_model_create(int nb_neurons, int nb_outputs,
+                                   const float *input_weights, const float *recurrent_weights,
+                                   const float *output_weights, const float *input_bias,
+                                   const float *neuron_bias, const float *output_bias, float density) {
+    RNNoiseModel *m;
+    if (nb_neurons <= 0 || nb_neurons > RNNOISE_MAX_NEURONS || (nb_outputs != NB_BANDS && nb_outputs != NB_BANDS+1))
+        return NULL;
+    m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    if (rnn_init_sparse(&m->rnn, NB_BANDS+1, nb_neurons, nb_outputs, input_weights, recurrent_weights,
+                        output_weights, input_bias, neuron_bias, output_bias, density)) {
+        free(m);
+        return NULL;
+    }
+    m->refcount = 1;
+    return m;
+}
+
+static RNNoiseModel *model_ref(RNNoiseModel *m) {
+    if (m) __atomic_fetch_add(&m->refcount, 1, __ATOMIC_RELAXED);
+    return m;
+}
+
+void rnnoise_model_release(RNNoiseModel *m) {
+    if (m && __atomic_sub_fetch(&m->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        rnn_free(&m->rnn);
+        free(m);
+    }
+}
+
+RNNoiseModelRegistry *rnnoise_registry_create(void) {
+    RNNoiseModelRegistry *reg = calloc(1, sizeof(*reg));
+    if (!reg) return NULL;
+    /* Epoch 0 means quiescent in the readers. */
+    reg->epoch = 1;
+    pthread_mutex_init(&reg->lock, NULL);
+    return reg;
+}
+
+void rnnoise_registry_destroy(RNNoiseModelRegistry *reg) {
+    if (!reg) return;
+    rnnoise_model_release(reg->current);
+    pthread_mutex_destroy(&reg->lock);
+    free(reg);
+}
+
+void rnnoise_registry_publish(RNNoiseModelRegistry *reg, RNNoiseModel *model) {
+    RNNoiseModel *old;
+    unsigned long long epoch;
+    ModelReader *r;
+    model_ref(model);
+    pthread_mutex_lock(&reg->lock);
+    old = __atomic_exchange_n(&reg->current, model, __ATOMIC_SEQ_CST);
+    epoch = __atomic_add_fetch(&reg->epoch, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&reg->generation, 1, __ATOMIC_RELEASE);
+    /* Grace period: a reader in an older epoch may hold the old pointer
+       without a reference yet. Its window is a few instructions long. */
+    for (r = reg->readers; r; r = r->next) {
+        unsigned long long e;
+        while ((e = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST)) != 0 && e < epoch)
+            sched_yield();
+    }
+    pthread_mutex_unlock(&reg->lock);
+    rnnoise_model_release(old);
+}
+
+/* Makes m the model of st, taking over the reference to it. */
+static void install(DenoiseStateInternal *st, RNNoiseModel *m) {
+    ModelReader *r = st->model_reader;
+    RNNoiseModel *old = st->model;
+    int carry;
+    if (m == old) {
+        rnnoise_model_release(m);
+        return;
+    }
+    carry = r->switch_mode == RNNOISE_SWITCH_CARRY && old && m && old->rnn.nb_neurons == m->rnn.nb_neurons;
+    if (m && m->rnn.nb_neurons > r->neurons_capacity) {
+        opus_val16 *neurons = calloc(m->rnn.nb_neurons, sizeof(*neurons));
+        if (!neurons) {
+            /* Keep the current model and retry on the next frame. */
+            rnnoise_model_release(m);
+            r->generation--;
+            return;
+        }
+        free(r->neurons);
+        r->neurons = neurons;
+        r->neurons_capacity = m->rnn.nb_neurons;
+    }
+    if (!carry) {
+        if (r->neurons)
+            memset(r->neurons, 0, r->neurons_capacity*sizeof(*r->neurons));
+        st->rnn_fresh = 0;
+    }
+    st->rnn = m ? &m->rnn : NULL;
+    st->neurons = r->neurons;
+    st->model = m;
+    rnnoise_model_release(old);
+}
+
+static void pick_up(DenoiseStateInternal *st) {
+    ModelReader *r = st->model_reader;
+    RNNoiseModelRegistry *reg = r->reg;
+    RNNoiseModel *m;
+    r->generation = __atomic_load_n(&reg->generation, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&r->epoch, __atomic_load_n(&reg->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    m = model_ref(__atomic_load_n(&reg->current, __ATOMIC_SEQ_CST));
+    __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+    install(st, m);
+}
+
+int model_attach(DenoiseStateInternal *st, RNNoiseModelRegistry *reg, int switch_mode) {
+    ModelReader *r = calloc(1, sizeof(*r));
+    if (!r) return -1;
+    model_detach(st);
+    r->reg = reg;
+    r->switch_mode = switch_mode;
+    pthread_mutex_lock(&reg->lock);
+    r->next = reg->readers;
+    reg->readers = r;
+    pthread_mutex_unlock(&reg->lock);
+    st->model_reader = r;
+    pick_up(st);
+    return 0;
+}
+
+void model_detach(DenoiseStateInternal *st) {
+    ModelReader *r = st->model_reader;
+    ModelReader **p;
+    if (!r) return;
+    pthread_mutex_lock(&r->reg->lock);
+    for (p = &r->reg->readers; *p != r; p = &(*p)->next);
+    *p = r->next;
+    pthread_mutex_unlock(&r->reg->lock);
+    rnnoise_model_release(st->model);
+    st->model = NULL;
+    st->rnn = NULL;
+    st->neurons = NULL;
+    free(r->neurons);
+    free(r);
+    st->model_reader = NULL;
+}
+
+void model_poll(DenoiseStateInternal *st) {
+    ModelReader *r = st->model_reader;
+    if (__atomic_load_n(&r->reg->generation, __ATOMIC_ACQUIRE) != r->generation)
+        pick_up(st);
+}
+
+int model_memory(const DenoiseStateInternal *st) {
+    const ModelReader *r = st->model_reader;
+    if (!r) return 0;
+    return (int)(sizeof(*r) + r->neurons_capacity*sizeof(*r->neurons));
+}
@@ -0,0 +1,25 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "common.h"
+
+/* Per-stream side of a model registry, allocated by model_attach(). It
+   owns the recurrent state of the stream, which outlives model switches
+   when the stream carries it over. */
+typedef struct ModelReader ModelReader;
+
+/* Attaches to reg and switches to its current model right away. Returns 0,
+   or -1 on allocation failure. */
+int model_attach(DenoiseStateInternal *st, RNNoiseModelRegistry *reg, int switch_mode);
+
+/* Drops the model and the recurrent state and leaves the registry. */
+void model_detach(DenoiseStateInternal *st);
+
+/* Bytes owned by the reader of st, including the recurrent state. */
+int model_memory(const DenoiseStateInternal *st);
+
+/* Switches to the latest published model if there is a new one. Called at
+   the start of each frame; takes no lock. */
+void model_poll(DenoiseStateInternal *st);
+
+#endif
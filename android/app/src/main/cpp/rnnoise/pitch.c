@@ -35,21 +35,84 @@
 #include "arch.h"
 #include <stdio.h>
 
-#define PITCH_MIN_PERIOD 40
-#define PITCH_MAX_PERIOD 160
-#define PITCH_FRAME_SIZE (PITCH_MAX_PERIOD+PITCH_FRAME_SIZE_PADDED)
-#define PITCH_FRAME_SIZE_PADDED 32
 
-void compute_pitch_xcorr(const float *x, float *xcorr)
+void compute_pitch_xcorr(const opus_val16 *x, opus_val32 *xcorr)
 {
     int i, j;
-    float sum[PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1] = {0};
+    opus_val32 sum[PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1] = {0};
     for (i=0;i<PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1;i++)
     {
         for (j=0;j<PITCH_FRAME_SIZE-PITCH_MAX_PERIOD;j++)
         {
-            sum[i] += x[j]*x[j+i+PITCH_MIN_PERIOD];
+            sum[i] = MAC16_16(sum[i], x[j], x[j+i+PITCH_MIN_PERIOD]);
         }
     }
     for (i=0;i<PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1;i++) xcorr[i] = sum[i];
-} 
\ No newline at end of file
+} 
+
+#ifdef FIXED_POINT
+/* Picks the lag with the largest xcorr/sqrt(e1) by cross-multiplying, so
+   only the final normalisation needs a division. */
+float compute_pitch_corr(const opus_val16 *x)
+{
+    int i, j, shift, norm;
+    opus_val16 xs[PITCH_FRAME_SIZE];
+    opus_val32 xcorr[PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1];
+    opus_val32 e0 = 1, e1 = 1, maxabs = 1;
+    opus_val32 best_xc = 0, best_e1 = 1;
+    for (i=0;i<PITCH_FRAME_SIZE;i++)
+        maxabs = OPUS_MAX32(maxabs, x[i] < 0 ? -x[i] : x[i]);
+    shift = OPUS_MAX32(0, EC_ILOG(maxabs) - 13);
+    for (i=0;i<PITCH_FRAME_SIZE;i++)
+        xs[i] = EXTRACT16(SHR32(EXTEND32(x[i]), shift));
+    compute_pitch_xcorr(xs, xcorr);
+    for (j=0;j<PITCH_FRAME_SIZE-PITCH_MAX_PERIOD;j++)
+    {
+        e0 = MAC16_16(e0, xs[j], xs[j]);
+        e1 = MAC16_16(e1, xs[j+PITCH_MIN_PERIOD], xs[j+PITCH_MIN_PERIOD]);
+    }
+    /* Energies and (by Cauchy-Schwarz) correlations stay below this bound;
+       scaling them to 15 bits keeps xc*xc*e1 within 64 bits. */
+    maxabs = SHR32(maxabs, shift);
+    norm = OPUS_MAX32(0, EC_ILOG(MULT16_16(maxabs, maxabs)*(PITCH_FRAME_SIZE-PITCH_MAX_PERIOD)) - 15);
+    for (i=0;i<PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1;i++)
+    {
+        opus_val32 xc = SHR32(xcorr[i], norm);
+        opus_val32 e = OPUS_MAX32(1, SHR32(e1, norm));
+        if (xc > 0 && MULT32_32(xc, xc)*best_e1 > MULT32_32(best_xc, best_xc)*e) {
+            best_xc = xc;
+            best_e1 = e;
+        }
+        /* Slide the energy window of the lagged signal by one sample. */
+        if (i < PITCH_MAX_PERIOD-PITCH_MIN_PERIOD) {
+            opus_val16 a = xs[i+PITCH_MIN_PERIOD], b = xs[i+PITCH_MIN_PERIOD+PITCH_FRAME_SIZE-PITCH_MAX_PERIOD];
+            e1 = OPUS_MAX32(1, e1 - MULT16_16(a, a) + MULT16_16(b, b));
+        }
+    }
+    e0 = OPUS_MAX32(1, SHR32(e0, norm));
+    return OPUS_MIN32(best_xc/sqrtf((float)e0*best_e1), 1.f);
+}
+#else
+float compute_pitch_corr(const opus_val16 *x)
+{
+    int i, j;
+    opus_val32 xcorr[PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1];
+    float e0 = 1e-3f, e1 = 1e-3f, best = 0;
+    compute_pitch_xcorr(x, xcorr);
+    for (j=0;j<PITCH_FRAME_SIZE-PITCH_MAX_PERIOD;j++)
+    {
+        e0 += x[j]*x[j];
+        e1 += x[j+PITCH_MIN_PERIOD]*x[j+PITCH_MIN_PERIOD];
+    }
+    for (i=0;i<PITCH_MAX_PERIOD-PITCH_MIN_PERIOD+1;i++)
+    {
+        best = OPUS_MAX32(best, xcorr[i]/sqrtf(e0*e1));
+        /* Slide the energy window of the lagged signal by one sample. */
+        if (i < PITCH_MAX_PERIOD-PITCH_MIN_PERIOD) {
+            float a = x[i+PITCH_MIN_PERIOD], b = x[i+PITCH_MIN_PERIOD+PITCH_FRAME_SIZE-PITCH_MAX_PERIOD];
+            e1 = OPUS_MAX32(1e-3f, e1 - a*a + b*b);
+        }
+    }
+    return OPUS_MIN32(best, 1.f);
+}
+#endif
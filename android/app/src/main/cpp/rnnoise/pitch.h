@@ -27,8 +27,18 @@
 #ifndef PITCH_H
 #define PITCH_H
 
-#include "kiss_fft.h"
+#include "arch.h"
 
-void compute_pitch_xcorr(const float *x, float *xcorr);
+#define PITCH_MIN_PERIOD 40
+#define PITCH_MAX_PERIOD 160
+#define PITCH_FRAME_SIZE_PADDED 32
+#define PITCH_FRAME_SIZE (PITCH_MAX_PERIOD+PITCH_FRAME_SIZE_PADDED)
+
+/* In the fixed-point build the caller keeps |x| below 2^13 so that the
+   32-sample sums fit in 32 bits. */
+void compute_pitch_xcorr(const opus_val16 *x, opus_val32 *xcorr);
+
+/* Returns the best normalised correlation over the pitch range, in [0, 1]. */
+float compute_pitch_corr(const opus_val16 *x);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,484 @@
+#include "recorder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOCK_MS 100
+#define MAX_BLOCK (48000*BLOCK_MS/1000)
+#define RING_SECONDS 10
+/* A new segment file starts once the current one reaches this size. */
+#define SEGMENT_BYTES (4<<20)
+#define MAX_PATH 1024
+/* Rice codes with a quotient this long are escaped to RAW_BITS verbatim
+   bits, which covers any difference of two 16-bit samples. */
+#define ESCAPE 24
+#define RAW_BITS 17
+
+static const char index_magic[8] = {'R', 'N', 'R', 'E', 'C', '0', '0', '1'};
+
+typedef struct {
+    char magic[8];
+    int sample_rate;
+    int block;
+} IndexHeader;
+
+typedef struct {
+    long long position;
+    unsigned segment;
+    unsigned offset;
+} IndexEntry;
+
+/* Precedes every block in a segment. Raw blocks hold native-endian samples;
+   the others hold the first sample here and Rice-coded differences. */
+typedef struct {
+    unsigned short nb_samples;
+    unsigned char k;
+    unsigned char raw;
+    short first;
+    unsigned short reserved;
+    unsigned bytes;
+} BlockHeader;
+
+struct RNNoiseRecorder {
+    char dir[MAX_PATH];
+    int rate;
+    int block;
+    int index_fd;
+    int segment_fd;
+    unsigned segment;
+    unsigned segment_offset;
+    long long position;
+    long long index_offset;
+    /* A power of two, so ring indices stay continuous when head and tail
+       wrap around. */
+    int capacity;
+    short *ring;
+    unsigned head;
+    unsigned tail;
+    long long dropped;
+    int stop;
+    int error;
+    sem_t wake;
+    pthread_t thread;
+    short *pcm;
+    unsigned char *buf;
+};
+
+struct RNNoiseRecording {
+    char dir[MAX_PATH];
+    int rate;
+    int block;
+    IndexEntry *index;
+    long long nb_blocks;
+    long long length;
+    unsigned nb_segments;
+    unsigned char **segments;
+    size_t *segment_sizes;
+    short *pcm;
+    long long cached;
+    int cached_samples;
+};
+
+typedef struct {
+    unsigned char *buf;
+    int pos;
+    unsigned long long acc;
+    int nbits;
+} BitWriter;
+
+typedef struct {
+    const unsigned char *buf;
+    int len;
+    int pos;
+    unsigned long long acc;
+    int nbits;
+} BitReader;
+
+static void put_bits(BitWriter *w, unsigned value, int n) {
+    w->acc = (w->acc << n) | value;
+    w->nbits += n;
+    while (w->nbits >= 8) {
+        w->nbits -= 8;
+        w->buf[w->pos++] = (unsigned char)(w->acc >> w->nbits);
+    }
+}
+
+static unsigned get_bits(BitReader *r, int n) {
+    while (r->nbits < n) {
+        r->acc = (r->acc << 8) | (r->pos < r->len ? r->buf[r->pos++] : 0);
+        r->nbits += 8;
+    }
+    r->nbits -= n;
+    return (unsigned)((r->acc >> r->nbits) & ((1ULL << n) - 1));
+}
+
+/* First-order prediction with Rice-coded residuals, as in lossless speech
+   coders; about 70% of the raw size on speech and much less on the
+   silence between turns. Returns the payload size, or -1 if raw is smaller. */
+static int encode_block(const short *pcm, int n, BlockHeader *h, unsigned char *out) {
+    int i, k = 0;
+    unsigned long long sum = 0;
+    BitWriter w = {out, 0, 0, 0};
+    for (i=1;i<n;i++) {
+        int d = pcm[i] - pcm[i-1];
+        sum += ((unsigned)d << 1) ^ (unsigned)(d >> 31);
+    }
+    while (k < 16 && (2ULL << k)*(n - 1) <= sum) k++;
+    for (i=1;i<n;i++) {
+        int d = pcm[i] - pcm[i-1];
+        unsigned u = ((unsigned)d << 1) ^ (unsigned)(d >> 31);
+        unsigned q = u >> k;
+        if (q < ESCAPE) {
+            put_bits(&w, (1u << (q + 1)) - 2, q + 1);
+            put_bits(&w, u & ((1u << k) - 1), k);
+        } else {
+            put_bits(&w, (1u << ESCAPE) - 1, ESCAPE);
+            put_bits(&w, u, RAW_BITS);
+        }
+        if (w.pos >= 2*n) return -1;
+    }
+    if (w.nbits > 0) put_bits(&w, 0, 8 - w.nbits);
+    if (w.pos >= 2*n) return -1;
+    h->k = k;
+    h->first = pcm[0];
+    return w.pos;
+}
+
+static int decode_block(const BlockHeader *h, const unsigned char *payload, short *pcm) {
+    int i;
+    BitReader r = {payload, (int)h->bytes, 0, 0, 0};
+    if (h->raw) {
+        if (h->bytes != h->nb_samples*sizeof(short)) return -1;
+        memcpy(pcm, payload, h->bytes);
+        return h->nb_samples;
+    }
+    pcm[0] = h->first;
+    for (i=1;i<h->nb_samples;i++) {
+        unsigned q = 0, u;
+        int d;
+        while (q < ESCAPE && get_bits(&r, 1)) q++;
+        u = q < ESCAPE ? (q << h->k) | get_bits(&r, h->k) : get_bits(&r, RAW_BITS);
+        d = (int)(u >> 1) ^ -(int)(u & 1);
+        pcm[i] = (short)(pcm[i-1] + d);
+    }
+    return r.pos > r.len ? -1 : h->nb_samples;
+}
+
+static int open_segment(RNNoiseRecorder *rec) {
+    char path[MAX_PATH + 16];
+    if (rec->segment_fd >= 0) close(rec->segment_fd);
+    snprintf(path, sizeof(path), "%s/%06u.seg", rec->dir, rec->segment);
+    rec->segment_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    rec->segment_offset = 0;
+    return rec->segment_fd >= 0 ? 0 : -1;
+}
+
+static int full_pwrite(int fd, const void *data, size_t size, off_t offset) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/* Writer thread: compresses one block and appends it, then its index entry,
+   so the index never points at a partially written block. */
+static void write_block(RNNoiseRecorder *rec, int n) {
+    int i, bytes;
+    BlockHeader h;
+    IndexEntry e;
+    unsigned char *payload = rec->buf + sizeof(h);
+    for (i=0;i<n;i++) rec->pcm[i] = rec->ring[(rec->tail + i) & (rec->capacity - 1)];
+    __atomic_store_n(&rec->tail, rec->tail + n, __ATOMIC_RELEASE);
+    if (rec->error) return;
+
+    memset(&h, 0, sizeof(h));
+    h.nb_samples = n;
+    bytes = encode_block(rec->pcm, n, &h, payload);
+    if (bytes < 0) {
+        h.raw = 1;
+        bytes = n*sizeof(short);
+        memcpy(payload, rec->pcm, bytes);
+    }
+    h.bytes = bytes;
+    memcpy(rec->buf, &h, sizeof(h));
+    if (rec->segment_offset > 0 && rec->segment_offset + sizeof(h) + bytes > SEGMENT_BYTES) {
+        rec->segment++;
+        if (open_segment(rec)) {
+            rec->error = 1;
+            return;
+        }
+    }
+    e.position = rec->position;
+    e.segment = rec->segment;
+    e.offset = rec->segment_offset;
+    if (full_pwrite(rec->segment_fd, rec->buf, sizeof(h) + bytes, rec->segment_offset)
+        || full_pwrite(rec->index_fd, &e, sizeof(e), rec->index_offset)) {
+        rec->error = 1;
+        return;
+    }
+    rec->segment_offset += sizeof(h) + bytes;
+    rec->index_offset += sizeof(e);
+    rec->position += n;
+}
+
+static void *writer_main(void *arg) {
+    RNNoiseRecorder *rec = arg;
+    for (;;) {
+        int stop = __atomic_load_n(&rec->stop, __ATOMIC_ACQUIRE);
+        int available = (int)(__atomic_load_n(&rec->head, __ATOMIC_ACQUIRE) - rec->tail);
+        while (available >= rec->block) {
+            write_block(rec, rec->block);
+            available -= rec->block;
+        }
+        if (stop) {
+            if (available > 0) write_block(rec, available);
+            break;
+        }
+        while (sem_wait(&rec->wake) != 0 && errno == EINTR) {}
+    }
+    return NULL;
+}
+
+static void free_recorder(RNNoiseRecorder *rec) {
+    if (rec->index_fd >= 0) close(rec->index_fd);
+    if (rec->segment_fd >= 0) close(rec->segment_fd);
+    free(rec->ring);
+    free(rec->pcm);
+    free(rec->buf);
+    free(rec);
+}
+
+RNNoiseRecorder *rnnoise_recorder_open(const char *dir, int sample_rate) {
+    char path[MAX_PATH + 16];
+    IndexHeader header;
+    RNNoiseRecorder *rec;
+    if (sample_rate < 8000 || sample_rate > 48000 || strlen(dir) >= MAX_PATH) return NULL;
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) return NULL;
+    rec = calloc(1, sizeof(*rec));
+    if (!rec) return NULL;
+    strcpy(rec->dir, dir);
+    rec->rate = sample_rate;
+    rec->block = sample_rate*BLOCK_MS/1000;
+    rec->capacity = 1;
+    while (rec->capacity < RING_SECONDS*sample_rate) rec->capacity <<= 1;
+    rec->index_fd = -1;
+    rec->segment_fd = -1;
+    rec->ring = malloc(rec->capacity*sizeof(*rec->ring));
+    rec->pcm = malloc(rec->block*sizeof(*rec->pcm));
+    rec->buf = malloc(sizeof(BlockHeader) + 2*rec->block*sizeof(short));
+    snprintf(path, sizeof(path), "%s/index", dir);
+    rec->index_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (!rec->ring || !rec->pcm || !rec->buf || rec->index_fd < 0 || open_segment(rec)) {
+        free_recorder(rec);
+        return NULL;
+    }
+    /* Fault the ring in now rather than on the audio thread. */
+    memset(rec->ring, 0, rec->capacity*sizeof(*rec->ring));
+    memcpy(header.magic, index_magic, sizeof(header.magic));
+    header.sample_rate = sample_rate;
+    header.block = rec->block;
+    if (full_pwrite(rec->index_fd, &header, sizeof(header), 0)) {
+        free_recorder(rec);
+        return NULL;
+    }
+    rec->index_offset = sizeof(header);
+    sem_init(&rec->wake, 0, 0);
+    if (pthread_create(&rec->thread, NULL, writer_main, rec) != 0) {
+        sem_destroy(&rec->wake);
+        free_recorder(rec);
+        return NULL;
+    }
+    return rec;
+}
+
+int rnnoise_recorder_write(RNNoiseRecorder *rec, const short *pcm, int nb_samples) {
+    int i, n;
+    unsigned head = rec->head;
+    unsigned tail = __atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE);
+    n = rec->capacity - (int)(head - tail);
+    if (n > nb_samples) n = nb_samples;
+    for (i=0;i<n;i++) rec->ring[(head + i) & (rec->capacity - 1)] = pcm[i];
+    __atomic_store_n(&rec->head, head + n, __ATOMIC_RELEASE);
+    if (n < nb_samples) __atomic_fetch_add(&rec->dropped, nb_samples - n, __ATOMIC_RELAXED);
+    /* sem_post() does not block, unlike signalling a condition variable.
+       The writer takes whole blocks from tail, so counting them from there
+       rather than from zero is unaffected by head wrapping around. */
+    if ((head - tail)/rec->block != (head + n - tail)/rec->block) sem_post(&rec->wake);
+    return n;
+}
+
+long long rnnoise_recorder_dropped(const RNNoiseRecorder *rec) {
+    return __atomic_load_n(&rec->dropped, __ATOMIC_RELAXED);
+}
+
+int rnnoise_recorder_close(RNNoiseRecorder *rec) {
+    int error;
+    if (!rec) return 0;
+    __atomic_store_n(&rec->stop, 1, __ATOMIC_RELEASE);
+    sem_post(&rec->wake);
+    pthread_join(rec->thread, NULL);
+    sem_destroy(&rec->wake);
+    if (fdatasync(rec->segment_fd) || fdatasync(rec->index_fd)) rec->error = 1;
+    error = rec->error;
+    free_recorder(rec);
+    return error ? -1 : 0;
+}
+
+static void *map_file(const char *path, size_t *size) {
+    struct stat sb;
+    void *data;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = sb.st_size;
+    return data;
+}
+
+/* Copies out the header of block b and returns its payload, or NULL if the
+   block is missing, runs past the end of its segment or does not fit in the
+   decode buffer. Nothing read from the files is trusted. */
+static const unsigned char *block_at(RNNoiseRecording *r, long long b, BlockHeader *h) {
+    const IndexEntry *e = &r->index[b];
+    if (e->segment >= r->nb_segments) return NULL;
+    if (!r->segments[e->segment]) {
+        char path[MAX_PATH + 16];
+        snprintf(path, sizeof(path), "%s/%06u.seg", r->dir, e->segment);
+        r->segments[e->segment] = map_file(path, &r->segment_sizes[e->segment]);
+        if (!r->segments[e->segment]) return NULL;
+    }
+    if ((size_t)e->offset + sizeof(*h) > r->segment_sizes[e->segment]) return NULL;
+    /* Blocks are packed, so the header may be unaligned. */
+    memcpy(h, r->segments[e->segment] + e->offset, sizeof(*h));
+    if (h->nb_samples == 0 || h->nb_samples > r->block) return NULL;
+    /* Written so that a huge h->bytes cannot wrap a 32-bit size_t. */
+    if (h->bytes > r->segment_sizes[e->segment] - e->offset - sizeof(*h)) return NULL;
+    return r->segments[e->segment] + e->offset + sizeof(*h);
+}
+
+RNNoiseRecording *rnnoise_recording_open(const char *dir) {
+    char path[MAX_PATH + 16];
+    size_t size = 0;
+    IndexHeader header;
+    BlockHeader last;
+    unsigned char *data;
+    RNNoiseRecording *r;
+    if (strlen(dir) >= MAX_PATH) return NULL;
+    snprintf(path, sizeof(path), "%s/index", dir);
+    data = map_file(path, &size);
+    if (!data) return NULL;
+    if (size < sizeof(header)) {
+        munmap(data, size);
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+    r = calloc(1, sizeof(*r));
+    if (!r || memcmp(header.magic, index_magic, sizeof(header.magic)) || header.block <= 0 || header.block > MAX_BLOCK) {
+        munmap(data, size);
+        free(r);
+        return NULL;
+    }
+    strcpy(r->dir, dir);
+    r->rate = header.sample_rate;
+    r->block = header.block;
+    /* A trailing partial entry from an interrupted write is ignored. */
+    r->nb_blocks = (size - sizeof(header))/sizeof(IndexEntry);
+    r->index = malloc((r->nb_blocks + 1)*sizeof(IndexEntry));
+    r->pcm = malloc(header.block*sizeof(short));
+    r->cached = -1;
+    if (!r->index || !r->pcm) {
+        munmap(data, size);
+        rnnoise_recording_close(r);
+        return NULL;
+    }
+    memcpy(r->index, data + sizeof(header), r->nb_blocks*sizeof(IndexEntry));
+    munmap(data, size);
+    if (r->nb_blocks > 0) {
+        r->nb_segments = r->index[r->nb_blocks-1].segment + 1;
+        r->segments = calloc(r->nb_segments, sizeof(*r->segments));
+        r->segment_sizes = calloc(r->nb_segments, sizeof(*r->segment_sizes));
+        if (!r->segments || !r->segment_sizes) {
+            rnnoise_recording_close(r);
+            return NULL;
+        }
+        /* Index entries are written after their block, so a missing last
+           block means the segment was truncated. */
+        if (block_at(r, r->nb_blocks-1, &last)) {
+            r->length = r->index[r->nb_blocks-1].position + last.nb_samples;
+        } else {
+            r->nb_blocks--;
+            r->length = r->index[r->nb_blocks].position;
+        }
+    }
+    return r;
+}
+
+int rnnoise_recording_sample_rate(const RNNoiseRecording *r) {
+    return r->rate;
+}
+
+long long rnnoise_recording_length(const RNNoiseRecording *r) {
+    return r->length;
+}
+
+int rnnoise_recording_read(RNNoiseRecording *r, long long position, short *pcm, int nb_samples) {
+    int done = 0;
+    long long lo = 0, hi = r->nb_blocks - 1;
+    if (position < 0 || position >= r->length || nb_samples <= 0) return 0;
+    /* Last block starting at or before position. */
+    while (lo < hi) {
+        long long mid = (lo + hi + 1)/2;
+        if (r->index[mid].position <= position) lo = mid;
+        else hi = mid - 1;
+    }
+    for (; lo < r->nb_blocks && done < nb_samples; lo++) {
+        int offset, n;
+        if (r->cached != lo) {
+            BlockHeader h;
+            const unsigned char *payload = block_at(r, lo, &h);
+            r->cached_samples = payload ? decode_block(&h, payload, r->pcm) : -1;
+            r->cached = r->cached_samples < 0 ? -1 : lo;
+            if (r->cached < 0) return done > 0 ? done : -1;
+        }
+        /* Blocks of a valid recording are contiguous. */
+        if (position + done < r->index[lo].position || position + done >= r->index[lo].position + r->cached_samples)
+            return done > 0 ? done : -1;
+        offset = (int)(position + done - r->index[lo].position);
+        n = r->cached_samples - offset;
+        if (n > nb_samples - done) n = nb_samples - done;
+        memcpy(pcm + done, r->pcm + offset, n*sizeof(short));
+        done += n;
+    }
+    return done;
+}
+
+void rnnoise_recording_close(RNNoiseRecording *r) {
+    unsigned i;
+    if (!r) return;
+    for (i=0;i<r->nb_segments;i++) {
+        if (r->segments[i]) munmap(r->segments[i], r->segment_sizes[i]);
+    }
+    free(r->segments);
+    free(r->segment_sizes);
+    free(r->index);
+    free(r->pcm);
+    free(r);
+}
@@ -0,0 +1,80 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "rnnoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Append-only store for call audio. A recording is a directory holding
+    segment files of losslessly compressed 100 ms blocks and an index with
+    one entry per block.
+
+    The audio thread only copies samples into a lock-free ring; a writer
+    thread compresses full blocks and appends them with pwrite(). */
+typedef struct RNNoiseRecorder RNNoiseRecorder;
+
+/** Read side of a finished (or still growing) recording. Segments are
+    memory-mapped on first use and a seek is a binary search of the index.
+    Not thread-safe. */
+typedef struct RNNoiseRecording RNNoiseRecording;
+
+/**
+ * Starts a recording. The directory is created if needed; its parent must
+ * exist. Files already in it are overwritten.
+ *
+ * @param[in] dir Recording directory.
+ * @param[in] sample_rate Sample rate of the stream (8000 to 48000).
+ * @return A recorder, or `NULL` on bad arguments or I/O errors.
+ */
+RNNOISE_EXPORT RNNoiseRecorder *rnnoise_recorder_open(const char *dir, int sample_rate);
+
+/**
+ * Queues mono 16-bit audio for writing. Never blocks: if the writer has
+ * fallen 10 s behind, the samples that do not fit are dropped.
+ *
+ * @return The number of samples accepted.
+ */
+RNNOISE_EXPORT int rnnoise_recorder_write(RNNoiseRecorder *rec, const short *pcm, int nb_samples);
+
+/** Returns the number of samples dropped so far. */
+RNNOISE_EXPORT long long rnnoise_recorder_dropped(const RNNoiseRecorder *rec);
+
+/**
+ * Writes out the queued audio, stops the writer thread and frees the
+ * recorder.
+ *
+ * @return 0, or -1 if any write failed.
+ */
+RNNOISE_EXPORT int rnnoise_recorder_close(RNNoiseRecorder *rec);
+
+/**
+ * Opens a recording for reading. Blocks appended after this call are not
+ * seen.
+ *
+ * @return The recording, or `NULL` if the directory holds no valid index.
+ */
+RNNOISE_EXPORT RNNoiseRecording *rnnoise_recording_open(const char *dir);
+
+RNNOISE_EXPORT int rnnoise_recording_sample_rate(const RNNoiseRecording *r);
+
+/** Returns the length of the recording in samples. */
+RNNOISE_EXPORT long long rnnoise_recording_length(const RNNoiseRecording *r);
+
+/**
+ * Reads audio starting at any position.
+ *
+ * @param[in] position First sample to read.
+ * @param[out] pcm Receives up to `nb_samples` samples.
+ * @return The number of samples read; 0 at the end, -1 on a corrupt block.
+ */
+RNNOISE_EXPORT int rnnoise_recording_read(RNNoiseRecording *r, long long position, short *pcm, int nb_samples);
+
+RNNOISE_EXPORT void rnnoise_recording_close(RNNoiseRecording *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
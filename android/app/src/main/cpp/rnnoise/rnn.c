@@ -32,37 +32,467 @@
 #include <stdio.h>
 #include "rnn.h"
 #include "arch.h"
-#include "rnn_data.h"
 
-void compute_rnn(RNNState *rnn, const float *in, float *out)
+#ifdef FIXED_POINT
+/* tanh(i/32) in Q15 for i = 0..256. */
+static const opus_val16 tansig_table[257] = {
+    0, 1024, 2045, 3063, 4075, 5079, 6073, 7056, 8025, 8980, 9919, 10840,
+    11743, 12625, 13486, 14326, 15143, 15936, 16706, 17452, 18173, 18870, 19542, 20189,
+    20813, 21411, 21986, 22538, 23066, 23571, 24054, 24516, 24956, 25376, 25776, 26157,
+    26519, 26864, 27191, 27502, 27797, 28076, 28341, 28592, 28830, 29055, 29268, 29470,
+    29660, 29840, 30010, 30170, 30322, 30465, 30600, 30727, 30847, 30960, 31067, 31167,
+    31262, 31351, 31435, 31515, 31589, 31659, 31726, 31788, 31846, 31901, 31953, 32002,
+    32048, 32091, 32132, 32170, 32206, 32240, 32271, 32301, 32329, 32356, 32381, 32404,
+    32426, 32447, 32466, 32484, 32501, 32517, 32532, 32547, 32560, 32573, 32584, 32596,
+    32606, 32616, 32625, 32634, 32642, 32649, 32657, 32663, 32670, 32676, 32681, 32686,
+    32691, 32696, 32700, 32704, 32708, 32712, 32715, 32718, 32721, 32724, 32727, 32729,
+    32732, 32734, 32736, 32738, 32740, 32741, 32743, 32745, 32746, 32747, 32749, 32750,
+    32751, 32752, 32753, 32754, 32755, 32755, 32756, 32757, 32758, 32758, 32759, 32759,
+    32760, 32760, 32761, 32761, 32762, 32762, 32762, 32763, 32763, 32763, 32764, 32764,
+    32764, 32764, 32765, 32765, 32765, 32765, 32765, 32766, 32766, 32766, 32766, 32766,
+    32766, 32766, 32766, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767
+};
+
+#define SUM_SHIFT (WEIGHTS_SHIFT+ACTIVATION_SHIFT)
+
+/* tanh of a Q23 sum, interpolated linearly between table entries. */
+static opus_val16 tansig_approx(opus_val32 x)
+{
+    int i;
+    opus_val16 y;
+    opus_val32 ax = x < 0 ? -OPUS_MAX32(x, -2147483647) : x;
+    if (ax >= SHL32(256, SUM_SHIFT-5))
+        return x < 0 ? -32767 : 32767;
+    i = SHR32(ax, SUM_SHIFT-5);
+    y = tansig_table[i] + EXTRACT16(SHR32(MULT16_16(tansig_table[i+1] - tansig_table[i],
+            SHR32(ax, SUM_SHIFT-20) & 0x7fff), 15));
+    return x < 0 ? -y : y;
+}
+
+static opus_val16 sigmoid_approx(opus_val32 x)
+{
+    return EXTRACT16(SHR32(32768 + tansig_approx(SHR32(x, 1)), 1));
+}
+#else
+#define tansig_approx(x) tanhf(x)
+#define sigmoid_approx(x) (1.f/(1.f + expf(-(x))))
+#endif
+
+#ifdef RNNOISE_FP16_WEIGHTS
+static float half_to_float(unsigned short h)
+{
+    union { unsigned u; float f; } v;
+    unsigned sign = (unsigned)(h & 0x8000) << 16;
+    unsigned exponent = (h >> 10) & 0x1f;
+    unsigned mantissa = h & 0x3ff;
+    if (exponent == 0x1f) {
+        v.u = sign | 0x7f800000 | mantissa << 13;
+    } else if (exponent != 0) {
+        v.u = sign | (exponent + 112) << 23 | mantissa << 13;
+    } else {
+        v.f = mantissa*(1.f/16777216);
+        v.u |= sign;
+    }
+    return v.f;
+}
+
+/* Rounds to nearest even. */
+static unsigned short float_to_half(float f)
+{
+    union { float f; unsigned u; } v;
+    unsigned sign, a;
+    v.f = f;
+    sign = (v.u >> 16) & 0x8000;
+    a = v.u & 0x7fffffff;
+    if (a >= 0x7f800000)
+        return sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0);
+    if (a >= 0x477ff000)
+        return sign | 0x7c00;
+    if (a < 0x38800000)
+        return sign | (unsigned)lrintf(fabsf(f)*16777216.f);
+    a += 0xfff + ((a >> 13) & 1);
+    return sign | ((a - 0x38000000) >> 13);
+}
+
+#define WEIGHT(w) half_to_float(w)
+#define BIAS(b) half_to_float(b)
+#else
+#define WEIGHT(w) (w)
+/* Biases are stored in the weight format; sums are in the product format. */
+#define BIAS(b) SHL32(EXTEND32(b), ACTIVATION_SHIFT)
+#endif
+
+/* The NEON kernels are opt-in until test/rnnoise_kernels.c has passed on
+   the target; without RNNOISE_NEON_KERNELS, Arm builds use the scalar
+   ones. */
+#if defined(RNNOISE_NEON_KERNELS) && defined(__ARM_NEON)
+#define RNN_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(RNNOISE_FP16_WEIGHTS) && defined(RNN_NEON) && defined(__aarch64__) && defined(__ARM_FEATURE_FP16_VECTOR_ARITHMETIC)
+/* Half-precision FMLA, eight columns at a time. The partial sums are
+   widened to float every 32 columns to bound the rounding error. */
+static void gemv(opus_val32 *out, const rnn_weight *bias, const rnn_weight *w, int rows, int cols, const opus_val16 *x)
+{
+    int i, j, k;
+    float16_t xh[cols];
+    for (j=0;j+4<=cols;j+=4)
+        vst1_f16(&xh[j], vcvt_f16_f32(vld1q_f32(&x[j])));
+    for (;j<cols;j++)
+        xh[j] = (float16_t)x[j];
+    for (i=0;i<rows;i++)
+    {
+        const rnn_weight *row = &w[i*cols];
+        float32x4_t acc = vdupq_n_f32(0);
+        float sum;
+        for (j=0;j+8<=cols;)
+        {
+            float16x8_t acc16 = vdupq_n_f16(0);
+            for (k=0;k<4 && j+8<=cols;k++,j+=8)
+                acc16 = vfmaq_f16(acc16, vreinterpretq_f16_u16(vld1q_u16(&row[j])), vld1q_f16(&xh[j]));
+            acc = vaddq_f32(acc, vcvt_f32_f16(vget_low_f16(acc16)));
+            acc = vaddq_f32(acc, vcvt_high_f32_f16(acc16));
+        }
+        sum = BIAS(bias[i]) + vaddvq_f32(acc);
+        for (;j<cols;j++)
+            sum += WEIGHT(row[j])*x[j];
+        out[i] = sum;
+    }
+}
+#elif defined(RNNOISE_FP16_WEIGHTS) && defined(RNN_NEON) && defined(__aarch64__)
+/* Widens four weights at a time and accumulates in float. */
+static void gemv(opus_val32 *out, const rnn_weight *bias, const rnn_weight *w, int rows, int cols, const opus_val16 *x)
 {
     int i, j;
-    float dense_out[rnn->nb_neurons];
-    float recurrent_out[rnn->nb_neurons];
-    /* Compute dense layer */
-    for (i=0;i<rnn->nb_neurons;i++)
+    for (i=0;i<rows;i++)
     {
-        float sum = rnn->input_bias[i];
-        for (j=0;j<rnn->nb_inputs;j++)
-            sum += rnn->input_weights[i*rnn->nb_inputs + j]*in[j];
-        dense_out[i] = tanhf(sum);
+        const rnn_weight *row = &w[i*cols];
+        float32x4_t acc = vdupq_n_f32(0);
+        float sum;
+        for (j=0;j+4<=cols;j+=4)
+            acc = vfmaq_f32(acc, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(&row[j]))), vld1q_f32(&x[j]));
+        sum = BIAS(bias[i]) + vaddvq_f32(acc);
+        for (;j<cols;j++)
+            sum += WEIGHT(row[j])*x[j];
+        out[i] = sum;
     }
-    /* Compute recurrent layer */
-    for (i=0;i<rnn->nb_neurons;i++)
+}
+#elif defined(RNNOISE_FP16_WEIGHTS) && defined(__F16C__)
+/* Widens eight weights at a time with F16C and accumulates in float. */
+static void gemv(opus_val32 *out, const rnn_weight *bias, const rnn_weight *w, int rows, int cols, const opus_val16 *x)
+{
+    int i, j;
+    for (i=0;i<rows;i++)
+    {
+        const rnn_weight *row = &w[i*cols];
+        __m256 acc = _mm256_setzero_ps();
+        __m128 s;
+        float sum;
+        for (j=0;j+8<=cols;j+=8)
+        {
+            __m256 wf = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)&row[j]));
+#ifdef __FMA__
+            acc = _mm256_fmadd_ps(wf, _mm256_loadu_ps(&x[j]), acc);
+#else
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(wf, _mm256_loadu_ps(&x[j])));
+#endif
+        }
+        s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        sum = BIAS(bias[i]) + _mm_cvtss_f32(s);
+        for (;j<cols;j++)
+            sum += WEIGHT(row[j])*x[j];
+        out[i] = sum;
+    }
+}
+#else
+/* out = bias + w*x for a row-major rows x cols matrix. */
+static void gemv(opus_val32 *out, const rnn_weight *bias, const rnn_weight *w, int rows, int cols, const opus_val16 *x)
+{
+    int i, j;
+    for (i=0;i<rows;i++)
     {
-        float sum = rnn->neuron_bias[i];
-        for (j=0;j<rnn->nb_neurons;j++)
-            sum += rnn->recurrent_weights[i*rnn->nb_neurons + j]*rnn->neurons[j];
-        recurrent_out[i] = tanhf(sum);
+        opus_val32 sum = BIAS(bias[i]);
+        for (j=0;j<cols;j++)
+            sum = MAC16_16(sum, WEIGHT(w[i*cols + j]), x[j]);
+        out[i] = sum;
     }
+}
+#endif
+
+/* out = bias + w*x for a block-sparse matrix (see rnn.h). Each block adds
+   four columns of x to eight rows, so it maps onto two 4-lane or one
+   8-lane vector per column. */
+static void sparse_gemv(opus_val32 *out, const rnn_weight *bias, const rnn_weight *w, const int *idx, int rows, const opus_val16 *x)
+{
+    int i, b, j, k;
+    for (i=0;i<rows;i+=SPARSE_BLOCK_ROWS)
+    {
+        int nb_blocks = *idx++;
+#if defined(RNNOISE_FP16_WEIGHTS) && defined(RNN_NEON) && defined(__aarch64__)
+        float32x4_t lo = vdupq_n_f32(0), hi = vdupq_n_f32(0);
+        for (b=0;b<nb_blocks;b++,w+=SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS)
+        {
+            const opus_val16 *xb = &x[*idx++];
+            for (j=0;j<SPARSE_BLOCK_COLS;j++)
+            {
+                lo = vfmaq_n_f32(lo, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(&w[8*j]))), xb[j]);
+                hi = vfmaq_n_f32(hi, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(&w[8*j+4]))), xb[j]);
+            }
+        }
+        vst1q_f32(&out[i], lo);
+        vst1q_f32(&out[i+4], hi);
+#elif defined(RNNOISE_FP16_WEIGHTS) && defined(__F16C__)
+        __m256 acc = _mm256_setzero_ps();
+        for (b=0;b<nb_blocks;b++,w+=SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS)
+        {
+            const opus_val16 *xb = &x[*idx++];
+            for (j=0;j<SPARSE_BLOCK_COLS;j++)
+            {
+                __m256 wf = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)&w[8*j]));
+#ifdef __FMA__
+                acc = _mm256_fmadd_ps(wf, _mm256_set1_ps(xb[j]), acc);
+#else
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(wf, _mm256_set1_ps(xb[j])));
+#endif
+            }
+        }
+        _mm256_storeu_ps(&out[i], acc);
+#elif defined(FIXED_POINT) && defined(RNN_NEON)
+        int32x4_t lo = vdupq_n_s32(0), hi = vdupq_n_s32(0);
+        for (b=0;b<nb_blocks;b++,w+=SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS)
+        {
+            const opus_val16 *xb = &x[*idx++];
+            for (j=0;j<SPARSE_BLOCK_COLS;j++)
+            {
+                lo = vmlal_n_s16(lo, vld1_s16(&w[8*j]), xb[j]);
+                hi = vmlal_n_s16(hi, vld1_s16(&w[8*j+4]), xb[j]);
+            }
+        }
+        vst1q_s32(&out[i], lo);
+        vst1q_s32(&out[i+4], hi);
+#elif !defined(FIXED_POINT) && !defined(RNNOISE_FP16_WEIGHTS) && defined(RNN_NEON)
+        float32x4_t lo = vdupq_n_f32(0), hi = vdupq_n_f32(0);
+        for (b=0;b<nb_blocks;b++,w+=SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS)
+        {
+            const opus_val16 *xb = &x[*idx++];
+            for (j=0;j<SPARSE_BLOCK_COLS;j++)
+            {
+                lo = vmlaq_n_f32(lo, vld1q_f32(&w[8*j]), xb[j]);
+                hi = vmlaq_n_f32(hi, vld1q_f32(&w[8*j+4]), xb[j]);
+            }
+        }
+        vst1q_f32(&out[i], lo);
+        vst1q_f32(&out[i+4], hi);
+#elif !defined(FIXED_POINT) && !defined(RNNOISE_FP16_WEIGHTS) && defined(__SSE2__)
+        __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+        for (b=0;b<nb_blocks;b++,w+=SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS)
+        {
+            const opus_val16 *xb = &x[*idx++];
+            for (j=0;j<SPARSE_BLOCK_COLS;j++)
+            {
+                __m128 xj = _mm_set1_ps(xb[j]);
+                lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(&w[8*j]), xj));
+                hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(&w[8*j+4]), xj));
+            }
+        }
+        _mm_storeu_ps(&out[i], lo);
+        _mm_storeu_ps(&out[i+4], hi);
+#else
+        for (k=0;k<SPARSE_BLOCK_ROWS;k++)
+            out[i+k] = 0;
+        for (b=0;b<nb_blocks;b++,w+=SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS)
+        {
+            const opus_val16 *xb = &x[*idx++];
+            for (j=0;j<SPARSE_BLOCK_COLS;j++)
+                for (k=0;k<SPARSE_BLOCK_ROWS;k++)
+                    out[i+k] = MAC16_16(out[i+k], WEIGHT(w[8*j+k]), xb[j]);
+        }
+#endif
+        for (k=0;k<SPARSE_BLOCK_ROWS;k++)
+            out[i+k] = ADD32(out[i+k], BIAS(bias[i+k]));
+    }
+}
+
+void compute_rnn(const RNNState *rnn, opus_val16 *neurons, const opus_val16 *in, opus_val16 *out)
+{
+    int i;
+    opus_val32 sum[OPUS_MAX32(rnn->nb_neurons, rnn->nb_outputs)];
+    opus_val16 dense_out[rnn->nb_neurons];
+    /* Compute dense layer */
+    gemv(sum, rnn->input_bias, rnn->input_weights, rnn->nb_neurons, rnn->nb_inputs, in);
     for (i=0;i<rnn->nb_neurons;i++)
-        rnn->neurons[i] = dense_out[i] + recurrent_out[i];
+        dense_out[i] = tansig_approx(sum[i]);
+    /* Compute recurrent layer */
+    if (rnn->recurrent_idx)
+        sparse_gemv(sum, rnn->neuron_bias, rnn->recurrent_weights, rnn->recurrent_idx, rnn->nb_neurons, neurons);
+    else
+        gemv(sum, rnn->neuron_bias, rnn->recurrent_weights, rnn->nb_neurons, rnn->nb_neurons, neurons);
+    for (i=0;i<rnn->nb_neurons;i++)
+        neurons[i] = EXTRACT16(PSHR32(ADD32(dense_out[i], tansig_approx(sum[i])), 15-ACTIVATION_SHIFT));
     /* Compute output layer */
+    gemv(sum, rnn->output_bias, rnn->output_weights, rnn->nb_outputs, rnn->nb_neurons, neurons);
     for (i=0;i<rnn->nb_outputs;i++)
+        out[i] = sigmoid_approx(sum[i]);
+}
+
+void rnn_convert_weights(rnn_weight *dst, const float *src, int n)
+{
+    int i;
+    for (i=0;i<n;i++)
     {
-        float sum = rnn->output_bias[i];
-        for (j=0;j<rnn->nb_neurons;j++)
-            sum += rnn->output_weights[i*rnn->nb_neurons + j]*rnn->neurons[j];
-        out[i] = 1.f/(1.f + expf(-sum));
+#ifdef FIXED_POINT
+        dst[i] = SATURATE16((int)floorf(.5f + src[i]*(1<<WEIGHTS_SHIFT)));
+#elif defined(RNNOISE_FP16_WEIGHTS)
+        dst[i] = float_to_half(src[i]);
+#else
+        dst[i] = src[i];
+#endif
     }
-} 
\ No newline at end of file
+}
+
+/* Marks the blocks of each group of rows to keep, the ones with the most
+   energy, and returns how many there are in total. */
+static int prune_blocks(unsigned char *keep, const float *w, int rows, int cols, float density)
+{
+    int i, j, k, b, n;
+    int nb_cols = cols/SPARSE_BLOCK_COLS;
+    int nb_keep = (int)floorf(.5f + density*nb_cols);
+    float energy[nb_cols];
+    for (i=0;i<rows/SPARSE_BLOCK_ROWS;i++)
+    {
+        unsigned char *row_keep = &keep[i*nb_cols];
+        for (b=0;b<nb_cols;b++)
+        {
+            energy[b] = 0;
+            for (k=0;k<SPARSE_BLOCK_ROWS;k++)
+                for (j=0;j<SPARSE_BLOCK_COLS;j++)
+                {
+                    float v = w[(i*SPARSE_BLOCK_ROWS + k)*cols + b*SPARSE_BLOCK_COLS + j];
+                    energy[b] += v*v;
+                }
+            row_keep[b] = 0;
+        }
+        for (n=0;n<nb_keep;n++)
+        {
+            int best = -1;
+            for (b=0;b<nb_cols;b++)
+                if (!row_keep[b] && (best < 0 || energy[b] > energy[best]))
+                    best = b;
+            row_keep[best] = 1;
+        }
+    }
+    return rows/SPARSE_BLOCK_ROWS*nb_keep;
+}
+
+/* Packs the kept blocks of w in the layout described in rnn.h. */
+static void pack_blocks(rnn_weight *dst, int *idx, const unsigned char *keep, const float *w, int rows, int cols)
+{
+    int i, j, k, b;
+    int nb_cols = cols/SPARSE_BLOCK_COLS;
+    float block[SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS];
+    for (i=0;i<rows/SPARSE_BLOCK_ROWS;i++)
+    {
+        int *count = idx++;
+        *count = 0;
+        for (b=0;b<nb_cols;b++)
+        {
+            if (!keep[i*nb_cols + b])
+                continue;
+            for (j=0;j<SPARSE_BLOCK_COLS;j++)
+                for (k=0;k<SPARSE_BLOCK_ROWS;k++)
+                    block[j*SPARSE_BLOCK_ROWS + k] = w[(i*SPARSE_BLOCK_ROWS + k)*cols + b*SPARSE_BLOCK_COLS + j];
+            rnn_convert_weights(dst, block, SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS);
+            dst += SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS;
+            *idx++ = b*SPARSE_BLOCK_COLS;
+            (*count)++;
+        }
+    }
+}
+
+int rnn_init_sparse(RNNState *rnn, int nb_inputs, int nb_neurons, int nb_outputs,
+                    const float *input_weights, const float *recurrent_weights, const float *output_weights,
+                    const float *input_bias, const float *neuron_bias, const float *output_bias,
+                    float density)
+{
+    int n_input = nb_inputs*nb_neurons;
+    int n_recurrent = nb_neurons*nb_neurons;
+    int n_output = nb_neurons*nb_outputs;
+    int total, n_idx = 0;
+    rnn_weight *w;
+    int *idx = NULL;
+    unsigned char *keep = NULL;
+    if (density < 1 && nb_neurons%SPARSE_BLOCK_ROWS == 0 && nb_neurons%SPARSE_BLOCK_COLS == 0)
+    {
+        int nb_blocks;
+        keep = calloc(n_recurrent/(SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS), 1);
+        if (!keep)
+            return -1;
+        nb_blocks = prune_blocks(keep, recurrent_weights, nb_neurons, nb_neurons, OPUS_MAX32(density, 0));
+        n_recurrent = nb_blocks*SPARSE_BLOCK_ROWS*SPARSE_BLOCK_COLS;
+        n_idx = nb_neurons/SPARSE_BLOCK_ROWS + nb_blocks;
+    }
+    total = n_input + n_recurrent + n_output + 2*nb_neurons + nb_outputs;
+    /* One block, in the order compute_rnn() reads it. */
+    w = RNN_ALLOC(rnn_weight, total);
+    if (keep)
+        idx = RNN_ALLOC(int, n_idx);
+    if (!w || (keep && !idx)) {
+        RNN_FREE(w);
+        RNN_FREE(idx);
+        RNN_FREE(keep);
+        return -1;
+    }
+    rnn->nb_inputs = nb_inputs;
+    rnn->nb_neurons = nb_neurons;
+    rnn->nb_outputs = nb_outputs;
+    rnn->input_bias = w;
+    rnn_convert_weights(w, input_bias, nb_neurons);
+    w += nb_neurons;
+    rnn->input_weights = w;
+    rnn_convert_weights(w, input_weights, n_input);
+    w += n_input;
+    rnn->neuron_bias = w;
+    rnn_convert_weights(w, neuron_bias, nb_neurons);
+    w += nb_neurons;
+    rnn->recurrent_weights = w;
+    if (keep) {
+        pack_blocks(w, idx, keep, recurrent_weights, nb_neurons, nb_neurons);
+        RNN_FREE(keep);
+    } else {
+        rnn_convert_weights(w, recurrent_weights, n_recurrent);
+    }
+    rnn->recurrent_idx = idx;
+    w += n_recurrent;
+    rnn->output_bias = w;
+    rnn_convert_weights(w, output_bias, nb_outputs);
+    w += nb_outputs;
+    rnn->output_weights = w;
+    rnn_convert_weights(w, output_weights, n_output);
+    return 0;
+}
+
+int rnn_init(RNNState *rnn, int nb_inputs, int nb_neurons, int nb_outputs,
+             const float *input_weights, const float *recurrent_weights, const float *output_weights,
+             const float *input_bias, const float *neuron_bias, const float *output_bias)
+{
+    return rnn_init_sparse(rnn, nb_inputs, nb_neurons, nb_outputs, input_weights, recurrent_weights,
+                           output_weights, input_bias, neuron_bias, output_bias, 1);
+}
+
+void rnn_free(RNNState *rnn)
+{
+    RNN_FREE((void*)rnn->input_bias);
+    RNN_FREE((void*)rnn->recurrent_idx);
+}
@@ -29,20 +29,46 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include "arch.h"
 
 #define RNN_EXPORT
 
+#ifdef FIXED_POINT
+/* Weights and biases are Q12; inputs and neurons Q11, so sums are Q23.
+   Activations return Q15. */
+#define WEIGHTS_SHIFT 12
+#define ACTIVATION_SHIFT 11
+typedef opus_val16 rnn_weight;
+#elif defined(RNNOISE_FP16_WEIGHTS)
+/* IEEE half-precision bit patterns. Sums are computed in float (or in
+   half on cores with FP16 vector arithmetic). */
+typedef unsigned short rnn_weight;
+#else
+typedef float rnn_weight;
+#endif
+
+/* Block-sparse matrices are split into groups of SPARSE_BLOCK_ROWS rows.
+   For each group, the index list holds the number of nonzero blocks
+   followed by the first column of each, and the weights hold each
+   block's SPARSE_BLOCK_ROWS x SPARSE_BLOCK_COLS values column by column. */
+#define SPARSE_BLOCK_ROWS 8
+#define SPARSE_BLOCK_COLS 4
+
+/* Network weights, read-only once set up and shared by every stream using
+   them. The recurrent state is kept by each stream and passed to
+   compute_rnn(). */
 typedef struct {
     int nb_inputs;
     int nb_neurons;
     int nb_outputs;
-    const float *input_weights;
-    const float *recurrent_weights;
-    const float *output_weights;
-    const float *input_bias;
-    const float *neuron_bias;
-    const float *output_bias;
-    float *neurons;
+    const rnn_weight *input_weights;
+    const rnn_weight *recurrent_weights;
+    const rnn_weight *output_weights;
+    const rnn_weight *input_bias;
+    const rnn_weight *neuron_bias;
+    const rnn_weight *output_bias;
+    /* Block-sparse index list of recurrent_weights, or NULL if dense. */
+    const int *recurrent_idx;
 } RNNState;
 
 typedef struct {
@@ -69,6 +95,28 @@ typedef struct {
 #define RNN_FREE(ptr) (free(ptr))
 #define RNN_COPY(dst, src, n) (memcpy(dst, src, (n)*sizeof(*(dst))))
 
-void compute_rnn(RNNState *rnn, const float *in, float *out);
+/* Runs one step, updating the nb_neurons values of neurons in place. */
+void compute_rnn(const RNNState *rnn, opus_val16 *neurons, const opus_val16 *in, opus_val16 *out);
+
+/* Converts float weights to the storage format of this build. */
+void rnn_convert_weights(rnn_weight *dst, const float *src, int n);
+
+/* Sets up rnn from float weights, converting them into newly allocated
+   arrays. Returns 0, or -1 if out of memory. */
+int rnn_init(RNNState *rnn, int nb_inputs, int nb_neurons, int nb_outputs,
+             const float *input_weights, const float *recurrent_weights, const float *output_weights,
+             const float *input_bias, const float *neuron_bias, const float *output_bias);
+
+/* Like rnn_init(), but prunes the recurrent matrix to the fraction
+   `density` of its blocks with the most energy and stores it block-sparse.
+   The matrix stays dense if density >= 1 or nb_neurons is not a multiple
+   of SPARSE_BLOCK_ROWS and SPARSE_BLOCK_COLS. */
+int rnn_init_sparse(RNNState *rnn, int nb_inputs, int nb_neurons, int nb_outputs,
+                    const float *input_weights, const float *recurrent_weights, const float *output_weights,
+                    const float *input_bias, const float *neuron_bias, const float *output_bias,
+                    float density);
+
+/* Frees the arrays allocated by rnn_init(). */
+void rnn_free(RNNState *rnn);
 
 #endif 
\ No newline at end of file
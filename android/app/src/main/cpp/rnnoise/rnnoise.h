@@ -29,7 +29,12 @@
 
 #include <stdio.h>
 
+/* The shared builds hide everything else. */
+#if defined(__GNUC__)
+#define RNNOISE_EXPORT __attribute__((visibility("default")))
+#else
 #define RNNOISE_EXPORT
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,11 +43,19 @@ extern "C" {
 /** Opaque state for the denoiser */
 typedef struct DenoiseState DenoiseState;
 
+/**
+ * Gets the number of samples in a frame.
+ *
+ * @return The frame size (10 ms at 48 kHz).
+ */
+RNNOISE_EXPORT int rnnoise_get_frame_size(void);
+
 /**
  * Creates a denoiser state.
  *
- * @param[in] model If `NULL`, uses the default model.
- * @return A denoiser state.
+ * @param[in] model Unused, pass `NULL`. Models are attached with
+ *                  rnnoise_model_attach().
+ * @return A denoiser state, or `NULL` on allocation failure.
  */
 RNNOISE_EXPORT DenoiseState *rnnoise_create(void *model);
 
@@ -53,6 +66,17 @@ RNNOISE_EXPORT DenoiseState *rnnoise_create(void *model);
  */
 RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
 
+/**
+ * Gets the memory used by one stream: the state itself and the echo
+ * canceller, feature buffers and recurrent state it owns. Model weights,
+ * feature filterbanks and FFT plans are shared between streams and not
+ * counted.
+ *
+ * @param[in] st The denoiser state.
+ * @return The number of bytes.
+ */
+RNNOISE_EXPORT int rnnoise_get_memory(const DenoiseState *st);
+
 /**
  * Processes a frame of audio for denoising.
  *
@@ -63,6 +87,254 @@ RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
  */
 RNNOISE_EXPORT float rnnoise_process_frame(DenoiseState *st, short *out, const short *in);
 
+/**
+ * Processes consecutive frames of one stream.
+ *
+ * @param[in] st The denoiser state.
+ * @param[out] out `nb_frames` denoised frames (16-bit PCM); may alias `in`.
+ * @param[in] in `nb_frames` input frames (16-bit PCM).
+ * @param[in] nb_frames The number of frames.
+ * @param[out] vad_prob Receives one voice activity probability per frame; may be `NULL`.
+ */
+RNNOISE_EXPORT void rnnoise_process_frames(DenoiseState *st, short *out, const short *in, int nb_frames, float *vad_prob);
+
+/** Processing modes, ordered from most to least expensive. */
+#define RNNOISE_MODE_FULL 0
+/** Spectral subtraction against the noise estimate instead of the RNN. */
+#define RNNOISE_MODE_NO_RNN 1
+/** Applies the previous frame's gains without any analysis. */
+#define RNNOISE_MODE_REUSE_GAINS 2
+/** Windows the input like the other modes, without any filtering. */
+#define RNNOISE_MODE_PASSTHROUGH 3
+#define RNNOISE_NB_MODES 4
+
+/**
+ * Processes a frame of audio using a cheaper processing mode.
+ *
+ * @param[in] st The denoiser state.
+ * @param[out] out The denoised audio frame (16-bit PCM).
+ * @param[in] in The input audio frame (16-bit PCM).
+ * @param[in] mode One of the `RNNOISE_MODE_*` values. Values below
+ *                 `RNNOISE_MODE_FULL` are treated as `RNNOISE_MODE_FULL` and
+ *                 values above `RNNOISE_MODE_PASSTHROUGH` as passthrough.
+ * @return The voice activity probability.
+ */
+RNNOISE_EXPORT float rnnoise_process_frame_mode(DenoiseState *st, short *out, const short *in, int mode);
+
+/** Pipeline stages timed by `rnnoise_get_stats()`. */
+#define RNNOISE_STAGE_WINDOW 0
+#define RNNOISE_STAGE_FFT 1
+#define RNNOISE_STAGE_BAND_ENERGY 2
+#define RNNOISE_STAGE_PITCH 3
+#define RNNOISE_STAGE_RNN 4
+#define RNNOISE_STAGE_GAIN 5
+#define RNNOISE_STAGE_IFFT 6
+#define RNNOISE_STAGE_OUTPUT 7
+#define RNNOISE_NB_STAGES 8
+
+/** Latency histogram buckets: bucket `b` counts durations in [2^b, 2^(b+1)) ns. */
+#define RNNOISE_STATS_BUCKETS 32
+
+typedef struct {
+    unsigned long long frames;
+    /** Total and worst-case time spent in each stage, in ns. */
+    unsigned long long stage_ns[RNNOISE_NB_STAGES];
+    unsigned long long stage_max_ns[RNNOISE_NB_STAGES];
+    unsigned int stage_hist[RNNOISE_NB_STAGES][RNNOISE_STATS_BUCKETS];
+    /** Whole-frame latency. */
+    unsigned long long frame_ns;
+    unsigned long long frame_max_ns;
+    unsigned int frame_hist[RNNOISE_STATS_BUCKETS];
+    /** Frames with a voice activity probability of at least 0.5. */
+    unsigned long long vad_frames;
+    /** Frames run in each `RNNOISE_MODE_*`. */
+    unsigned long long mode_frames[RNNOISE_NB_MODES];
+    /** Frames that ran the RNN, reused interpolated RNN gains, or fell back to
+        spectral subtraction. */
+    unsigned long long rnn_frames;
+    unsigned long long interpolated_frames;
+    unsigned long long spectral_subtraction_frames;
+} RNNoiseStats;
+
+/**
+ * Copies the per-stage timings and counters of a denoiser state. The
+ * counters are written without locks by the thread running the state, so a
+ * snapshot taken from another thread may be slightly inconsistent.
+ *
+ * @param[in] st The denoiser state.
+ * @param[out] stats Receives the statistics.
+ * @return 0 on success, -1 if the library was built without `RNNOISE_STATS`.
+ */
+RNNOISE_EXPORT int rnnoise_get_stats(const DenoiseState *st, RNNoiseStats *stats);
+
+/**
+ * Clears the statistics of a denoiser state.
+ *
+ * @param[in] st The denoiser state.
+ */
+RNNOISE_EXPORT void rnnoise_reset_stats(DenoiseState *st);
+
+#define RNNOISE_MAX_COMPLEXITY 10
+
+/**
+ * Sets how much work each frame does, from 0 (spectral subtraction only) to
+ * `RNNOISE_MAX_COMPLEXITY` (full pipeline, the default). Takes effect on the
+ * next frame and may be changed mid-stream.
+ *
+ * @param[in] st The denoiser state.
+ * @param[in] complexity The complexity level; out-of-range values are clamped.
+ */
+RNNOISE_EXPORT void rnnoise_set_complexity(DenoiseState *st, int complexity);
+
+/**
+ * Gets the current complexity level.
+ *
+ * @param[in] st The denoiser state.
+ * @return The complexity level.
+ */
+RNNOISE_EXPORT int rnnoise_get_complexity(const DenoiseState *st);
+
+/** Largest number of mel bands rnnoise_features_enable() accepts. */
+#define RNNOISE_MAX_MELS 128
+/** Largest number of frames rnnoise_features_enable() stacks (about 10 s). */
+#define RNNOISE_MAX_FEATURE_STACK 1024
+
+/**
+ * Enables log-mel (or MFCC) features computed from the denoised spectrum of
+ * each frame, before resynthesis, for speech recognizers. Mel bands span
+ * 20 Hz to 8 kHz. Call between frames on the processing thread.
+ *
+ * @param[in] st The denoiser state.
+ * @param[in] nb_mels Number of mel bands, up to `RNNOISE_MAX_MELS`, or 0 to
+ *                    disable.
+ * @param[in] nb_mfcc Number of cepstral coefficients, at most `nb_mels`, or 0
+ *                    for log-mel output.
+ * @param[in] nb_stack Number of consecutive frames returned together, up to
+ *                     `RNNOISE_MAX_FEATURE_STACK`.
+ * @return 0 on success, -1 on bad arguments or allocation failure.
+ */
+RNNOISE_EXPORT int rnnoise_features_enable(DenoiseState *st, int nb_mels, int nb_mfcc, int nb_stack);
+
+/**
+ * Gets the features of the last `nb_stack` frames, oldest first. Points into
+ * the state (no copy) and stays valid until the next processed frame.
+ *
+ * @param[in] st The denoiser state.
+ * @param[out] size Receives the number of floats; may be `NULL`.
+ * @return The features, or `NULL` if disabled.
+ */
+RNNOISE_EXPORT const float *rnnoise_get_features(const DenoiseState *st, int *size);
+
+/**
+ * Enables automatic gain control. During speech the denoised level is driven
+ * towards `target_db`, with fast attack and slow release; the gain is folded
+ * into the band gains, so it costs no extra pass over the signal. Levels are
+ * relative to a full-scale tone (0 dB). Takes effect on the next frame.
+ *
+ * @param[in] st The denoiser state.
+ * @param[in] target_db Target speech level, e.g. -20; 0 disables AGC.
+ * @param[in] max_gain_db Largest gain applied.
+ */
+RNNOISE_EXPORT void rnnoise_agc_enable(DenoiseState *st, float target_db, float max_gain_db);
+
+/**
+ * Enables acoustic echo cancellation against a playback reference. The echo
+ * is removed from the spectrum of each frame before noise suppression, with
+ * an adaptive filter covering `nb_partitions` frames of echo path (10 ms
+ * each), which must include the playback buffer latency. Call between frames
+ * on the processing thread; the playback thread may keep pushing reference
+ * meanwhile, and a canceller being replaced is freed once no push uses it.
+ *
+ * @param[in] st The denoiser state.
+ * @param[in] nb_partitions Echo tail length in frames, or 0 to disable.
+ * @return 0 on success, -1 on allocation failure.
+ */
+RNNOISE_EXPORT int rnnoise_aec_enable(DenoiseState *st, int nb_partitions);
+
+/**
+ * Queues playback samples as the echo reference. Each processed frame
+ * consumes one frame of reference; missing reference counts as silence. May
+ * be called from the playback thread while another thread processes frames
+ * or calls rnnoise_aec_enable(), but not once rnnoise_destroy() may run.
+ *
+ * @param[in] st The denoiser state.
+ * @param[in] pcm Playback samples.
+ * @param[in] nb_samples Number of samples.
+ * @param[in] sample_rate Rate of `pcm`; must divide 48000 and be at least 100.
+ * @return Number of samples queued, or -1 if echo cancellation is disabled
+ *         or the rate is unsupported.
+ */
+RNNOISE_EXPORT int rnnoise_aec_push_reference(DenoiseState *st, const short *pcm, int nb_samples, int sample_rate);
+
+/** Immutable network weights, shared by any number of streams and freed
+    when the last reference is released. */
+typedef struct RNNoiseModel RNNoiseModel;
+
+/** Publishes models to the streams attached to it. Each stream switches to
+    a newly published model at its next frame boundary; frames without a
+    switch read one counter and take no lock. C API only for now: neither
+    the JNI wrapper nor the Dart bindings expose it. */
+typedef struct RNNoiseModelRegistry RNNoiseModelRegistry;
+
+/** On a model switch, the recurrent state starts from zero. */
+#define RNNOISE_SWITCH_RESET 0
+/** On a model switch, the recurrent state is kept if the new model has
+    the same number of neurons, and reset otherwise. */
+#define RNNOISE_SWITCH_CARRY 1
+
+/** Largest recurrent layer rnnoise_model_create() accepts. The network
+    keeps its per-frame activations on the stack. */
+#define RNNOISE_MAX_NEURONS 1024
+
+/**
+ * Creates a model from float weights, converted to the weight format of the
+ * build. The inputs are the NB_BANDS+1 features of a frame.
+ *
+ * @param[in] nb_neurons Size of the recurrent layer, up to
+ *                       `RNNOISE_MAX_NEURONS`.
+ * @param[in] nb_outputs NB_BANDS band gains, optionally followed by a voice
+ *                       activity probability.
+ * @param[in] density Fraction of recurrent weight blocks kept; 1 keeps the
+ *                    matrix dense.
+ * @return A model holding one reference, or `NULL` on bad sizes or
+ *         allocation failure.
+ */
+RNNOISE_EXPORT RNNoiseModel *rnnoise_model_create(int nb_neurons, int nb_outputs,
+                                                  const float *input_weights, const float *recurrent_weights,
+                                                  const float *output_weights, const float *input_bias,
+                                                  const float *neuron_bias, const float *output_bias, float density);
+
+/** Drops a reference to a model. */
+RNNOISE_EXPORT void rnnoise_model_release(RNNoiseModel *model);
+
+/** Creates a registry with no model published. */
+RNNOISE_EXPORT RNNoiseModelRegistry *rnnoise_registry_create(void);
+
+/** Destroys a registry. Every stream must have been detached from it. */
+RNNOISE_EXPORT void rnnoise_registry_destroy(RNNoiseModelRegistry *reg);
+
+/**
+ * Publishes a model to the streams attached to the registry. Returns once no
+ * stream can still pick up the previous model, which is freed when the last
+ * stream using it has switched. Safe to call from any thread.
+ *
+ * @param[in] reg The registry.
+ * @param[in] model The new model, which gets an extra reference, or `NULL`
+ *                  for spectral subtraction only.
+ */
+RNNOISE_EXPORT void rnnoise_registry_publish(RNNoiseModelRegistry *reg, RNNoiseModel *model);
+
+/**
+ * Makes a stream follow the models published to a registry, starting with
+ * the current one. Call between frames on the processing thread.
+ *
+ * @param[in] st The denoiser state.
+ * @param[in] reg The registry, or `NULL` to detach and drop the model.
+ * @param[in] switch_mode `RNNOISE_SWITCH_RESET` or `RNNOISE_SWITCH_CARRY`.
+ * @return 0 on success, -1 on allocation failure.
+ */
+RNNOISE_EXPORT int rnnoise_model_attach(DenoiseState *st, RNNoiseModelRegistry *reg, int switch_mode);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,152 @@
+#include "scheduler.h"
+#include "arch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Weight of the newest measurement in the per-mode cost estimate (1/8). */
+#define COST_SHIFT 3
+/* Skipped modes have their estimate decayed (1/64 per frame) so that a
+   transient spike does not keep the stream degraded forever. */
+#define DECAY_SHIFT 6
+
+typedef struct {
+    DenoiseState *st;
+    short *out;
+    const short *in;
+    float *vad_prob;
+    long long deadline;
+} SchedJob;
+
+struct RNNoiseScheduler {
+    int capacity;
+    int count;
+    long long guard_ns;
+    SchedJob *heap;
+    RNNoiseSchedStats stats;
+};
+
+long long rnnoise_sched_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+RNNoiseScheduler *rnnoise_sched_create(int capacity, long long guard_ns) {
+    RNNoiseScheduler *s;
+    if (capacity <= 0) return NULL;
+    s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->heap = calloc(capacity, sizeof(*s->heap));
+    if (!s->heap) {
+        free(s);
+        return NULL;
+    }
+    s->capacity = capacity;
+    s->guard_ns = guard_ns;
+    rnnoise_sched_reset_stats(s);
+    return s;
+}
+
+void rnnoise_sched_destroy(RNNoiseScheduler *s) {
+    if (!s) return;
+    free(s->heap);
+    free(s);
+}
+
+static void heap_swap(SchedJob *a, SchedJob *b) {
+    SchedJob tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+int rnnoise_sched_submit(RNNoiseScheduler *s, DenoiseState *st, short *out, const short *in,
+                         long long deadline_ns, float *vad_prob) {
+    int i;
+    if (s->count == s->capacity) return -1;
+    i = s->count++;
+    s->heap[i].st = st;
+    s->heap[i].out = out;
+    s->heap[i].in = in;
+    s->heap[i].vad_prob = vad_prob;
+    s->heap[i].deadline = deadline_ns;
+    while (i > 0 && s->heap[(i-1)/2].deadline > s->heap[i].deadline) {
+        heap_swap(&s->heap[(i-1)/2], &s->heap[i]);
+        i = (i-1)/2;
+    }
+    return 0;
+}
+
+static SchedJob heap_pop(RNNoiseScheduler *s) {
+    int i = 0;
+    SchedJob top = s->heap[0];
+    s->heap[0] = s->heap[--s->count];
+    for (;;) {
+        int l = 2*i+1, r = 2*i+2, m = i;
+        if (l < s->count && s->heap[l].deadline < s->heap[m].deadline) m = l;
+        if (r < s->count && s->heap[r].deadline < s->heap[m].deadline) m = r;
+        if (m == i) break;
+        heap_swap(&s->heap[i], &s->heap[m]);
+        i = m;
+    }
+    return top;
+}
+
+/* Picks the most expensive mode whose predicted cost still fits before the
+   deadline. Modes we have never measured are assumed to fit, so the first
+   frame in each mode calibrates the estimate. */
+static int pick_mode(const RNNoiseScheduler *s, long long now, long long deadline) {
+    int mode;
+    long long slack = deadline - now - s->guard_ns;
+    for (mode=RNNOISE_MODE_FULL;mode<RNNOISE_MODE_PASSTHROUGH;mode++) {
+        if (s->stats.cost_ns[mode] <= slack)
+            return mode;
+    }
+    return RNNOISE_MODE_PASSTHROUGH;
+}
+
+int rnnoise_sched_run(RNNoiseScheduler *s) {
+    int n = 0;
+    while (s->count > 0) {
+        SchedJob job = heap_pop(s);
+        int i;
+        long long start = rnnoise_sched_now();
+        int mode = pick_mode(s, start, job.deadline);
+        float vad = rnnoise_process_frame_mode(job.st, job.out, job.in, mode);
+        long long end = rnnoise_sched_now();
+        long long cost = end - start;
+        long long slack = job.deadline - end;
+        RNNoiseSchedStats *stats = &s->stats;
+
+        if (job.vad_prob) *job.vad_prob = vad;
+        for (i=RNNOISE_MODE_FULL;i<mode;i++)
+            stats->cost_ns[i] -= stats->cost_ns[i] >> DECAY_SHIFT;
+        if (stats->cost_ns[mode] == 0)
+            stats->cost_ns[mode] = cost;
+        else
+            stats->cost_ns[mode] += (cost - stats->cost_ns[mode]) >> COST_SHIFT;
+        stats->frames++;
+        stats->mode_frames[mode]++;
+        if (mode != RNNOISE_MODE_FULL) stats->degradations++;
+        if (slack < 0) stats->misses++;
+        stats->slack_min_ns = OPUS_MIN32(stats->slack_min_ns, slack);
+        stats->slack_max_ns = OPUS_MAX32(stats->slack_max_ns, slack);
+        stats->slack_sum_ns += slack;
+        n++;
+    }
+    return n;
+}
+
+void rnnoise_sched_get_stats(const RNNoiseScheduler *s, RNNoiseSchedStats *stats) {
+    *stats = s->stats;
+}
+
+void rnnoise_sched_reset_stats(RNNoiseScheduler *s) {
+    long long cost[RNNOISE_NB_MODES];
+    /* The cost model survives a reset; only the counters start over. */
+    memcpy(cost, s->stats.cost_ns, sizeof(cost));
+    memset(&s->stats, 0, sizeof(s->stats));
+    memcpy(s->stats.cost_ns, cost, sizeof(cost));
+    s->stats.slack_min_ns = 0x7fffffffffffffffLL;
+    s->stats.slack_max_ns = -0x7fffffffffffffffLL - 1;
+}
@@ -0,0 +1,70 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "rnnoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Earliest-deadline-first scheduler over a set of denoiser states.
+    A scheduler is not thread-safe; use one per worker thread. */
+typedef struct RNNoiseScheduler RNNoiseScheduler;
+
+typedef struct {
+    long long frames;
+    /** Frames that completed after their deadline. */
+    long long misses;
+    /** Frames run in a cheaper mode than requested. */
+    long long degradations;
+    /** Frames run in each `RNNOISE_MODE_*`. */
+    long long mode_frames[RNNOISE_NB_MODES];
+    /** Slack (deadline minus completion time) in ns; negative on a miss. */
+    long long slack_min_ns;
+    long long slack_max_ns;
+    long long slack_sum_ns;
+    /** Smoothed cost of one frame in each mode, in ns. */
+    long long cost_ns[RNNOISE_NB_MODES];
+} RNNoiseSchedStats;
+
+/**
+ * Creates a scheduler.
+ *
+ * @param[in] capacity Maximum number of frames pending at once.
+ * @param[in] guard_ns Safety margin kept in reserve before each deadline.
+ * @return A scheduler, or `NULL` on allocation failure.
+ */
+RNNOISE_EXPORT RNNoiseScheduler *rnnoise_sched_create(int capacity, long long guard_ns);
+
+RNNOISE_EXPORT void rnnoise_sched_destroy(RNNoiseScheduler *s);
+
+/** Monotonic clock used for deadlines, in ns. */
+RNNOISE_EXPORT long long rnnoise_sched_now(void);
+
+/**
+ * Queues a frame. The buffers must stay valid until it has been run.
+ *
+ * @param[in] deadline_ns Completion deadline on the `rnnoise_sched_now()` clock.
+ * @param[out] vad_prob Receives the voice activity probability; may be `NULL`.
+ * @return 0 on success, -1 if the queue is full.
+ */
+RNNOISE_EXPORT int rnnoise_sched_submit(RNNoiseScheduler *s, DenoiseState *st, short *out, const short *in,
+                                        long long deadline_ns, float *vad_prob);
+
+/**
+ * Runs every pending frame in deadline order, stepping down to a cheaper mode
+ * whenever the full pipeline would not finish in time.
+ *
+ * @return The number of frames processed.
+ */
+RNNOISE_EXPORT int rnnoise_sched_run(RNNoiseScheduler *s);
+
+RNNOISE_EXPORT void rnnoise_sched_get_stats(const RNNoiseScheduler *s, RNNoiseSchedStats *stats);
+
+RNNOISE_EXPORT void rnnoise_sched_reset_stats(RNNoiseScheduler *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "common.h"
+
+/* Hot-path instrumentation. Everything here compiles to nothing unless the
+   library is built with RNNOISE_STATS or RNNOISE_TRACE; when enabled, each
+   state only writes its own counters and each thread its own trace buffer,
+   so no locking is needed. */
+
+#ifdef RNNOISE_TRACE
+
+void trace_record(const char *name, unsigned stream_id, unsigned long long seq, long long start_ns, long long dur_ns);
+
+static const char *const trace_stage_names[RNNOISE_NB_STAGES] = {
+    "window", "fft", "band_energy", "pitch", "rnn", "gain", "ifft", "output"
+};
+
+#endif
+
+#if defined(RNNOISE_STATS) || defined(RNNOISE_TRACE)
+
+#include <time.h>
+
+static OPUS_INLINE long long stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+static OPUS_INLINE int stats_bucket(unsigned long long ns) {
+#if defined(__GNUC__)
+    return ns > 1 ? OPUS_MIN32(63 - __builtin_clzll(ns), RNNOISE_STATS_BUCKETS-1) : 0;
+#else
+    int b = 0;
+    while (ns > 1 && b < RNNOISE_STATS_BUCKETS-1) {
+        ns >>= 1;
+        b++;
+    }
+    return b;
+#endif
+}
+
+static OPUS_INLINE void stats_begin_frame(DenoiseStateInternal *st) {
+    st->stats_frame_start = st->stats_stage_start = stats_now();
+}
+
+static OPUS_INLINE void stats_end_stage(DenoiseStateInternal *st, int stage) {
+    long long now = stats_now();
+    unsigned long long ns = now - st->stats_stage_start;
+#ifdef RNNOISE_STATS
+    st->stats.stage_ns[stage] += ns;
+    st->stats.stage_max_ns[stage] = OPUS_MAX32(st->stats.stage_max_ns[stage], ns);
+    st->stats.stage_hist[stage][stats_bucket(ns)]++;
+#endif
+#ifdef RNNOISE_TRACE
+    trace_record(trace_stage_names[stage], st->stream_id, st->frame_seq, st->stats_stage_start, ns);
+#endif
+    st->stats_stage_start = now;
+}
+
+static OPUS_INLINE void stats_end_frame(DenoiseStateInternal *st, int mode, float vad_prob) {
+    unsigned long long ns = stats_now() - st->stats_frame_start;
+#ifdef RNNOISE_STATS
+    st->stats.frames++;
+    st->stats.frame_ns += ns;
+    st->stats.frame_max_ns = OPUS_MAX32(st->stats.frame_max_ns, ns);
+    st->stats.frame_hist[stats_bucket(ns)]++;
+    st->stats.mode_frames[mode]++;
+    if (vad_prob >= .5f) st->stats.vad_frames++;
+#endif
+#ifdef RNNOISE_TRACE
+    trace_record("frame", st->stream_id, st->frame_seq, st->stats_frame_start, ns);
+    st->frame_seq++;
+#endif
+}
+
+#define STATS_BEGIN_FRAME(st) stats_begin_frame(st)
+#define STATS_END_STAGE(st, stage) stats_end_stage(st, stage)
+#define STATS_END_FRAME(st, mode, vad_prob) stats_end_frame(st, mode, vad_prob)
+
+#else
+
+#define STATS_BEGIN_FRAME(st)
+#define STATS_END_STAGE(st, stage)
+#define STATS_END_FRAME(st, mode, vad_prob)
+
+#endif
+
+#ifdef RNNOISE_STATS
+#define STATS_INC(st, counter) ((st)->stats.counter++)
+#else
+#define STATS_INC(st, counter)
+#endif
+
+#endif
@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include "trace.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef RNNOISE_TRACE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+/* Events per thread buffer; events that do not fit before the next flush
+   are dropped and counted. */
+#define TRACE_CAPACITY 8192
+
+typedef struct {
+    const char *name;
+    unsigned stream_id;
+    unsigned long long seq;
+    long long start_ns;
+    long long dur_ns;
+    /* Tracing session the event was recorded in. */
+    unsigned session;
+} TraceEvent;
+
+/* Single-producer/single-consumer ring: the owning thread advances `head`,
+   the flusher advances `tail`. */
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    long tid;
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint dropped;
+    TraceEvent events[TRACE_CAPACITY];
+} TraceBuffer;
+
+static _Atomic(TraceBuffer *) buffers;
+/* The current tracing session, or 0 while stopped. Events are tagged with
+   the session they were recorded in, so one that races with
+   rnnoise_trace_stop() is discarded rather than written into the next
+   session's file. */
+static atomic_uint tracing;
+static unsigned last_session;
+static __thread TraceBuffer *local_buffer;
+
+static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *trace_file;
+static int first_event;
+
+static long thread_id(void) {
+#if defined(__linux__)
+    return (long)syscall(SYS_gettid);
+#else
+    return (long)(size_t)pthread_self();
+#endif
+}
+
+static TraceBuffer *get_buffer(void) {
+    TraceBuffer *buf = local_buffer;
+    if (buf) return buf;
+    buf = calloc(1, sizeof(*buf));
+    if (!buf) return NULL;
+    buf->tid = thread_id();
+    /* Buffers are never freed, so a thread exiting mid-trace loses nothing. */
+    buf->next = atomic_load(&buffers);
+    while (!atomic_compare_exchange_weak(&buffers, &buf->next, buf)) {}
+    local_buffer = buf;
+    return buf;
+}
+
+void trace_record(const char *name, unsigned stream_id, unsigned long long seq, long long start_ns, long long dur_ns) {
+    TraceBuffer *buf;
+    unsigned head;
+    TraceEvent *e;
+    unsigned session = atomic_load_explicit(&tracing, memory_order_relaxed);
+    if (!session) return;
+    buf = get_buffer();
+    if (!buf) return;
+    head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&buf->tail, memory_order_acquire) >= TRACE_CAPACITY) {
+        atomic_fetch_add_explicit(&buf->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    e = &buf->events[head % TRACE_CAPACITY];
+    e->name = name;
+    e->stream_id = stream_id;
+    e->seq = seq;
+    e->start_ns = start_ns;
+    e->dur_ns = dur_ns;
+    e->session = session;
+    atomic_store_explicit(&buf->head, head + 1, memory_order_release);
+}
+
+void rnnoise_trace_event(const char *name, unsigned stream_id, unsigned long long seq,
+                         long long start_ns, long long dur_ns) {
+    trace_record(name, stream_id, seq, start_ns, dur_ns);
+}
+
+int rnnoise_trace_start(const char *path) {
+    FILE *f;
+    TraceBuffer *buf;
+    pthread_mutex_lock(&file_lock);
+    if (trace_file) {
+        pthread_mutex_unlock(&file_lock);
+        return -1;
+    }
+    f = fopen(path, "w");
+    if (!f) {
+        pthread_mutex_unlock(&file_lock);
+        return -1;
+    }
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    trace_file = f;
+    first_event = 1;
+    for (buf = atomic_load(&buffers); buf; buf = buf->next)
+        atomic_store_explicit(&buf->dropped, 0, memory_order_relaxed);
+    if (++last_session == 0) last_session = 1;
+    atomic_store(&tracing, last_session);
+    pthread_mutex_unlock(&file_lock);
+    return 0;
+}
+
+static int flush_locked(unsigned session) {
+    TraceBuffer *buf;
+    int n = 0;
+    long pid = (long)getpid();
+    for (buf = atomic_load(&buffers); buf; buf = buf->next) {
+        unsigned tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&buf->head, memory_order_acquire);
+        unsigned dropped = atomic_exchange_explicit(&buf->dropped, 0, memory_order_relaxed);
+        for (; tail != head; tail++) {
+            const TraceEvent *e = &buf->events[tail % TRACE_CAPACITY];
+            if (e->session != session) continue;
+            fprintf(trace_file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %ld, \"tid\": %ld, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"stream\": %u, \"seq\": %llu}}",
+                    first_event ? "" : ",\n", e->name, pid, buf->tid, e->start_ns/1e3, e->dur_ns/1e3,
+                    e->stream_id, e->seq);
+            first_event = 0;
+            n++;
+        }
+        atomic_store_explicit(&buf->tail, tail, memory_order_release);
+        if (dropped) {
+            fprintf(trace_file, "%s{\"name\": \"dropped\", \"ph\": \"C\", \"pid\": %ld, \"tid\": %ld, "
+                    "\"ts\": %.3f, \"args\": {\"events\": %u}}", first_event ? "" : ",\n", pid, buf->tid,
+                    buf->events[(head + TRACE_CAPACITY - 1) % TRACE_CAPACITY].start_ns/1e3, dropped);
+            first_event = 0;
+        }
+    }
+    fflush(trace_file);
+    return n;
+}
+
+int rnnoise_trace_flush(void) {
+    int n = -1;
+    pthread_mutex_lock(&file_lock);
+    if (trace_file) n = flush_locked(last_session);
+    pthread_mutex_unlock(&file_lock);
+    return n;
+}
+
+int rnnoise_trace_stop(void) {
+    int rc = -1;
+    pthread_mutex_lock(&file_lock);
+    if (trace_file) {
+        atomic_store(&tracing, 0);
+        flush_locked(last_session);
+        fprintf(trace_file, "\n]}\n");
+        rc = fclose(trace_file) == 0 ? 0 : -1;
+        trace_file = NULL;
+    }
+    pthread_mutex_unlock(&file_lock);
+    return rc;
+}
+
+#else
+
+int rnnoise_trace_start(const char *path) {
+    (void)path;
+    return -1;
+}
+
+int rnnoise_trace_flush(void) {
+    return -1;
+}
+
+int rnnoise_trace_stop(void) {
+    return -1;
+}
+
+void rnnoise_trace_event(const char *name, unsigned stream_id, unsigned long long seq,
+                         long long start_ns, long long dur_ns) {
+    (void)name;
+    (void)stream_id;
+    (void)seq;
+    (void)start_ns;
+    (void)dur_ns;
+}
+
+#endif
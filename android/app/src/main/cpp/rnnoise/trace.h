@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "rnnoise.h"
+
+/* Per-frame pipeline tracing in the Chrome trace event format, which both
+   chrome://tracing and the Perfetto UI load. Events are written by each
+   thread into its own lock-free ring buffer and drained to the output file
+   by rnnoise_trace_flush(). Frame and stage events are only emitted when
+   the library is built with RNNOISE_TRACE; without it every call below
+   fails or does nothing. */
+
+/**
+ * Opens the trace file and starts recording.
+ *
+ * @param[in] path Output path for the JSON trace.
+ * @return 0 on success, -1 on error or if tracing is not compiled in.
+ */
+RNNOISE_EXPORT int rnnoise_trace_start(const char *path);
+
+/**
+ * Moves buffered events from every thread into the trace file. Safe to call
+ * periodically from a background thread while frames are being processed.
+ *
+ * @return The number of events written, or -1 if tracing is not running.
+ */
+RNNOISE_EXPORT int rnnoise_trace_flush(void);
+
+/**
+ * Flushes, finishes the JSON document and stops recording. Events that
+ * other threads are recording while it runs are discarded, never written
+ * into the next trace.
+ *
+ * @return 0 on success, -1 if tracing was not running.
+ */
+RNNOISE_EXPORT int rnnoise_trace_stop(void);
+
+/**
+ * Records an event from outside the denoiser, e.g. capture or playback, so
+ * it lines up with the frame timeline.
+ *
+ * @param[in] name Event name; must stay valid until the next flush.
+ * @param[in] stream_id Stream the event belongs to.
+ * @param[in] seq Frame sequence number.
+ * @param[in] start_ns Start time on the CLOCK_MONOTONIC clock, in ns.
+ * @param[in] dur_ns Duration in ns.
+ */
+RNNOISE_EXPORT void rnnoise_trace_event(const char *name, unsigned stream_id, unsigned long long seq,
+                                        long long start_ns, long long dur_ns);
+
+/**
+ * Tags the trace events of a denoiser state with a stream ID.
+ *
+ * @param[in] st The denoiser state.
+ * @param[in] stream_id The stream ID.
+ */
+RNNOISE_EXPORT void rnnoise_set_stream_id(DenoiseState *st, unsigned stream_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
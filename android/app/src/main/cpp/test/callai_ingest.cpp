@@ -0,0 +1,178 @@
+/* Unit tests for the CSV contact parser in libcallai_ingest.
+
+   Usage:
+     callai_ingest_test [TMPDIR] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "contact_ingest.h"
+
+namespace {
+
+int failures = 0;
+
+typedef std::vector<std::pair<std::string, std::string>> Rows;
+
+void check(bool cond, const char *what) {
+    if (!cond) {
+        fprintf(stderr, "FAIL %s\n", what);
+        failures++;
+    }
+}
+
+/* Writes contents to a file, parses it and returns the status, filling rows
+   with the (name, phone) pairs on success. */
+int parse(const std::string &path, const std::string &contents, Rows &rows) {
+    FILE *f = fopen(path.c_str(), "wb");
+    rows.clear();
+    if (f == NULL) return CALLAI_INGEST_ERR_IO;
+    fwrite(contents.data(), 1, contents.size(), f);
+    fclose(f);
+    ContactTable *table = callai_ingest_open(path.c_str());
+    unlink(path.c_str());
+    if (table == NULL) return CALLAI_INGEST_ERR_IO;
+    int status = callai_ingest_run(table);
+    if (status == CALLAI_INGEST_OK) {
+        const uint32_t *name_offsets, *phone_offsets;
+        const uint8_t *names = callai_ingest_column(table, CALLAI_INGEST_NAME, &name_offsets);
+        const uint8_t *phones = callai_ingest_column(table, CALLAI_INGEST_PHONE, &phone_offsets);
+        for (int32_t i = 0; i < callai_ingest_rows(table); i++) {
+            rows.emplace_back(std::string(reinterpret_cast<const char *>(names) + name_offsets[i],
+                                          name_offsets[i + 1] - name_offsets[i]),
+                              std::string(reinterpret_cast<const char *>(phones) + phone_offsets[i],
+                                          phone_offsets[i + 1] - phone_offsets[i]));
+        }
+        check(callai_ingest_progress(table) == callai_ingest_size(table), "progress ends at the file size");
+    }
+    callai_ingest_close(table);
+    return status;
+}
+
+/* Expected rows as alternating names and phones. */
+void check_rows(const char *what, const std::string &path, const std::string &contents,
+                std::vector<const char *> expected) {
+    Rows rows;
+    bool ok = parse(path, contents, rows) == CALLAI_INGEST_OK && rows.size() * 2 == expected.size();
+    for (size_t i = 0; ok && i < rows.size(); i++)
+        ok = rows[i].first == expected[2 * i] && rows[i].second == expected[2 * i + 1];
+    if (!ok) {
+        fprintf(stderr, "FAIL %s: got", what);
+        for (const auto &r : rows) fprintf(stderr, " [%s|%s]", r.first.c_str(), r.second.c_str());
+        fprintf(stderr, "\n");
+        failures++;
+    }
+}
+
+void test_quoting(const std::string &path) {
+    check_rows("quoted fields", path,
+               "name,phone\n"
+               "\"Doe, Jane\",\"98765 43210\"\n"
+               "\"Say \"\"hi\"\"\",9876543211\n"
+               "\"\"\"\",9876543212\n",
+               {"Doe, Jane", "9876543210", "Say \"hi\"", "9876543211", "\"", "9876543212"});
+    /* Text after the closing quote is kept, and a quoted field may span
+       lines. */
+    check_rows("quoted field tails", path,
+               "name,phone\n"
+               "\"Jane\" Doe,9876543210\n"
+               "\"Two\nlines\",9876543211\n",
+               {"Jane Doe", "9876543210", "Two\nlines", "9876543211"});
+    /* A quote inside an unquoted field is literal. */
+    check_rows("stray quotes", path,
+               "name,phone\n"
+               "O\"Brien,9876543210\n"
+               "5'11\" Tall,98765\"43211\n",
+               {"O\"Brien", "9876543210", "5'11\" Tall", "9876543211"});
+    /* An unterminated quote runs to the end of the file. */
+    check_rows("unterminated quote", path,
+               "name,phone\n"
+               "Jane,\"9876543210\n",
+               {"Jane", "9876543210"});
+}
+
+void test_line_endings(const std::string &path) {
+    check_rows("CRLF", path,
+               "name,phone\r\n"
+               "Jane,9876543210\r\n"
+               "John,+1 415 555 0100\r\n",
+               {"Jane", "9876543210", "John", "+14155550100"});
+    check_rows("no final newline", path,
+               "name,phone\nJane,9876543210",
+               {"Jane", "9876543210"});
+    check_rows("BOM", path,
+               "\xEF\xBB\xBFname,phone\r\n"
+               "Jane,9876543210.0\r\n",
+               {"Jane", "9876543210"});
+}
+
+void test_rows(const std::string &path) {
+    Rows rows;
+    /* The first row is always the header, whatever it holds. */
+    check_rows("header", path,
+               "Jane,9876543210\n"
+               "John,9876543211\n",
+               {"John", "9876543211"});
+    check(parse(path, "name\nJane\n", rows) == CALLAI_INGEST_ERR_FORMAT, "one-column header");
+    check(parse(path, "", rows) == CALLAI_INGEST_ERR_FORMAT, "empty file");
+    check(callai_ingest_open((path + ".missing").c_str()) == NULL, "open missing file");
+    check_rows("skipped rows", path,
+               "name,phone,notes\n"
+               "# exported 2024-01-01,,\n"
+               "  #Jane,9876543210\n"
+               "NoPhone\n"
+               ",9876543211\n"
+               "   ,9876543212\n"
+               "Empty,\n"
+               "Letters,n/a\n"
+               "Plus,+\n"
+               "\n"
+               "  Jane Doe\t, 98765-43213 ,extra,columns\n",
+               {"Jane Doe", "9876543213"});
+}
+
+/* Rows whose delimiters fall on both sides of every 16-byte block boundary,
+   so the vector scan and its scalar tail both find them. */
+void test_block_boundaries(const std::string &path) {
+    for (size_t pad = 0; pad < 40; pad++) {
+        std::string name(pad, 'x');
+        std::string contents = "name,phone\n" + name + ",9876543210\n\"" + name + "\"\"q\",9876543211\n";
+        char what[64];
+        snprintf(what, sizeof(what), "block boundary, %zu byte name", pad);
+        if (pad == 0) {
+            check_rows(what, path, contents, {"\"q", "9876543211"});
+        } else {
+            check_rows(what, path, contents, {name.c_str(), "9876543210", (name + "\"q").c_str(), "9876543211"});
+        }
+    }
+}
+
+/* Enough skipped rows to cross several progress steps. */
+void test_large(const std::string &path) {
+    std::string contents = "name,phone\n";
+    while (contents.size() < 300000) contents += "# a comment line that is skipped,0\n";
+    contents += "Jane,9876543210\n";
+    check_rows("long run of skipped rows", path, contents, {"Jane", "9876543210"});
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const char *dir = argc > 1 ? argv[1] : getenv("TMPDIR");
+    std::string path = std::string(dir ? dir : "/tmp") + "/callai_ingest_test.csv";
+    test_quoting(path);
+    test_line_endings(path);
+    test_rows(path);
+    test_block_boundaries(path);
+    test_large(path);
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("callai_ingest: OK\n");
+    return 0;
+}
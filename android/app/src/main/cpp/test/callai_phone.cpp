@@ -0,0 +1,172 @@
+/* Unit tests for phone number normalization and the called-number set in
+   libcallai_ingest.
+
+   Usage:
+     callai_phone_test [TMPDIR] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include "phone_index.h"
+
+namespace {
+
+int failures = 0;
+
+/* Expected "+<digits>", or NULL for an invalid number. */
+void check_normalize(const char *raw, int32_t cc, const char *expected) {
+    char out[17];
+    uint64_t key = callai_phone_normalize(raw, static_cast<int32_t>(strlen(raw)), cc);
+    const char *got = key == CALLAI_PHONE_INVALID || callai_phone_format(key, out, sizeof(out)) == 0
+                      ? NULL : out;
+    if ((got == NULL) != (expected == NULL) || (got != NULL && strcmp(got, expected) != 0)) {
+        fprintf(stderr, "FAIL normalize(\"%s\", %d): got %s, expected %s\n", raw, cc,
+                got ? got : "invalid", expected ? expected : "invalid");
+        failures++;
+    }
+}
+
+void check(bool cond, const char *what) {
+    if (!cond) {
+        fprintf(stderr, "FAIL %s\n", what);
+        failures++;
+    }
+}
+
+void test_normalize() {
+    /* One number in the formats users and spreadsheets produce. */
+    check_normalize("+91 98765 43210", 91, "+919876543210");
+    check_normalize("098765-43210", 91, "+919876543210");
+    check_normalize("919876543210", 91, "+919876543210");
+    check_normalize("9876543210", 91, "+919876543210");
+    check_normalize("9876543210.0", 91, "+919876543210");
+    check_normalize("919876543210.0", 91, "+919876543210");
+    check_normalize("00919876543210", 91, "+919876543210");
+    check_normalize("(+91) 98765-43210", 91, "+919876543210");
+    check_normalize("  9876543210 \t", 91, "+919876543210");
+    /* International prefixes keep their own country code. */
+    check_normalize("0044 20 7946 0958", 91, "+442079460958");
+    check_normalize("+1 (415) 555-0100", 91, "+14155550100");
+    check_normalize("004420794609580.0", 91, "+4420794609580");
+    /* 12 digits starting with the country code but not 10 national digits
+       after it get the code prepended. */
+    check_normalize("91987654321", 91, "+9191987654321");
+    check_normalize("4155550100", 1, "+14155550100");
+    /* A '+' after digits is ignored, only the leading one counts. */
+    check_normalize("98765+43210", 91, "+919876543210");
+    check_normalize("", 91, NULL);
+    check_normalize("abc", 91, NULL);
+    check_normalize("12345", 91, NULL);
+    check_normalize(".0", 91, NULL);
+    check_normalize("00", 91, NULL);
+    check_normalize("+0091 98765 43210", 91, NULL);
+    check_normalize("+1234567890123456", 91, NULL);
+    check_normalize("123456789012345678901234567890", 91, NULL);
+    /* Not terminated: only len bytes are read. */
+    check(callai_phone_normalize("9876543210999", 10, 91) == callai_phone_normalize("9876543210", 10, 91),
+          "normalize reads past len");
+}
+
+void test_set(const char *dir) {
+    const char *numbers[] = {"9876543210", "+14155550100", "0044 20 7946 0958"};
+    std::string path = std::string(dir) + "/callai_phone_test.bin";
+    PhoneSet *set = callai_phone_set_create(2);
+    PhoneSet *loaded = callai_phone_set_create(0);
+    check(set != NULL && loaded != NULL, "set_create");
+    if (set == NULL || loaded == NULL) return;
+    for (int i = 0; i < 1000; i++) {
+        char raw[16];
+        snprintf(raw, sizeof(raw), "98%08d", i);
+        check(callai_phone_set_insert(set, callai_phone_normalize(raw, 10, 91)) == 1, "insert grows the set");
+    }
+    for (const char *n : numbers) {
+        uint64_t key = callai_phone_normalize(n, static_cast<int32_t>(strlen(n)), 91);
+        check(callai_phone_set_insert(set, key) == 1, "insert new key");
+        check(callai_phone_set_insert(set, key) == 0, "insert repeated key");
+    }
+    check(callai_phone_set_insert(set, CALLAI_PHONE_INVALID) == 0, "insert invalid key");
+    check(callai_phone_set_size(set) == 1003, "set size");
+    check(callai_phone_set_save(set, path.c_str()) == CALLAI_INGEST_OK, "save");
+    check(callai_phone_set_load(loaded, path.c_str()) == CALLAI_INGEST_OK, "load");
+    check(callai_phone_set_size(loaded) == 1003, "loaded size");
+    check(callai_phone_set_contains(loaded, callai_phone_normalize("+91 98765 43210", 15, 91)), "loaded key");
+    check(callai_phone_set_contains(loaded, callai_phone_normalize("9800000999", 10, 91)), "loaded key");
+    check(!callai_phone_set_contains(loaded, callai_phone_normalize("9876543211", 10, 91)), "missing key");
+    check(callai_phone_set_load(loaded, (path + ".missing").c_str()) == CALLAI_INGEST_OK, "load missing file");
+    unlink(path.c_str());
+    callai_phone_set_destroy(set);
+    callai_phone_set_destroy(loaded);
+}
+
+/* One number in several formats, a number already called, and bad rows,
+   through the parser as the app imports them. */
+void test_dedup(const char *dir) {
+    static const uint8_t expected[] = {
+        CALLAI_PHONE_NEW, CALLAI_PHONE_DUPLICATE, CALLAI_PHONE_DUPLICATE, CALLAI_PHONE_DUPLICATE,
+        CALLAI_PHONE_CALLED, CALLAI_PHONE_CALLED, CALLAI_PHONE_BAD, CALLAI_PHONE_NEW,
+        CALLAI_PHONE_DUPLICATE, CALLAI_PHONE_BAD, CALLAI_PHONE_NEW,
+    };
+    const int32_t rows = sizeof(expected);
+    std::string path = std::string(dir) + "/callai_phone_test.csv";
+    FILE *f = fopen(path.c_str(), "wb");
+    check(f != NULL, "write csv");
+    if (f == NULL) return;
+    fputs("name,phone\n"
+          "A,+91 98765 43210\n"
+          "B,098765-43210\n"
+          "C,9876543210.0\n"
+          "D,00919876543210\n"
+          "E,+1 (415) 555-0100\n"
+          "F,001 415 555 0100\n"
+          "G,12345\n"
+          "H,0044 20 7946 0958\n"
+          "I,\"+44 20 7946 0958\"\n"
+          "J,+0091 98765 43210\n"
+          "K,98765 43211\n", f);
+    fclose(f);
+    ContactTable *table = callai_ingest_open(path.c_str());
+    unlink(path.c_str());
+    check(table != NULL && callai_ingest_run(table) == CALLAI_INGEST_OK, "parse csv");
+    if (table == NULL) return;
+    check(callai_ingest_rows(table) == rows, "csv rows");
+    if (callai_ingest_rows(table) != rows) {
+        callai_ingest_close(table);
+        return;
+    }
+
+    PhoneSet *called = callai_phone_set_create(0);
+    uint64_t keys[sizeof(expected)];
+    uint8_t status[sizeof(expected)];
+    callai_phone_set_insert(called, callai_phone_normalize("+14155550100", 12, 91));
+    check(callai_phone_dedup(table, called, 91, keys, status) == 3, "dedup new count");
+    for (int32_t i = 0; i < rows; i++) {
+        if (status[i] != expected[i]) {
+            fprintf(stderr, "FAIL dedup row %d: status %d, expected %d\n", i, status[i], expected[i]);
+            failures++;
+        }
+    }
+    check(keys[0] == keys[3] && keys[7] == keys[8] && keys[4] == keys[5], "dedup keys");
+    check(keys[6] == CALLAI_PHONE_INVALID && keys[9] == CALLAI_PHONE_INVALID, "dedup bad keys");
+    /* Without a called set the called numbers count as new. */
+    check(callai_phone_dedup(table, NULL, 91, keys, status) == 4, "dedup without called set");
+    check(status[4] == CALLAI_PHONE_NEW && status[5] == CALLAI_PHONE_DUPLICATE, "dedup without called set");
+    callai_phone_set_destroy(called);
+    callai_ingest_close(table);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const char *dir = argc > 1 ? argv[1] : getenv("TMPDIR");
+    test_normalize();
+    test_set(dir ? dir : "/tmp");
+    test_dedup(dir ? dir : "/tmp");
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("callai_phone: OK\n");
+    return 0;
+}
@@ -0,0 +1,170 @@
+/* Echo cancellation checks on a synthetic echo path.
+
+   Usage:
+     rnnoise_aec_test
+
+   The microphone hears the playback reference attenuated and delayed,
+   with nothing else in the room. After the filter has converged, the echo
+   return loss enhancement (microphone over residual spectrum energy) must
+   reach MIN_ERLE_ALIGNED_DB for a delay of whole frames and
+   MIN_ERLE_FRACTIONAL_DB for one that is not, the circular-convolution
+   approximation being exact only in the first case. The same echo is also
+   run through the public API, with the reference pushed at 16 kHz. The
+   fixed-point build has no canceller and only checks that enabling it
+   fails. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "aec.h"
+#include "rnnoise.h"
+
+#define FRAME FRAME_SIZE
+#define FRAMES 1500
+/* Frames left out of the measurement while the filter converges. */
+#define CONVERGENCE 1000
+#define PARTITIONS 8
+#define ECHO_GAIN .5
+#define MIN_ERLE_ALIGNED_DB 35.
+#define MIN_ERLE_FRACTIONAL_DB 9.
+#define MIN_API_REDUCTION_DB 20.
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+#ifndef FIXED_POINT
+
+static unsigned rng_state = 1;
+
+static float rng_uniform(void) {
+    rng_state = rng_state*1664525u + 1013904223u;
+    return (float)(rng_state >> 8)*(2.f/16777216.f) - 1.f;
+}
+
+/* Far-end speech stand-in: noise shaped by a one-pole low-pass, at about
+   -15 dBFS. */
+static short *make_reference(int len) {
+    short *ref = malloc(len*sizeof(short));
+    float lp = 0;
+    int i;
+    for (i=0;i<len;i++) {
+        lp = .7f*lp + .3f*rng_uniform();
+        ref[i] = (short)(20000*lp);
+    }
+    return ref;
+}
+
+static void make_echo(short *mic, const short *ref, int len, int delay) {
+    int i;
+    for (i=0;i<len;i++)
+        mic[i] = i < delay ? 0 : (short)(ECHO_GAIN*ref[i - delay]);
+}
+
+static double spectrum_energy(const kiss_fft_cpx *X) {
+    double e = 0;
+    int i;
+    for (i=0;i<=FRAME/2;i++) e += (double)X[i].r*X[i].r + (double)X[i].i*X[i].i;
+    return e;
+}
+
+/* Runs the canceller on the spectra as the denoiser does and returns the
+   ERLE after convergence, in dB. */
+static double erle(const short *ref, const short *mic) {
+    EchoCanceller *aec = aec_create(PARTITIONS);
+    opus_val32 x[FRAME];
+    kiss_fft_cpx X[FRAME];
+    double mic_energy = 0, residual_energy = 0;
+    int k, i;
+    for (k=0;k<FRAMES;k++) {
+        double e;
+        aec_push_reference(aec, &ref[k*FRAME], FRAME);
+        for (i=0;i<FRAME;i++) x[i] = mic[k*FRAME + i];
+        apply_window(x);
+        forward_transform(X, x);
+        e = spectrum_energy(X);
+        aec_process(aec, X);
+        if (k >= CONVERGENCE) {
+            mic_energy += e;
+            residual_energy += spectrum_energy(X);
+        }
+    }
+    aec_destroy(aec);
+    return 10*log10(mic_energy/(residual_energy + 1e-9));
+}
+
+static double output_energy(const short *ref16k, const short *mic, int aec) {
+    DenoiseState *st = rnnoise_create(NULL);
+    short out[FRAME];
+    double e = 0;
+    int k, i;
+    if (aec) CHECK(rnnoise_aec_enable(st, PARTITIONS) == 0, "cannot enable echo cancellation");
+    for (k=0;k<FRAMES;k++) {
+        if (aec)
+            CHECK(rnnoise_aec_push_reference(st, &ref16k[k*FRAME/3], FRAME/3, 16000) == FRAME/3,
+                  "reference push truncated");
+        rnnoise_process_frame(st, out, &mic[k*FRAME]);
+        if (k >= CONVERGENCE)
+            for (i=0;i<FRAME;i++) e += (double)out[i]*out[i];
+    }
+    rnnoise_destroy(st);
+    return e;
+}
+
+static void test_echo(void) {
+    int len = FRAMES*FRAME, i;
+    short *ref = make_reference(len), *mic = malloc(len*sizeof(short)), *ref16k, *up;
+    double aligned, fractional, reduction;
+
+    make_echo(mic, ref, len, 2*FRAME);
+    aligned = erle(ref, mic);
+    CHECK(aligned >= MIN_ERLE_ALIGNED_DB, "frame-aligned delay: %.1f dB ERLE", aligned);
+    make_echo(mic, ref, len, 2*FRAME + 37);
+    fractional = erle(ref, mic);
+    CHECK(fractional >= MIN_ERLE_FRACTIONAL_DB, "fractional delay: %.1f dB ERLE", fractional);
+
+    /* The echo is made from the reference upsampled as the library does it:
+       linear interpolation within each push, holding the last sample. */
+    ref16k = malloc(len/3*sizeof(short));
+    up = malloc(len*sizeof(short));
+    for (i=0;i<len/3;i++) ref16k[i] = ref[3*i];
+    for (i=0;i<len;i++) {
+        int cur = ref16k[i/3];
+        int next = (i/3 + 1) % (FRAME/3) != 0 ? ref16k[i/3 + 1] : cur;
+        up[i] = (short)(cur + (next - cur)*(i%3)/3);
+    }
+    make_echo(mic, up, len, 2*FRAME);
+    reduction = 10*log10(output_energy(ref16k, mic, 0)/(output_energy(ref16k, mic, 1) + 1));
+    CHECK(reduction >= MIN_API_REDUCTION_DB, "through the API: echo reduced by %.1f dB", reduction);
+    free(ref);
+    free(mic);
+    free(ref16k);
+    free(up);
+}
+
+#else
+
+static void test_echo(void) {
+    DenoiseState *st = rnnoise_create(NULL);
+    CHECK(rnnoise_aec_enable(st, PARTITIONS) == -1, "echo cancellation enabled in fixed point");
+    rnnoise_destroy(st);
+}
+
+#endif
+
+int main(void) {
+    test_echo();
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("aec: OK\n");
+    return 0;
+}
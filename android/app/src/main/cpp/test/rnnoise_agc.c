@@ -0,0 +1,128 @@
+/* Convergence check for the automatic gain control.
+
+   Usage:
+     rnnoise_agc_test
+
+   Plays a synthetic talker (300 ms voiced syllables with 200 ms pauses, in
+   noise 20 dB below the talker) at several input levels with the AGC aiming
+   at TARGET_DB. Once the gain has settled, the output level of the syllables
+   must be within MAX_ERROR_DB of the target at every input level. Levels
+   are measured like the AGC's target: relative to a full-scale tone put
+   through the same analysis window. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rnnoise.h"
+
+#define SAMPLE_RATE 48000
+#define FRAME 480
+#define SECONDS 8
+#define FRAMES (SECONDS*SAMPLE_RATE/FRAME)
+/* Frames left out of the measurement while the gain settles. */
+#define SETTLE_FRAMES (4*SAMPLE_RATE/FRAME)
+#define SYLLABLE_FRAMES 30
+#define PAUSE_FRAMES 20
+#define TARGET_DB -20.f
+#define MAX_GAIN_DB 40.f
+#define MAX_ERROR_DB 1.
+/* Uniform noise at 20 dB below the talker. */
+#define NOISE (.1*sqrt(3.))
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned rng_state = 1;
+
+static float rng_uniform(void) {
+    rng_state = rng_state*1664525u + 1013904223u;
+    return (float)(rng_state >> 8)*(2.f/16777216.f) - 1.f;
+}
+
+static int in_syllable(int frame) {
+    return frame % (SYLLABLE_FRAMES + PAUSE_FRAMES) < SYLLABLE_FRAMES;
+}
+
+/* Syllables of a 200 Hz voice with a falling spectrum, whose RMS is
+   level_db against a full-scale tone, in noise. A whole number of pitch
+   periods fits in a frame, so every frame of a syllable has the same level. */
+static void make_talker(short *pcm, float level_db) {
+    double rms = 32767/sqrt(2)*pow(10., level_db/20.), e = 0;
+    long n = 0;
+    int i, h;
+    double *v = calloc(FRAMES*FRAME, sizeof(double));
+    for (i=0;i<FRAMES*FRAME;i++) {
+        if (!in_syllable(i/FRAME)) continue;
+        for (h=1;h<=10;h++)
+            v[i] += sin(2*M_PI*200*h*i/SAMPLE_RATE + h)/h;
+        e += v[i]*v[i];
+        n++;
+    }
+    for (i=0;i<FRAMES*FRAME;i++) {
+        double x = (v[i]/sqrt(e/n) + NOISE*rng_uniform())*rms;
+        pcm[i] = (short)(x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+    }
+    free(v);
+}
+
+/* Mean power of windowed frames of a full-scale tone, through passthrough. */
+static double full_scale_power(void) {
+    DenoiseState *st = rnnoise_create(NULL);
+    short in[FRAME], out[FRAME];
+    double e = 0;
+    int i;
+    for (i=0;i<FRAME;i++) in[i] = (short)(32767*sin(2*M_PI*1000*i/SAMPLE_RATE));
+    rnnoise_process_frame_mode(st, out, in, RNNOISE_MODE_PASSTHROUGH);
+    for (i=0;i<FRAME;i++) e += (double)out[i]*out[i];
+    rnnoise_destroy(st);
+    return e/FRAME;
+}
+
+/* Returns the output level of the settled syllables in dB. */
+static double run(const short *pcm, double reference) {
+    DenoiseState *st = rnnoise_create(NULL);
+    short out[FRAME];
+    double e = 0;
+    long n = 0;
+    int k, i;
+    rnnoise_agc_enable(st, TARGET_DB, MAX_GAIN_DB);
+    for (k=0;k<FRAMES;k++) {
+        rnnoise_process_frame(st, out, &pcm[k*FRAME]);
+        /* Whole syllable frames only, away from the onset. */
+        if (k >= SETTLE_FRAMES && in_syllable(k) && k % (SYLLABLE_FRAMES + PAUSE_FRAMES) >= 3) {
+            for (i=0;i<FRAME;i++) e += (double)out[i]*out[i];
+            n += FRAME;
+        }
+    }
+    rnnoise_destroy(st);
+    return 10*log10(e/n/reference);
+}
+
+int main(void) {
+    static const float levels[] = {-20, -40, -54};
+    short *pcm = malloc(FRAMES*FRAME*sizeof(short));
+    double reference = full_scale_power();
+    int l;
+    for (l=0;l<(int)(sizeof(levels)/sizeof(levels[0]));l++) {
+        double out_db;
+        make_talker(pcm, levels[l]);
+        out_db = run(pcm, reference);
+        CHECK(fabs(out_db - TARGET_DB) <= MAX_ERROR_DB, "input at %.0f dB: output at %.1f dB, target %.0f dB",
+              levels[l], out_db, TARGET_DB);
+    }
+    free(pcm);
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("agc: OK\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+/* Checks for the complexity levels of the denoiser.
+
+   Usage:
+     rnnoise_complexity_test
+
+   Runs a steady tone in noise through a seeded model at every complexity
+   level, and once more with the level changed on every frame. Switching
+   levels must not make the output level jump more than it does at any
+   fixed level. In a RNNOISE_STATS build it also checks that the
+   alternate-frame levels run the RNN on every other frame. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rnnoise.h"
+
+#define FRAME 480
+#define FRAMES 200
+#define WARMUP 20
+/* Extra frame-to-frame level change allowed when switching, in dB. */
+#define MAX_EXTRA_STEP_DB 1.
+#define MODEL_NEURONS 32
+#define MODEL_INPUTS 23
+#define MODEL_OUTPUTS 23
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned rng_state;
+
+static float rng_uniform(void) {
+    rng_state = rng_state*1664525u + 1013904223u;
+    return (float)(rng_state >> 8)*(2.f/16777216.f) - 1.f;
+}
+
+/* Seeded like the golden test's models: small weights centred on a band
+   log-energy of 5, so the network tracks its input. */
+static RNNoiseModel *make_model(void) {
+    float input_weights[MODEL_INPUTS*MODEL_NEURONS], recurrent_weights[MODEL_NEURONS*MODEL_NEURONS];
+    float output_weights[MODEL_NEURONS*MODEL_OUTPUTS];
+    float input_bias[MODEL_NEURONS], neuron_bias[MODEL_NEURONS], output_bias[MODEL_OUTPUTS];
+    int i, j;
+    rng_state = 3000u;
+    for (i=0;i<MODEL_INPUTS*MODEL_NEURONS;i++) input_weights[i] = .1f*rng_uniform();
+    for (i=0;i<MODEL_NEURONS*MODEL_NEURONS;i++) recurrent_weights[i] = .3f*rng_uniform();
+    for (i=0;i<MODEL_NEURONS*MODEL_OUTPUTS;i++) output_weights[i] = .5f*rng_uniform();
+    for (i=0;i<MODEL_NEURONS;i++) {
+        input_bias[i] = .2f*rng_uniform();
+        for (j=0;j<MODEL_INPUTS-1;j++) input_bias[i] -= 5*input_weights[i*MODEL_INPUTS + j];
+        neuron_bias[i] = .2f*rng_uniform();
+    }
+    for (i=0;i<MODEL_OUTPUTS;i++) output_bias[i] = .5f*rng_uniform();
+    return rnnoise_model_create(MODEL_NEURONS, MODEL_OUTPUTS, input_weights, recurrent_weights, output_weights,
+                                input_bias, neuron_bias, output_bias, 1);
+}
+
+static short input[FRAMES*FRAME];
+
+static void make_input(void) {
+    int i;
+    rng_state = 1u;
+    for (i=0;i<FRAMES*FRAME;i++)
+        input[i] = (short)(4000*sin(2*M_PI*300*i/48000.) + 1500*sin(2*M_PI*1250*i/48000.)
+                           + 1000*rng_uniform());
+}
+
+/* Runs the input at a fixed complexity, or cycling through every level if
+   complexity is negative, and returns the largest frame-to-frame change of
+   the output level in dB after the warm-up. */
+static double run(RNNoiseModelRegistry *reg, int complexity, RNNoiseStats *stats) {
+    DenoiseState *st = rnnoise_create(NULL);
+    short out[FRAME];
+    double prev_db = 0, max_step = 0;
+    int k, i;
+    rnnoise_model_attach(st, reg, RNNOISE_SWITCH_RESET);
+    for (k=0;k<FRAMES;k++) {
+        double e = 1;
+        rnnoise_set_complexity(st, complexity >= 0 ? complexity : k % (RNNOISE_MAX_COMPLEXITY + 1));
+        rnnoise_process_frame(st, out, &input[k*FRAME]);
+        for (i=0;i<FRAME;i++) e += (double)out[i]*out[i];
+        e = 10*log10(e/FRAME);
+        if (k > WARMUP && fabs(e - prev_db) > max_step) max_step = fabs(e - prev_db);
+        prev_db = e;
+    }
+    if (rnnoise_get_stats(st, stats) != 0) stats->frames = 0;
+    rnnoise_destroy(st);
+    return max_step;
+}
+
+int main(void) {
+    DenoiseState *st = rnnoise_create(NULL);
+    RNNoiseModelRegistry *reg = rnnoise_registry_create();
+    RNNoiseModel *model = make_model();
+    RNNoiseStats stats;
+    double fixed_step = 0, switching_step;
+    int c;
+
+    rnnoise_set_complexity(st, -3);
+    CHECK(rnnoise_get_complexity(st) == 0, "complexity -3 read back as %d", rnnoise_get_complexity(st));
+    rnnoise_set_complexity(st, 99);
+    CHECK(rnnoise_get_complexity(st) == RNNOISE_MAX_COMPLEXITY, "complexity 99 read back as %d",
+          rnnoise_get_complexity(st));
+    rnnoise_destroy(st);
+
+    rnnoise_registry_publish(reg, model);
+    rnnoise_model_release(model);
+    make_input();
+    for (c=0;c<=RNNOISE_MAX_COMPLEXITY;c++) {
+        double step = run(reg, c, &stats);
+        if (step > fixed_step) fixed_step = step;
+        if (stats.frames == 0) continue;
+        if (c < 2) {
+            CHECK(stats.rnn_frames == 0 && stats.spectral_subtraction_frames == FRAMES,
+                  "complexity %d: %llu RNN frames", c, stats.rnn_frames);
+        } else if (c < 6) {
+            CHECK(stats.rnn_frames == FRAMES/2 && stats.interpolated_frames == FRAMES/2,
+                  "complexity %d: %llu RNN and %llu interpolated frames", c, stats.rnn_frames,
+                  stats.interpolated_frames);
+        } else {
+            CHECK(stats.rnn_frames == FRAMES && stats.interpolated_frames == 0,
+                  "complexity %d: %llu RNN frames", c, stats.rnn_frames);
+        }
+    }
+    switching_step = run(reg, -1, &stats);
+    CHECK(switching_step <= fixed_step + MAX_EXTRA_STEP_DB,
+          "switching levels every frame: %.2f dB steps, %.2f dB at a fixed level", switching_step, fixed_step);
+
+    rnnoise_registry_destroy(reg);
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("complexity: OK\n");
+    return 0;
+}
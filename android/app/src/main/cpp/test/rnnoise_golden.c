@@ -0,0 +1,463 @@
+/* Golden-output and performance regression checks for the denoise pipeline.
+
+   Usage:
+     rnnoise_golden --generate DIR       write the synthetic corpus listed in DIR/manifest.txt
+     rnnoise_golden --record DIR         write reference outputs and VAD traces
+     rnnoise_golden --check DIR          compare against the references
+     rnnoise_golden --perf BASELINE [--record-perf] [--max-regression PCT] DIR
+
+   The corpus is a set of short 48 kHz 16-bit mono clips of synthetic speech
+   mixed with different noises. Each clip NAME.pcm is run in every
+   configuration of configs[], and for each the references are
+   NAME<suffix>.ref.pcm (denoised output) and NAME<suffix>.vad.txt (one VAD
+   probability per frame). --check fails when a clip's output drops below MIN_SNR_DB against
+   its reference or a VAD value moves by more than MAX_VAD_DIFF; this leaves
+   room for compiler and FMA differences but not for behavioural changes.
+   --perf measures frames/s/core over the whole corpus and fails if it drops
+   more than PCT percent (default 10) below the machine-local baseline. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rnnoise.h"
+
+#define SAMPLE_RATE 48000
+#define MAX_CLIPS 32
+#define MIN_SNR_DB 30.
+#define MAX_VAD_DIFF .05
+#define PERF_SECONDS 2.
+/* The seeded models: NB_BANDS band energies and the pitch correlation in,
+   NB_BANDS gains and the VAD probability out. */
+#define MODEL_NEURONS 32
+#define MODEL_INPUTS 23
+#define MODEL_OUTPUTS 23
+
+/* Without a model only spectral subtraction runs. The seeded models cover
+   the RNN at full complexity, with the pitch filter, and block-sparse at a
+   complexity where every other frame interpolates the gains. */
+typedef struct {
+    const char *suffix;
+    /* Recurrent density of the model, or 0 for none. */
+    float density;
+    int complexity;
+} Config;
+
+static const Config configs[] = {
+    {"", 0, RNNOISE_MAX_COMPLEXITY},
+    {".rnn", 1, RNNOISE_MAX_COMPLEXITY},
+    {".rnn_sparse_c4", .5f, 4},
+};
+#define NB_CONFIGS (int)(sizeof(configs)/sizeof(configs[0]))
+
+typedef struct {
+    char name[64];
+    char noise[16];
+    float snr_db;
+    float seconds;
+} Clip;
+
+/* Builds DIR/NAME<config suffix><ext>, failing rather than truncating. */
+static int clip_path(char *path, size_t size, const char *dir, const char *name, const char *suffix,
+                     const char *ext) {
+    if (snprintf(path, size, "%s/%s%s%s", dir, name, suffix, ext) >= (int)size) {
+        fprintf(stderr, "%s/%s%s%s: path too long\n", dir, name, suffix, ext);
+        return -1;
+    }
+    return 0;
+}
+
+static int read_manifest(const char *dir, Clip *clips) {
+    char path[1024], line[256];
+    int n = 0;
+    FILE *f;
+    if (clip_path(path, sizeof(path), dir, "manifest", "", ".txt")) return -1;
+    f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (n < MAX_CLIPS && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "%63s %15s %f %f", clips[n].name, clips[n].noise, &clips[n].snr_db, &clips[n].seconds) == 4)
+            n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static short *read_pcm(const char *dir, const char *name, const char *suffix, const char *ext, long *len) {
+    char path[1024];
+    FILE *f;
+    short *pcm;
+    long size;
+    if (clip_path(path, sizeof(path), dir, name, suffix, ext)) return NULL;
+    f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    *len = size/sizeof(short);
+    pcm = malloc(size > 0 ? size : 1);
+    if (fread(pcm, sizeof(short), *len, f) != (size_t)*len) {
+        free(pcm);
+        pcm = NULL;
+    }
+    fclose(f);
+    return pcm;
+}
+
+static int write_pcm(const char *dir, const char *name, const char *suffix, const char *ext, const short *pcm,
+                     long len) {
+    char path[1024];
+    FILE *f;
+    int ok;
+    if (clip_path(path, sizeof(path), dir, name, suffix, ext)) return -1;
+    f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    ok = fwrite(pcm, sizeof(short), len, f) == (size_t)len;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+/* Deterministic generator, so the corpus can be rebuilt bit-exactly. */
+static unsigned rng_state;
+
+static float rng_uniform(void) {
+    rng_state = rng_state*1664525u + 1013904223u;
+    return (rng_state >> 8)*(1.f/16777216.f)*2.f - 1.f;
+}
+
+/* A crude talker: a glottal pulse train with a wandering pitch through
+   three formant resonators, gated by a syllable-rate envelope. */
+static void synth_speech(float *out, long len, float f0_base, unsigned seed) {
+    static const float formants[4][3] = {
+        {700, 1220, 2600}, {300, 2300, 3000}, {500, 900, 2500}, {400, 1900, 2550}
+    };
+    float mem[3][2] = {{0}};
+    float phase = 0;
+    long i;
+    int k;
+    rng_state = seed;
+    for (i=0;i<len;i++) {
+        int syllable = (int)(i/(SAMPLE_RATE/5));
+        const float *fm = formants[(syllable*7 + (int)(seed & 3)) & 3];
+        float t = (float)(i % (SAMPLE_RATE/5))/(SAMPLE_RATE/5);
+        float env = syllable % 4 == 3 ? 0 : sinf((float)M_PI*t);
+        float f0 = f0_base*(1.f + .15f*sinf(2*(float)M_PI*1.3f*i/SAMPLE_RATE));
+        float x, y = 0;
+        phase += f0/SAMPLE_RATE;
+        x = phase >= 1.f ? 1.f : 0.f;
+        if (phase >= 1.f) phase -= 1.f;
+        x += .02f*rng_uniform();
+        for (k=0;k<3;k++) {
+            float r = .985f, w = 2*(float)M_PI*fm[k]/SAMPLE_RATE;
+            float v = x + 2*r*cosf(w)*mem[k][0] - r*r*mem[k][1];
+            mem[k][1] = mem[k][0];
+            mem[k][0] = v;
+            y += v;
+        }
+        out[i] = env*y;
+    }
+}
+
+static void synth_noise(float *out, long len, const char *type, unsigned seed) {
+    long i;
+    rng_state = seed;
+    if (!strcmp(type, "hum")) {
+        float pink = 0;
+        for (i=0;i<len;i++) {
+            float t = (float)i/SAMPLE_RATE;
+            pink = .98f*pink + .02f*rng_uniform();
+            out[i] = sinf(2*(float)M_PI*50*t) + .5f*sinf(2*(float)M_PI*150*t) + .3f*sinf(2*(float)M_PI*250*t) + 8*pink;
+        }
+    } else if (!strcmp(type, "babble")) {
+        float *tmp = malloc(len*sizeof(float));
+        int k;
+        memset(out, 0, len*sizeof(float));
+        for (k=0;k<4;k++) {
+            synth_speech(tmp, len, 90.f + 35.f*k, seed + 17*k);
+            for (i=0;i<len;i++) out[i] += tmp[(i + k*9601) % len];
+        }
+        free(tmp);
+    } else {
+        for (i=0;i<len;i++) out[i] = rng_uniform();
+    }
+}
+
+static double energy(const float *x, long len) {
+    double e = 1e-9;
+    long i;
+    for (i=0;i<len;i++) e += (double)x[i]*x[i];
+    return e;
+}
+
+static int generate(const char *dir, const Clip *clips, int n) {
+    int c;
+    for (c=0;c<n;c++) {
+        long len = (long)(clips[c].seconds*SAMPLE_RATE), i;
+        float *speech = malloc(len*sizeof(float)), *noise = malloc(len*sizeof(float));
+        short *pcm = malloc(len*sizeof(short));
+        double speech_scale, noise_scale;
+        int rc;
+        synth_speech(speech, len, 110.f + 40.f*c, 1000u + c);
+        synth_noise(noise, len, clips[c].noise, 2000u + c);
+        /* Speech at about -20 dBFS RMS, noise at the requested SNR below it. */
+        speech_scale = 3277./sqrt(energy(speech, len)/len);
+        noise_scale = 3277.*pow(10., -clips[c].snr_db/20.)/sqrt(energy(noise, len)/len);
+        for (i=0;i<len;i++) {
+            double v = speech[i]*speech_scale + noise[i]*noise_scale;
+            pcm[i] = (short)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+        }
+        rc = write_pcm(dir, clips[c].name, "", ".pcm", pcm, len);
+        free(speech);
+        free(noise);
+        free(pcm);
+        if (rc) return 1;
+    }
+    return 0;
+}
+
+/* Small seeded random weights, so the network neither saturates nor sits
+   at a constant output. */
+static RNNoiseModel *make_model(float density) {
+    float input_weights[MODEL_INPUTS*MODEL_NEURONS], recurrent_weights[MODEL_NEURONS*MODEL_NEURONS];
+    float output_weights[MODEL_NEURONS*MODEL_OUTPUTS];
+    float input_bias[MODEL_NEURONS], neuron_bias[MODEL_NEURONS], output_bias[MODEL_OUTPUTS];
+    int i;
+    rng_state = 3000u;
+    for (i=0;i<MODEL_INPUTS*MODEL_NEURONS;i++) input_weights[i] = .1f*rng_uniform();
+    for (i=0;i<MODEL_NEURONS*MODEL_NEURONS;i++) recurrent_weights[i] = .3f*rng_uniform();
+    for (i=0;i<MODEL_NEURONS*MODEL_OUTPUTS;i++) output_weights[i] = .5f*rng_uniform();
+    for (i=0;i<MODEL_NEURONS;i++) {
+        int j;
+        /* Centred on a band log-energy of 5, so the tanh units do not sit in
+           saturation. */
+        input_bias[i] = .2f*rng_uniform();
+        for (j=0;j<MODEL_INPUTS-1;j++) input_bias[i] -= 5*input_weights[i*MODEL_INPUTS + j];
+        neuron_bias[i] = .2f*rng_uniform();
+    }
+    for (i=0;i<MODEL_OUTPUTS;i++) output_bias[i] = .5f*rng_uniform();
+    return rnnoise_model_create(MODEL_NEURONS, MODEL_OUTPUTS, input_weights, recurrent_weights, output_weights,
+                                input_bias, neuron_bias, output_bias, density);
+}
+
+/* Runs a clip through a fresh state set up as config says; the last
+   partial frame is dropped. Returns the number of frames, or -1. */
+static long denoise(const short *in, long len, short *out, float *vad, const Config *config) {
+    int frame_size = rnnoise_get_frame_size();
+    long frames = len/frame_size;
+    DenoiseState *st = rnnoise_create(NULL);
+    RNNoiseModelRegistry *reg = NULL;
+    if (config->density > 0) {
+        RNNoiseModel *model = make_model(config->density);
+        reg = rnnoise_registry_create();
+        if (!model || !reg || rnnoise_model_attach(st, reg, RNNOISE_SWITCH_RESET)) {
+            fprintf(stderr, "cannot set up the%s model\n", config->suffix);
+            rnnoise_model_release(model);
+            frames = -1;
+        } else {
+            rnnoise_registry_publish(reg, model);
+            rnnoise_model_release(model);
+        }
+    }
+    if (frames >= 0) {
+        rnnoise_set_complexity(st, config->complexity);
+        rnnoise_process_frames(st, out, in, (int)frames, vad);
+    }
+    rnnoise_destroy(st);
+    rnnoise_registry_destroy(reg);
+    return frames;
+}
+
+static int record(const char *dir, const Clip *clips, int n) {
+    int c, k, i;
+    for (c=0;c<n;c++) {
+        long len, frames;
+        short *in = read_pcm(dir, clips[c].name, "", ".pcm", &len), *out;
+        float *vad;
+        if (!in) return 1;
+        out = malloc(len*sizeof(short));
+        vad = malloc((len/rnnoise_get_frame_size() + 1)*sizeof(float));
+        for (k=0;k<NB_CONFIGS;k++) {
+            char path[1024];
+            FILE *f;
+            frames = denoise(in, len, out, vad, &configs[k]);
+            if (frames < 0) return 1;
+            if (write_pcm(dir, clips[c].name, configs[k].suffix, ".ref.pcm", out, frames*rnnoise_get_frame_size()))
+                return 1;
+            if (clip_path(path, sizeof(path), dir, clips[c].name, configs[k].suffix, ".vad.txt")) return 1;
+            f = fopen(path, "w");
+            if (!f) {
+                perror(path);
+                return 1;
+            }
+            for (i=0;i<frames;i++) fprintf(f, "%.6f\n", vad[i]);
+            fclose(f);
+        }
+        free(in);
+        free(out);
+        free(vad);
+    }
+    return 0;
+}
+
+/* Compares one configuration of a clip against its references. Returns 0
+   if it matches, 1 if it drifted and -1 if the references are unusable. */
+static int check_config(const char *dir, const Clip *clip, const Config *config, const short *in, long len,
+                        short *out, float *vad) {
+    long ref_len, frames, i;
+    short *ref = read_pcm(dir, clip->name, config->suffix, ".ref.pcm", &ref_len);
+    double sig = 1e-9, err = 1e-9, snr, max_vad_diff = 0;
+    int max_sample_diff = 0, fail;
+    char path[1024];
+    FILE *f;
+    if (!ref) return -1;
+    frames = denoise(in, len, out, vad, config);
+    if (frames < 0 || ref_len != frames*rnnoise_get_frame_size()) {
+        fprintf(stderr, "%s%s: reference has %ld samples, expected %ld\n", clip->name, config->suffix, ref_len,
+                frames*rnnoise_get_frame_size());
+        free(ref);
+        return -1;
+    }
+    for (i=0;i<ref_len;i++) {
+        int d = out[i] - ref[i];
+        sig += (double)ref[i]*ref[i];
+        err += (double)d*d;
+        if (abs(d) > max_sample_diff) max_sample_diff = abs(d);
+    }
+    free(ref);
+    snr = 10*log10(sig/err);
+    if (clip_path(path, sizeof(path), dir, clip->name, config->suffix, ".vad.txt")) return -1;
+    f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    for (i=0;i<frames;i++) {
+        float expected;
+        if (fscanf(f, "%f", &expected) != 1) {
+            fprintf(stderr, "%s: VAD trace is too short\n", path);
+            fclose(f);
+            return -1;
+        }
+        max_vad_diff = fmax(max_vad_diff, fabs(vad[i] - expected));
+    }
+    fclose(f);
+    fail = snr < MIN_SNR_DB || max_vad_diff > MAX_VAD_DIFF;
+    printf("%s%-*s %s  SNR vs reference %6.1f dB  max sample diff %5d  max VAD diff %.4f\n", clip->name,
+           (int)(40 - strlen(clip->name)), config->suffix, fail ? "FAIL" : "ok  ", snr, max_sample_diff,
+           max_vad_diff);
+    return fail;
+}
+
+static int check(const char *dir, const Clip *clips, int n) {
+    int c, k, failures = 0;
+    for (c=0;c<n;c++) {
+        long len;
+        short *in = read_pcm(dir, clips[c].name, "", ".pcm", &len), *out;
+        float *vad;
+        if (!in) return 1;
+        out = malloc(len*sizeof(short));
+        vad = malloc((len/rnnoise_get_frame_size() + 1)*sizeof(float));
+        for (k=0;k<NB_CONFIGS;k++) {
+            int rc = check_config(dir, &clips[c], &configs[k], in, len, out, vad);
+            if (rc < 0) return 1;
+            failures += rc;
+        }
+        free(in);
+        free(out);
+        free(vad);
+    }
+    return failures ? 1 : 0;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int perf(const char *dir, const Clip *clips, int n, const char *baseline, int record_perf,
+                double max_regression) {
+    short *in[MAX_CLIPS], *out;
+    long len[MAX_CLIPS], max_len = 0, frames = 0;
+    double start, elapsed, fps, base_fps;
+    int c;
+    FILE *f;
+    for (c=0;c<n;c++) {
+        in[c] = read_pcm(dir, clips[c].name, "", ".pcm", &len[c]);
+        if (!in[c]) return 1;
+        if (len[c] > max_len) max_len = len[c];
+    }
+    out = malloc(max_len*sizeof(short));
+    start = now_s();
+    do {
+        for (c=0;c<n;c++) frames += denoise(in[c], len[c], out, NULL, &configs[0]);
+        elapsed = now_s() - start;
+    } while (elapsed < PERF_SECONDS);
+    fps = frames/elapsed;
+    for (c=0;c<n;c++) free(in[c]);
+    free(out);
+
+    if (record_perf) {
+        f = fopen(baseline, "w");
+        if (!f) {
+            perror(baseline);
+            return 1;
+        }
+        fprintf(f, "{\"frames_per_sec_core\": %.1f}\n", fps);
+        fclose(f);
+        printf("recorded baseline %.1f frames/s/core\n", fps);
+        return 0;
+    }
+    f = fopen(baseline, "r");
+    if (!f || fscanf(f, " {\"frames_per_sec_core\": %lf}", &base_fps) != 1) {
+        fprintf(stderr, "%s: no baseline, record one with --record-perf\n", baseline);
+        if (f) fclose(f);
+        return 1;
+    }
+    fclose(f);
+    printf("%.1f frames/s/core, baseline %.1f (%+.1f%%, limit -%.1f%%)\n", fps, base_fps,
+           100*(fps/base_fps - 1), max_regression);
+    return fps < base_fps*(1 - max_regression/100) ? 1 : 0;
+}
+
+static int usage(const char *argv0) {
+    fprintf(stderr, "usage: %s (--generate | --record | --check) DIR\n"
+            "       %s --perf BASELINE [--record-perf] [--max-regression PCT] DIR\n", argv0, argv0);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    Clip clips[MAX_CLIPS];
+    const char *cmd = NULL, *dir = NULL, *baseline = NULL;
+    double max_regression = 10;
+    int record_perf = 0, n, i;
+
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i], "--perf") && i+1 < argc) {
+            cmd = argv[i];
+            baseline = argv[++i];
+        } else if (!strcmp(argv[i], "--record-perf")) record_perf = 1;
+        else if (!strcmp(argv[i], "--max-regression") && i+1 < argc) max_regression = atof(argv[++i]);
+        else if (argv[i][0] == '-' && argv[i][1] == '-') cmd = argv[i];
+        else dir = argv[i];
+    }
+    if (!cmd || !dir) return usage(argv[0]);
+    n = read_manifest(dir, clips);
+    if (n <= 0) return 1;
+
+    if (!strcmp(cmd, "--generate")) return generate(dir, clips, n);
+    if (!strcmp(cmd, "--record")) return record(dir, clips, n);
+    if (!strcmp(cmd, "--check")) return check(dir, clips, n);
+    if (!strcmp(cmd, "--perf")) return perf(dir, clips, n, baseline, record_perf, max_regression);
+    return usage(argv[0]);
+}
@@ -0,0 +1,249 @@
+/* Deterministic put/get scenarios for the jitter buffer.
+
+   Usage:
+     rnnoise_jitter_test
+
+   Drives rnnoise_jitter_put_at()/rnnoise_jitter_get_at() from a simulated
+   clock: steady arrival (played back bit-exactly, past the ring's wrap),
+   bursts, a slow producer, a gap, a flush and an overflowing put, and
+   checks how each frame was produced. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jitter.h"
+
+#define SAMPLE_RATE 16000
+#define FRAME (SAMPLE_RATE/50)
+#define FRAME_NS 20000000LL
+#define MIN_DELAY_MS 40
+#define MAX_DELAY_MS 300
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+/* A voiced-sounding signal with a 5 ms period, so WSOLA finds its lag. */
+static short sample(long long n) {
+    double t = (double)n/SAMPLE_RATE;
+    return (short)(6000*sin(2*M_PI*200*t) + 3000*sin(2*M_PI*400*t + 1) + 1000*sin(2*M_PI*600*t + 2));
+}
+
+typedef struct {
+    RNNoiseJitterBuffer *jb;
+    /* Simulated clock, in ns. */
+    long long now;
+    /* Next input sample to send. */
+    long long sent;
+    long long frames[RNNOISE_JITTER_NB_STATUS];
+    short out[FRAME];
+} Sim;
+
+static void sim_init(Sim *s) {
+    memset(s, 0, sizeof(*s));
+    s->jb = rnnoise_jitter_create(SAMPLE_RATE, MIN_DELAY_MS, MAX_DELAY_MS);
+    /* Away from 0, which the buffer reads as "nothing arrived yet". */
+    s->now = 1000000000LL;
+}
+
+static void sim_put(Sim *s, int n) {
+    short pcm[5*FRAME];
+    int i;
+    for (i=0;i<n;i++) pcm[i] = sample(s->sent + i);
+    CHECK(rnnoise_jitter_put_at(s->jb, pcm, n, s->now) == n, "put of %d samples truncated", n);
+    s->sent += n;
+}
+
+static int sim_get(Sim *s) {
+    int status = rnnoise_jitter_get_at(s->jb, s->out, s->now);
+    s->frames[status]++;
+    return status;
+}
+
+/* One put of a frame and one get every 20 ms; audio comes out bit-exactly
+   after the start-up delay, including across the ring's wrap. */
+static void test_steady(void) {
+    Sim s;
+    long long played = 0;
+    int k, i, mismatches = 0;
+    sim_init(&s);
+    /* 12 s at 16 kHz is well past a 2^17-sample ring. */
+    for (k=0;k<600;k++) {
+        int status;
+        sim_put(&s, FRAME);
+        status = sim_get(&s);
+        if (status == RNNOISE_JITTER_NORMAL) {
+            for (i=0;i<FRAME;i++) mismatches += s.out[i] != sample(played + i);
+            played += FRAME;
+        }
+        s.now += FRAME_NS;
+    }
+    CHECK(mismatches == 0, "steady: %d samples differ", mismatches);
+    CHECK(s.frames[RNNOISE_JITTER_NORMAL] >= 598, "steady: only %lld normal frames",
+          s.frames[RNNOISE_JITTER_NORMAL]);
+    CHECK(s.frames[RNNOISE_JITTER_ACCELERATE] + s.frames[RNNOISE_JITTER_STRETCH]
+          + s.frames[RNNOISE_JITTER_CONCEAL] == 0, "steady: audio was time-scaled or concealed");
+    rnnoise_jitter_destroy(s.jb);
+}
+
+static unsigned rng = 1;
+
+static int next_rand(void) {
+    rng = rng*1103515245 + 12345;
+    return (int)((rng >> 16) & 0x7fff);
+}
+
+/* Each frame is sent every 20 ms and, for the first 10 s, delayed by up
+   to 80 ms on the way, arriving in order, so frames bunch up behind a late
+   one. The target grows to cover the jitter and nothing is concealed.
+   Once frames arrive on time again, the target decays and the excess
+   delay is played out faster. The first frame is on time, as the buffer
+   measures how far audio runs ahead from the start of the talk spurt. */
+#define JITTERY 500
+#define ON_TIME 300
+
+static void test_bursts(void) {
+    Sim s;
+    RNNoiseJitterStats stats;
+    long long before[RNNOISE_JITTER_NB_STATUS] = {0}, arrival[JITTERY+ON_TIME], last = 0;
+    int k, next = 0;
+    sim_init(&s);
+    for (k=0;k<JITTERY+ON_TIME;k++) {
+        arrival[k] = s.now + k*FRAME_NS + (k > 0 && k < JITTERY ? (long long)(next_rand() % 81)*1000000LL : 0);
+        if (arrival[k] < last) arrival[k] = last;
+        last = arrival[k];
+    }
+    for (k=0;k<JITTERY+ON_TIME;k++) {
+        while (next < JITTERY+ON_TIME && arrival[next] <= s.now) {
+            sim_put(&s, FRAME);
+            next++;
+        }
+        sim_get(&s);
+        s.now += FRAME_NS;
+        /* Count from when the target has settled. */
+        if (k == 99) memcpy(before, s.frames, sizeof(before));
+        if (k == JITTERY-1) {
+            rnnoise_jitter_get_stats(s.jb, &stats);
+            CHECK(stats.target_ms >= 80, "bursts: target %d ms does not cover the jitter", stats.target_ms);
+            CHECK(s.frames[RNNOISE_JITTER_CONCEAL] + s.frames[RNNOISE_JITTER_SILENCE]
+                  == before[RNNOISE_JITTER_CONCEAL] + before[RNNOISE_JITTER_SILENCE], "bursts: ran dry");
+            memcpy(before, s.frames, sizeof(before));
+        }
+    }
+    rnnoise_jitter_get_stats(s.jb, &stats);
+    CHECK(s.frames[RNNOISE_JITTER_ACCELERATE] > before[RNNOISE_JITTER_ACCELERATE],
+          "on time after bursts: excess delay not played out");
+    CHECK(stats.target_ms == MIN_DELAY_MS, "on time after bursts: target %d ms", stats.target_ms);
+    CHECK(stats.level_ms <= MIN_DELAY_MS + 20, "on time after bursts: level %d ms", stats.level_ms);
+    CHECK(s.frames[RNNOISE_JITTER_CONCEAL] + s.frames[RNNOISE_JITTER_SILENCE]
+          == before[RNNOISE_JITTER_CONCEAL] + before[RNNOISE_JITTER_SILENCE], "on time after bursts: ran dry");
+    rnnoise_jitter_destroy(s.jb);
+}
+
+/* A producer running 10% slow: the buffer stretches rather than running
+   dry every few frames. */
+static void test_slow_producer(void) {
+    Sim s;
+    long long t_put;
+    int k;
+    sim_init(&s);
+    t_put = s.now;
+    for (k=0;k<100;k++) {
+        while (t_put <= s.now) {
+            sim_put(&s, FRAME);
+            t_put += FRAME_NS*11/10;
+        }
+        sim_get(&s);
+        s.now += FRAME_NS;
+    }
+    CHECK(s.frames[RNNOISE_JITTER_STRETCH] > 0, "slow producer: never stretched");
+    CHECK(s.frames[RNNOISE_JITTER_SILENCE] <= 3, "slow producer: %lld silent frames",
+          s.frames[RNNOISE_JITTER_SILENCE]);
+    rnnoise_jitter_destroy(s.jb);
+}
+
+/* 100 ms without audio mid-stream: concealment covers at most 60 ms, then
+   silence until the next talk spurt fills the buffer again. */
+static void test_gap(void) {
+    Sim s;
+    int k, concealed_run = 0, longest_run = 0;
+    sim_init(&s);
+    for (k=0;k<100;k++) {
+        int status;
+        if (k < 50 || k >= 55) sim_put(&s, FRAME);
+        else s.sent += FRAME;
+        status = sim_get(&s);
+        concealed_run = status == RNNOISE_JITTER_CONCEAL ? concealed_run + 1 : 0;
+        if (concealed_run > longest_run) longest_run = concealed_run;
+        s.now += FRAME_NS;
+    }
+    CHECK(s.frames[RNNOISE_JITTER_CONCEAL] > 0, "gap: not concealed");
+    CHECK(longest_run <= 3, "gap: %d frames concealed in a row", longest_run);
+    CHECK(s.frames[RNNOISE_JITTER_NORMAL] > 80, "gap: playback did not resume");
+    rnnoise_jitter_destroy(s.jb);
+}
+
+static void test_flush(void) {
+    Sim s;
+    RNNoiseJitterStats stats;
+    int k;
+    sim_init(&s);
+    for (k=0;k<10;k++) {
+        sim_put(&s, FRAME);
+        sim_get(&s);
+        s.now += FRAME_NS;
+    }
+    sim_put(&s, 5*FRAME);
+    rnnoise_jitter_flush(s.jb);
+    CHECK(sim_get(&s) == RNNOISE_JITTER_SILENCE, "flush: audio played after a flush");
+    for (k=0;k<FRAME;k++) CHECK(s.out[k] == 0, "flush: frame not silent");
+    rnnoise_jitter_get_stats(s.jb, &stats);
+    CHECK(stats.level_ms == 0, "flush: %d ms left", stats.level_ms);
+    /* The next talk spurt starts from the beginning again. */
+    s.now += FRAME_NS;
+    sim_put(&s, 5*FRAME);
+    CHECK(sim_get(&s) == RNNOISE_JITTER_NORMAL, "flush: no playback after new audio");
+    rnnoise_jitter_destroy(s.jb);
+}
+
+/* An oversized put keeps what fits and counts the rest. */
+static void test_overflow(void) {
+    RNNoiseJitterBuffer *jb = rnnoise_jitter_create(SAMPLE_RATE, MIN_DELAY_MS, MAX_DELAY_MS);
+    RNNoiseJitterStats stats;
+    int len = 10*SAMPLE_RATE, accepted;
+    short *pcm = calloc(len, sizeof(short));
+    accepted = rnnoise_jitter_put_at(jb, pcm, len, 1000000000LL);
+    CHECK(accepted >= 4*SAMPLE_RATE + MAX_DELAY_MS*SAMPLE_RATE/1000 && accepted < len,
+          "overflow: accepted %d samples", accepted);
+    CHECK(rnnoise_jitter_put_at(jb, pcm, 100, 1000000000LL) == 0, "overflow: put into a full ring");
+    rnnoise_jitter_get_stats(jb, &stats);
+    CHECK(stats.overflow_samples == len - accepted + 100, "overflow: %lld samples counted, expected %d",
+          stats.overflow_samples, len - accepted + 100);
+    CHECK(stats.level_ms == accepted*1000LL/SAMPLE_RATE, "overflow: level %d ms", stats.level_ms);
+    free(pcm);
+    rnnoise_jitter_destroy(jb);
+}
+
+int main(void) {
+    CHECK(rnnoise_jitter_create(SAMPLE_RATE, 0, 20000) == NULL, "create: 20 s delay accepted");
+    test_steady();
+    test_bursts();
+    test_slow_producer();
+    test_gap();
+    test_flush();
+    test_overflow();
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("jitter: OK\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+/* Equivalence checks for the RNN kernels of the build.
+
+   Usage:
+     rnnoise_kernels_test
+
+   Runs a seeded network for a few dozen steps three ways: through the
+   dense GEMV kernel, through the block-sparse kernel with every block
+   kept, and through a double-precision reference on the float weights.
+   Dense and sparse must agree to rounding (exactly in fixed point), and
+   both must stay within the tolerance of the weight format of the build
+   of the reference, which is what catches a broken FP16 or NEON kernel.
+   Run it on the target before enabling RNNOISE_NEON_KERNELS there. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rnn.h"
+
+/* Odd input and output counts, so the kernels' tail loops run too. */
+#define NB_INPUTS 23
+#define NB_NEURONS 48
+#define NB_OUTPUTS 23
+#define STEPS 64
+
+#ifdef FIXED_POINT
+#define TO_INPUT(x) ((opus_val16)floor(.5 + (x)*(1<<ACTIVATION_SHIFT)))
+#define NEURON(x) ((x)*(1./(1<<ACTIVATION_SHIFT)))
+#define OUTPUT(x) ((x)*(1./32768))
+/* Q12 weights and the tanh table. */
+#define TOLERANCE 2e-2
+#define SPARSE_TOLERANCE 0
+#elif defined(RNNOISE_FP16_WEIGHTS)
+#define TO_INPUT(x) ((opus_val16)(x))
+#define NEURON(x) (x)
+#define OUTPUT(x) (x)
+/* Half-precision weights, and half-precision sums on cores that have them. */
+#define TOLERANCE 1e-2
+#define SPARSE_TOLERANCE 5e-3
+#else
+#define TO_INPUT(x) ((opus_val16)(x))
+#define NEURON(x) (x)
+#define OUTPUT(x) (x)
+#define TOLERANCE 1e-4
+#define SPARSE_TOLERANCE 1e-5
+#endif
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned rng_state = 1;
+
+static float rng_uniform(void) {
+    rng_state = rng_state*1664525u + 1013904223u;
+    return (rng_state >> 8)*(1.f/16777216.f)*2.f - 1.f;
+}
+
+typedef struct {
+    float input_weights[NB_NEURONS*NB_INPUTS];
+    float recurrent_weights[NB_NEURONS*NB_NEURONS];
+    float output_weights[NB_OUTPUTS*NB_NEURONS];
+    float input_bias[NB_NEURONS];
+    float neuron_bias[NB_NEURONS];
+    float output_bias[NB_OUTPUTS];
+} Weights;
+
+static void reference_step(const Weights *m, double *neurons, const float *in, double *out) {
+    double dense[NB_NEURONS], next[NB_NEURONS];
+    int i, j;
+    for (i=0;i<NB_NEURONS;i++) {
+        double sum = m->input_bias[i];
+        for (j=0;j<NB_INPUTS;j++) sum += (double)m->input_weights[i*NB_INPUTS + j]*in[j];
+        dense[i] = tanh(sum);
+    }
+    for (i=0;i<NB_NEURONS;i++) {
+        double sum = m->neuron_bias[i];
+        for (j=0;j<NB_NEURONS;j++) sum += m->recurrent_weights[i*NB_NEURONS + j]*neurons[j];
+        next[i] = dense[i] + tanh(sum);
+    }
+    for (i=0;i<NB_NEURONS;i++) neurons[i] = next[i];
+    for (i=0;i<NB_OUTPUTS;i++) {
+        double sum = m->output_bias[i];
+        for (j=0;j<NB_NEURONS;j++) sum += m->output_weights[i*NB_NEURONS + j]*neurons[j];
+        out[i] = 1./(1. + exp(-sum));
+    }
+}
+
+static double max_diff(const opus_val16 *x, const opus_val16 *y, int n, int neurons) {
+    double d = 0;
+    int i;
+    for (i=0;i<n;i++) d = fmax(d, neurons ? fabs(NEURON(x[i]) - NEURON(y[i])) : fabs(OUTPUT(x[i]) - OUTPUT(y[i])));
+    return d;
+}
+
+static double max_ref_diff(const opus_val16 *x, const double *ref, int n, int neurons) {
+    double d = 0;
+    int i;
+    for (i=0;i<n;i++) d = fmax(d, fabs((neurons ? NEURON(x[i]) : OUTPUT(x[i])) - ref[i]));
+    return d;
+}
+
+static void test_kernels(void) {
+    Weights *m = malloc(sizeof(*m));
+    RNNState dense, sparse;
+    opus_val16 dense_neurons[NB_NEURONS] = {0}, sparse_neurons[NB_NEURONS] = {0};
+    opus_val16 dense_out[NB_OUTPUTS], sparse_out[NB_OUTPUTS], in[NB_INPUTS];
+    double ref_neurons[NB_NEURONS] = {0}, ref_out[NB_OUTPUTS];
+    double worst_sparse = 0, worst_ref = 0;
+    int i, step;
+    /* Recurrent weights small enough that the reference and the kernels do
+       not drift apart over the steps. */
+    for (i=0;i<NB_NEURONS*NB_INPUTS;i++) m->input_weights[i] = .3f*rng_uniform();
+    for (i=0;i<NB_NEURONS*NB_NEURONS;i++) m->recurrent_weights[i] = .15f*rng_uniform();
+    for (i=0;i<NB_OUTPUTS*NB_NEURONS;i++) m->output_weights[i] = .3f*rng_uniform();
+    for (i=0;i<NB_NEURONS;i++) m->input_bias[i] = .2f*rng_uniform();
+    for (i=0;i<NB_NEURONS;i++) m->neuron_bias[i] = .2f*rng_uniform();
+    for (i=0;i<NB_OUTPUTS;i++) m->output_bias[i] = .2f*rng_uniform();
+    CHECK(rnn_init(&dense, NB_INPUTS, NB_NEURONS, NB_OUTPUTS, m->input_weights, m->recurrent_weights,
+                   m->output_weights, m->input_bias, m->neuron_bias, m->output_bias) == 0, "rnn_init");
+    /* Just under 1 keeps every block but still takes the sparse layout. */
+    CHECK(rnn_init_sparse(&sparse, NB_INPUTS, NB_NEURONS, NB_OUTPUTS, m->input_weights, m->recurrent_weights,
+                          m->output_weights, m->input_bias, m->neuron_bias, m->output_bias, .999f) == 0,
+          "rnn_init_sparse");
+    CHECK(dense.recurrent_idx == NULL && sparse.recurrent_idx != NULL, "unexpected weight layouts");
+    if (failures) {
+        free(m);
+        return;
+    }
+    for (step=0;step<STEPS;step++) {
+        float x[NB_INPUTS];
+        double d;
+        /* Inputs in the range of the features: band log-energies and the
+           pitch correlation. */
+        for (i=0;i<NB_INPUTS;i++) {
+            x[i] = i < NB_INPUTS-1 ? 2.f + 2.f*rng_uniform() : .5f + .5f*rng_uniform();
+            in[i] = TO_INPUT(x[i]);
+            /* The reference sees what the kernels see. */
+            x[i] = (float)NEURON(in[i]);
+        }
+        compute_rnn(&dense, dense_neurons, in, dense_out);
+        compute_rnn(&sparse, sparse_neurons, in, sparse_out);
+        reference_step(m, ref_neurons, x, ref_out);
+
+        d = fmax(max_diff(dense_neurons, sparse_neurons, NB_NEURONS, 1),
+                 max_diff(dense_out, sparse_out, NB_OUTPUTS, 0));
+        CHECK(d <= SPARSE_TOLERANCE, "step %d: dense and sparse differ by %g", step, d);
+        worst_sparse = fmax(worst_sparse, d);
+        d = fmax(max_ref_diff(dense_neurons, ref_neurons, NB_NEURONS, 1),
+                 max_ref_diff(dense_out, ref_out, NB_OUTPUTS, 0));
+        CHECK(d <= TOLERANCE, "step %d: dense differs from the reference by %g", step, d);
+        worst_ref = fmax(worst_ref, d);
+        d = fmax(max_ref_diff(sparse_neurons, ref_neurons, NB_NEURONS, 1),
+                 max_ref_diff(sparse_out, ref_out, NB_OUTPUTS, 0));
+        CHECK(d <= TOLERANCE, "step %d: sparse differs from the reference by %g", step, d);
+        worst_ref = fmax(worst_ref, d);
+        if (failures) break;
+    }
+    printf("dense vs sparse %.3g (limit %.3g), vs reference %.3g (limit %.3g)\n", worst_sparse,
+           (double)SPARSE_TOLERANCE, worst_ref, (double)TOLERANCE);
+    rnn_free(&dense);
+    rnn_free(&sparse);
+    free(m);
+}
+
+int main(void) {
+    test_kernels();
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("kernels: OK\n");
+    return 0;
+}
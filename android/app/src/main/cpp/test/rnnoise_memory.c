@@ -0,0 +1,128 @@
+/* Checks the per-stream memory reported by rnnoise_get_memory().
+
+   Usage:
+     rnnoise_memory_test
+
+   A new stream is only its state: cache-line aligned, a whole number of
+   cache lines, and at most MAX_STATE_BYTES when built without stats and
+   tracing. Attaching a model, enabling features and enabling the echo
+   canceller must each add to the count, by an amount that grows with the
+   neurons, stacked frames and partitions asked for, and turning them off
+   must give the bytes back (the fixed-point build has no canceller and
+   skips it). With a MODEL_NEURONS model and NB_MELS mel bands stacked up
+   to MAX_FEATURE_STACK frames, a stream stays within MAX_STREAM_BYTES. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rnnoise.h"
+
+#define FRAME 480
+#define CACHE_LINE 64
+/* Seven cache lines. */
+#define MAX_STATE_BYTES 448
+#define MODEL_NEURONS 96
+#define MODEL_OUTPUTS 22
+#define NB_MELS 40
+#define MAX_FEATURE_STACK 4
+/* 2.2 kB. */
+#define MAX_STREAM_BYTES 2252
+#define NB_STREAMS 8
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+/* Zero weights: only the sizes matter here. */
+static RNNoiseModel *make_model(int nb_neurons) {
+    static float weights[MODEL_NEURONS*MODEL_NEURONS];
+    return rnnoise_model_create(nb_neurons, MODEL_OUTPUTS, weights, weights, weights, weights, weights, weights,
+                                1);
+}
+
+static void test_state(void) {
+    DenoiseState *st[NB_STREAMS];
+    int j, base;
+    for (j=0;j<NB_STREAMS;j++) {
+        st[j] = rnnoise_create(NULL);
+        CHECK((uintptr_t)st[j] % CACHE_LINE == 0, "state %d at %p is not cache-line aligned", j, (void*)st[j]);
+    }
+    base = rnnoise_get_memory(st[0]);
+    CHECK(base > 0 && base % CACHE_LINE == 0, "new stream reports %d bytes", base);
+#if !defined(RNNOISE_STATS) && !defined(RNNOISE_TRACE)
+    CHECK(base <= MAX_STATE_BYTES, "new stream reports %d bytes, more than %d", base, MAX_STATE_BYTES);
+#endif
+    for (j=0;j<NB_STREAMS;j++) rnnoise_destroy(st[j]);
+}
+
+static void test_growth(void) {
+    DenoiseState *st = rnnoise_create(NULL);
+    RNNoiseModelRegistry *reg = rnnoise_registry_create();
+    RNNoiseModel *small = make_model(MODEL_NEURONS/2), *large = make_model(MODEL_NEURONS);
+    short pcm[FRAME] = {0};
+    int base = rnnoise_get_memory(st), with_small, with_model, prev, s;
+
+    rnnoise_registry_publish(reg, small);
+    rnnoise_model_attach(st, reg, RNNOISE_SWITCH_RESET);
+    with_small = rnnoise_get_memory(st);
+    rnnoise_registry_publish(reg, large);
+    /* Picked up at the next frame. */
+    rnnoise_process_frame(st, pcm, pcm);
+    with_model = rnnoise_get_memory(st);
+    CHECK(with_small > base, "a %d-neuron model adds nothing (%d bytes)", MODEL_NEURONS/2, with_small);
+    CHECK(with_model > with_small, "%d neurons take %d bytes, %d neurons %d", MODEL_NEURONS, with_model,
+          MODEL_NEURONS/2, with_small);
+
+    prev = with_model;
+    for (s=1;s<=MAX_FEATURE_STACK;s++) {
+        int bytes;
+        CHECK(rnnoise_features_enable(st, NB_MELS, 0, s) == 0, "cannot enable features");
+        bytes = rnnoise_get_memory(st);
+        CHECK(bytes > prev, "%d stacked frames take %d bytes, %d frames %d", s, bytes, s - 1, prev);
+#if !defined(RNNOISE_STATS) && !defined(RNNOISE_TRACE)
+        CHECK(bytes <= MAX_STREAM_BYTES, "%d neurons and %d mels stacked %d times take %d bytes",
+              MODEL_NEURONS, NB_MELS, s, bytes);
+#endif
+        prev = bytes;
+    }
+    rnnoise_features_enable(st, 0, 0, 1);
+    CHECK(rnnoise_get_memory(st) == with_model, "disabling features leaves %d bytes, %d before",
+          rnnoise_get_memory(st), with_model);
+
+    if (rnnoise_aec_enable(st, 8) == 0) {
+        int eight = rnnoise_get_memory(st), twenty;
+        CHECK(eight > with_model, "echo cancellation adds nothing (%d bytes)", eight);
+        CHECK(rnnoise_aec_enable(st, 20) == 0, "cannot enable echo cancellation");
+        twenty = rnnoise_get_memory(st);
+        CHECK(twenty > eight, "20 partitions take %d bytes, 8 partitions %d", twenty, eight);
+        rnnoise_aec_enable(st, 0);
+        CHECK(rnnoise_get_memory(st) == with_model, "disabling echo cancellation leaves %d bytes, %d before",
+              rnnoise_get_memory(st), with_model);
+    }
+
+    rnnoise_model_attach(st, NULL, RNNOISE_SWITCH_RESET);
+    CHECK(rnnoise_get_memory(st) == base, "detaching the model leaves %d bytes, %d before",
+          rnnoise_get_memory(st), base);
+    rnnoise_model_release(small);
+    rnnoise_model_release(large);
+    rnnoise_registry_destroy(reg);
+    rnnoise_destroy(st);
+}
+
+int main(void) {
+    test_state();
+    test_growth();
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("memory: OK\n");
+    return 0;
+}
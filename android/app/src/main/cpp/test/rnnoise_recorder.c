@@ -0,0 +1,272 @@
+/* Round-trip and corrupt-file checks for the call recorder.
+
+   Usage:
+     rnnoise_recorder_test [TMPDIR]
+
+   Records a synthetic clip that exercises Rice-coded, escaped and raw
+   blocks, reads it back whole and from random positions, and then damages
+   copies of the files on disk: every corruption must make
+   rnnoise_recording_open() fail or rnnoise_recording_read() return -1 or a
+   short count, never read outside its buffers. Run it under
+   -fsanitize=address to catch the latter. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "recorder.h"
+
+#define SAMPLE_RATE 16000
+#define SECONDS 3
+#define LENGTH (SECONDS*SAMPLE_RATE)
+/* The on-disk layout, as written by recorder.c. */
+#define INDEX_HEADER_BYTES 16
+#define INDEX_ENTRY_BYTES 16
+#define INDEX_SEGMENT_OFFSET 8
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned rng = 1;
+
+static int next_rand(void) {
+    rng = rng*1103515245 + 12345;
+    return (int)((rng >> 16) & 0x7fff);
+}
+
+/* Speech-like tone, then silence, then full-scale noise that does not
+   compress and is stored raw. */
+static void make_clip(short *pcm) {
+    int i;
+    for (i=0;i<LENGTH;i++) {
+        if (i < LENGTH/3)
+            pcm[i] = (short)(8000*sin(2*M_PI*220*i/SAMPLE_RATE) + (next_rand() % 200) - 100);
+        else if (i < 2*LENGTH/3)
+            pcm[i] = (short)((next_rand() % 5) - 2);
+        else
+            pcm[i] = (short)(next_rand()*2 - 32768);
+    }
+    /* Largest possible steps, which need the escape code. */
+    pcm[100] = 32767;
+    pcm[101] = -32768;
+    pcm[102] = 32767;
+}
+
+static int record(const char *dir, const short *pcm) {
+    int i;
+    RNNoiseRecorder *rec = rnnoise_recorder_open(dir, SAMPLE_RATE);
+    if (!rec) return -1;
+    /* Odd-sized writes, so blocks straddle them. */
+    for (i=0;i<LENGTH;i+=317) {
+        int n = LENGTH - i < 317 ? LENGTH - i : 317;
+        if (rnnoise_recorder_write(rec, pcm + i, n) != n) {
+            rnnoise_recorder_close(rec);
+            return -1;
+        }
+    }
+    return rnnoise_recorder_close(rec);
+}
+
+static void test_round_trip(const char *dir, const short *pcm) {
+    int i;
+    short *out = malloc(LENGTH*sizeof(short));
+    RNNoiseRecording *r = rnnoise_recording_open(dir);
+    CHECK(r != NULL, "cannot open %s", dir);
+    if (!r) {
+        free(out);
+        return;
+    }
+    CHECK(rnnoise_recording_sample_rate(r) == SAMPLE_RATE, "sample rate %d", rnnoise_recording_sample_rate(r));
+    CHECK(rnnoise_recording_length(r) == LENGTH, "length %lld", rnnoise_recording_length(r));
+    CHECK(rnnoise_recording_read(r, 0, out, LENGTH) == LENGTH, "short read");
+    CHECK(memcmp(out, pcm, LENGTH*sizeof(short)) == 0, "decoded audio differs");
+    for (i=0;i<200;i++) {
+        long long position = next_rand()*(long long)LENGTH/32768;
+        int n = 1 + next_rand() % 4000;
+        int expected = LENGTH - position < n ? (int)(LENGTH - position) : n;
+        int got = rnnoise_recording_read(r, position, out, n);
+        CHECK(got == expected, "read %d at %lld returned %d", n, position, got);
+        if (got > 0)
+            CHECK(memcmp(out, pcm + position, got*sizeof(short)) == 0, "audio differs at %lld", position);
+    }
+    CHECK(rnnoise_recording_read(r, LENGTH, out, 10) == 0, "read past the end");
+    rnnoise_recording_close(r);
+    free(out);
+}
+
+static long file_size(const char *path) {
+    long size;
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static int patch(const char *path, long offset, const void *data, size_t size) {
+    FILE *f = fopen(path, "r+b");
+    int ok;
+    if (!f) return -1;
+    ok = fseek(f, offset, SEEK_SET) == 0 && fwrite(data, 1, size, f) == size;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+static int copy_file(const char *from, const char *to) {
+    char buf[4096];
+    size_t n;
+    FILE *in = fopen(from, "rb"), *out = fopen(to, "wb");
+    int ok = in && out;
+    while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+        ok = fwrite(buf, 1, n, out) == n;
+    if (in) fclose(in);
+    if (out) fclose(out);
+    return ok ? 0 : -1;
+}
+
+/* Reads all of a damaged recording. Whatever comes back must be a prefix
+   of the clip. */
+static void read_damaged(const char *dir, const short *pcm, const char *what) {
+    long long position = 0;
+    short out[1000];
+    RNNoiseRecording *r = rnnoise_recording_open(dir);
+    if (!r) return;
+    CHECK(rnnoise_recording_length(r) <= LENGTH, "%s: length %lld", what, rnnoise_recording_length(r));
+    for (;;) {
+        int n = rnnoise_recording_read(r, position, out, 1000);
+        if (n <= 0) break;
+        CHECK(position + n <= LENGTH && memcmp(out, pcm + position, n*sizeof(short)) == 0,
+              "%s: bad audio at %lld", what, position);
+        position += n;
+    }
+    rnnoise_recording_close(r);
+}
+
+static void test_corruption(const char *dir, const char *tmp, const short *pcm) {
+    char from[1200], to[1200], index[1200], segment[1200];
+    unsigned short nb_samples;
+    unsigned segment_no;
+    unsigned bytes;
+    long block_offset, entries;
+    FILE *f;
+    snprintf(index, sizeof(index), "%s/index", tmp);
+    snprintf(segment, sizeof(segment), "%s/000000.seg", tmp);
+    entries = (file_size(index) - INDEX_HEADER_BYTES)/INDEX_ENTRY_BYTES;
+    CHECK(entries > 2, "only %ld blocks", entries);
+    if (entries <= 2) return;
+    /* Offset of the second block in the segment. */
+    f = fopen(index, "rb");
+    fseek(f, INDEX_HEADER_BYTES + INDEX_ENTRY_BYTES + INDEX_SEGMENT_OFFSET + 4, SEEK_SET);
+    block_offset = 0;
+    if (fread(&bytes, sizeof(bytes), 1, f) == 1) block_offset = bytes;
+    fclose(f);
+
+#define RESET() do { \
+    snprintf(from, sizeof(from), "%s/index", dir); \
+    snprintf(to, sizeof(to), "%s/index", tmp); \
+    copy_file(from, to); \
+    snprintf(from, sizeof(from), "%s/000000.seg", dir); \
+    snprintf(to, sizeof(to), "%s/000000.seg", tmp); \
+    copy_file(from, to); \
+} while (0)
+
+    RESET();
+    nb_samples = 65535;
+    patch(segment, block_offset, &nb_samples, sizeof(nb_samples));
+    read_damaged(tmp, pcm, "oversized block");
+
+    RESET();
+    nb_samples = 0;
+    patch(segment, block_offset, &nb_samples, sizeof(nb_samples));
+    read_damaged(tmp, pcm, "empty block");
+
+    RESET();
+    nb_samples = 65535;
+    patch(segment, 0, &nb_samples, sizeof(nb_samples));
+    read_damaged(tmp, pcm, "oversized first block");
+
+    RESET();
+    bytes = 0xffffffff;
+    patch(segment, block_offset + 8, &bytes, sizeof(bytes));
+    read_damaged(tmp, pcm, "block past the end of the segment");
+
+    RESET();
+    segment_no = 0x7fffffff;
+    patch(index, INDEX_HEADER_BYTES + INDEX_ENTRY_BYTES + INDEX_SEGMENT_OFFSET, &segment_no, sizeof(segment_no));
+    read_damaged(tmp, pcm, "missing segment");
+
+    RESET();
+    bytes = 0x7fffffff;
+    patch(index, INDEX_HEADER_BYTES + INDEX_ENTRY_BYTES + INDEX_SEGMENT_OFFSET + 4, &bytes, sizeof(bytes));
+    read_damaged(tmp, pcm, "offset past the end of the segment");
+
+    RESET();
+    {
+        long long position = -5000;
+        patch(index, INDEX_HEADER_BYTES + INDEX_ENTRY_BYTES, &position, sizeof(position));
+        read_damaged(tmp, pcm, "overlapping positions");
+        position = 1LL << 40;
+        patch(index, INDEX_HEADER_BYTES + INDEX_ENTRY_BYTES, &position, sizeof(position));
+        read_damaged(tmp, pcm, "gap in positions");
+    }
+
+    RESET();
+    {
+        int block = 1 << 30;
+        patch(index, 12, &block, sizeof(block));
+        CHECK(rnnoise_recording_open(tmp) == NULL, "huge block size accepted");
+    }
+
+    RESET();
+    {
+        char garbage[64];
+        int i;
+        for (i=0;i<(int)sizeof(garbage);i++) garbage[i] = (char)next_rand();
+        patch(segment, block_offset + 8, garbage, sizeof(garbage));
+        read_damaged(tmp, pcm, "garbage payload");
+    }
+
+    RESET();
+    CHECK(truncate(segment, block_offset + 4) == 0, "truncate");
+    read_damaged(tmp, pcm, "truncated segment");
+#undef RESET
+}
+
+int main(int argc, char **argv) {
+    char base[1024], dir[1100], tmp[1100];
+    const char *parent = argc > 1 ? argv[1] : getenv("TMPDIR");
+    short *pcm = malloc(LENGTH*sizeof(short));
+    snprintf(base, sizeof(base), "%s/rnnoise_recorder_XXXXXX", parent ? parent : "/tmp");
+    if (!pcm || !mkdtemp(base)) {
+        perror(base);
+        return 1;
+    }
+    snprintf(dir, sizeof(dir), "%s/clean", base);
+    snprintf(tmp, sizeof(tmp), "%s/damaged", base);
+    make_clip(pcm);
+    CHECK(record(dir, pcm) == 0, "recording failed");
+    if (failures == 0) {
+        test_round_trip(dir, pcm);
+        CHECK(record(tmp, pcm) == 0, "recording failed");
+        test_corruption(dir, tmp, pcm);
+    }
+    snprintf(tmp, sizeof(tmp), "rm -rf '%s'", base);
+    if (system(tmp) != 0) fprintf(stderr, "could not remove %s\n", base);
+    free(pcm);
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("recorder: OK\n");
+    return 0;
+}
@@ -0,0 +1,155 @@
+/* Concurrency check for the model registry.
+
+   Usage:
+     rnnoise_registry_test
+
+   Several streams denoise on their own threads while another thread keeps
+   publishing models of different sizes and dropping its reference to each
+   one right away, so every model is freed as soon as the last stream
+   switches away from it. Whatever the interleaving, no stream may run a
+   freed model; run it under -fsanitize=address (or thread) to catch that.
+   Some publications are NULL, which drops the streams to spectral
+   subtraction. Without a sanitizer it only checks that every frame still
+   produces a valid voice probability, and the size limits of
+   rnnoise_model_create(). */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "rnnoise.h"
+
+#define FRAME 480
+#define NB_STREAMS 4
+#define FRAMES 200
+#define MODEL_INPUTS 23
+#define MODEL_OUTPUTS 23
+#define MAX_MODEL_NEURONS 48
+#define PUBLISH_INTERVAL_US 1000
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static float rng_uniform(unsigned *state) {
+    *state = *state*1664525u + 1013904223u;
+    return (float)(*state >> 8)*(2.f/16777216.f) - 1.f;
+}
+
+/* Small random weights; the output only has to be a valid gain. */
+static RNNoiseModel *make_model(int nb_neurons, unsigned seed) {
+    static float input_weights[MODEL_INPUTS*MAX_MODEL_NEURONS];
+    static float recurrent_weights[MAX_MODEL_NEURONS*MAX_MODEL_NEURONS];
+    static float output_weights[MAX_MODEL_NEURONS*MODEL_OUTPUTS];
+    static float input_bias[MAX_MODEL_NEURONS], neuron_bias[MAX_MODEL_NEURONS], output_bias[MODEL_OUTPUTS];
+    /* Odd seeds give sparse models, which take the other matrix path. */
+    float density = seed & 1 ? .5f : 1;
+    int i;
+    for (i=0;i<MODEL_INPUTS*nb_neurons;i++) input_weights[i] = .1f*rng_uniform(&seed);
+    for (i=0;i<nb_neurons*nb_neurons;i++) recurrent_weights[i] = .3f*rng_uniform(&seed);
+    for (i=0;i<nb_neurons*MODEL_OUTPUTS;i++) output_weights[i] = .5f*rng_uniform(&seed);
+    for (i=0;i<nb_neurons;i++) {
+        input_bias[i] = .2f*rng_uniform(&seed);
+        neuron_bias[i] = .2f*rng_uniform(&seed);
+    }
+    for (i=0;i<MODEL_OUTPUTS;i++) output_bias[i] = .5f*rng_uniform(&seed);
+    return rnnoise_model_create(nb_neurons, MODEL_OUTPUTS, input_weights, recurrent_weights, output_weights,
+                                input_bias, neuron_bias, output_bias, density);
+}
+
+typedef struct {
+    RNNoiseModelRegistry *reg;
+    int switch_mode;
+    unsigned seed;
+    int bad_frames;
+} Stream;
+
+static int streams_done;
+
+static void *stream_main(void *arg) {
+    Stream *s = arg;
+    DenoiseState *st = rnnoise_create(NULL);
+    short in[FRAME], out[FRAME];
+    int k, i;
+    if (rnnoise_model_attach(st, s->reg, s->switch_mode) != 0) s->bad_frames = FRAMES;
+    for (k=0;k<FRAMES;k++) {
+        float vad;
+        for (i=0;i<FRAME;i++)
+            in[i] = (short)(4000*sin(2*M_PI*300*(k*FRAME + i)/48000.) + 1000*rng_uniform(&s->seed));
+        vad = rnnoise_process_frame(st, out, in);
+        if (!(vad >= 0 && vad <= 1)) s->bad_frames++;
+    }
+    rnnoise_model_attach(st, NULL, s->switch_mode);
+    rnnoise_destroy(st);
+    __atomic_add_fetch(&streams_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* Publishes until every stream is done; models are released right after
+   publication, so only the registry and the streams keep them alive. The
+   pause lets each model run for a few frames, on some streams at least. */
+static int publish_until_done(RNNoiseModelRegistry *reg) {
+    static const int sizes[] = {16, 32, 48, 32};
+    int n = 0;
+    while (__atomic_load_n(&streams_done, __ATOMIC_ACQUIRE) < NB_STREAMS) {
+        RNNoiseModel *m = n % 7 == 6 ? NULL : make_model(sizes[n % 4], 100u + n);
+        rnnoise_registry_publish(reg, m);
+        rnnoise_model_release(m);
+        n++;
+        usleep(PUBLISH_INTERVAL_US);
+    }
+    return n;
+}
+
+static void test_concurrent_publish(void) {
+    RNNoiseModelRegistry *reg = rnnoise_registry_create();
+    RNNoiseModel *first = make_model(32, 1u);
+    pthread_t threads[NB_STREAMS];
+    Stream streams[NB_STREAMS];
+    int j, publications;
+    rnnoise_registry_publish(reg, first);
+    rnnoise_model_release(first);
+    for (j=0;j<NB_STREAMS;j++) {
+        streams[j].reg = reg;
+        streams[j].switch_mode = j & 1 ? RNNOISE_SWITCH_CARRY : RNNOISE_SWITCH_RESET;
+        streams[j].seed = 7u*j + 1;
+        streams[j].bad_frames = 0;
+        pthread_create(&threads[j], NULL, stream_main, &streams[j]);
+    }
+    publications = publish_until_done(reg);
+    for (j=0;j<NB_STREAMS;j++) {
+        pthread_join(threads[j], NULL);
+        CHECK(streams[j].bad_frames == 0, "stream %d: %d frames without a valid voice probability", j,
+              streams[j].bad_frames);
+    }
+    CHECK(publications > 1, "%d models published while the streams ran", publications);
+    rnnoise_registry_destroy(reg);
+}
+
+static void test_model_sizes(void) {
+    CHECK(rnnoise_model_create(0, MODEL_OUTPUTS, NULL, NULL, NULL, NULL, NULL, NULL, 1) == NULL,
+          "model with no neurons accepted");
+    CHECK(rnnoise_model_create(RNNOISE_MAX_NEURONS + 1, MODEL_OUTPUTS, NULL, NULL, NULL, NULL, NULL, NULL, 1)
+          == NULL, "model with %d neurons accepted", RNNOISE_MAX_NEURONS + 1);
+    CHECK(rnnoise_model_create(16, 5, NULL, NULL, NULL, NULL, NULL, NULL, 1) == NULL,
+          "model with 5 outputs accepted");
+}
+
+int main(void) {
+    test_model_sizes();
+    test_concurrent_publish();
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("registry: OK\n");
+    return 0;
+}
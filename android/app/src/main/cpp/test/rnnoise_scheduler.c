@@ -0,0 +1,149 @@
+/* Checks for the deadline scheduler and the processing modes it picks.
+
+   Usage:
+     rnnoise_scheduler_test
+
+   Runs frames from several streams with deadlines far in the future
+   (nothing is degraded or missed) and already past (everything drops to
+   passthrough and counts as a miss), fills the queue, and checks that
+   passthrough frames are windowed like the other modes and that an
+   out-of-range mode is clamped. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scheduler.h"
+
+#define FRAME 480
+#define NB_STREAMS 4
+#define ROUNDS 25
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static void fill(short *pcm, int n, long long offset) {
+    int i;
+    for (i=0;i<n;i++)
+        pcm[i] = (short)(8000*sin(2*M_PI*440*(offset + i)/48000.) + ((i*7919) % 601) - 300);
+}
+
+/* Runs ROUNDS frames of every stream with the deadline at now + delay_ns. */
+static void run(RNNoiseScheduler *s, DenoiseState **st, long long delay_ns) {
+    static short in[NB_STREAMS][FRAME], out[NB_STREAMS][FRAME];
+    float vad[NB_STREAMS];
+    int k, j;
+    for (k=0;k<ROUNDS;k++) {
+        long long now = rnnoise_sched_now();
+        for (j=0;j<NB_STREAMS;j++) {
+            fill(in[j], FRAME, (long long)k*FRAME);
+            /* Submitted latest deadline first, so the heap has to reorder. */
+            CHECK(rnnoise_sched_submit(s, st[j], out[j], in[j], now + delay_ns - j, &vad[j]) == 0,
+                  "submit failed");
+        }
+        CHECK(rnnoise_sched_run(s) == NB_STREAMS, "not every frame was run");
+        for (j=0;j<NB_STREAMS;j++)
+            CHECK(vad[j] >= 0 && vad[j] <= 1, "vad %f out of range", vad[j]);
+    }
+}
+
+static void test_deadlines(void) {
+    RNNoiseScheduler *s = rnnoise_sched_create(NB_STREAMS, 0);
+    DenoiseState *st[NB_STREAMS];
+    RNNoiseSchedStats stats;
+    int j;
+    for (j=0;j<NB_STREAMS;j++) st[j] = rnnoise_create(NULL);
+
+    run(s, st, 1000000000LL);
+    rnnoise_sched_get_stats(s, &stats);
+    CHECK(stats.frames == NB_STREAMS*ROUNDS, "loose: %lld frames", stats.frames);
+    CHECK(stats.misses == 0, "loose: %lld misses", stats.misses);
+    CHECK(stats.degradations == 0, "loose: %lld degradations", stats.degradations);
+    CHECK(stats.mode_frames[RNNOISE_MODE_FULL] == stats.frames, "loose: %lld full frames",
+          stats.mode_frames[RNNOISE_MODE_FULL]);
+    CHECK(stats.slack_min_ns > 0, "loose: slack %lld ns", stats.slack_min_ns);
+    CHECK(stats.cost_ns[RNNOISE_MODE_FULL] > 0, "loose: full mode cost not measured");
+
+    rnnoise_sched_reset_stats(s);
+    run(s, st, -1000000LL);
+    rnnoise_sched_get_stats(s, &stats);
+    CHECK(stats.misses == stats.frames, "late: %lld of %lld frames missed", stats.misses, stats.frames);
+    CHECK(stats.degradations == stats.frames, "late: %lld of %lld frames degraded",
+          stats.degradations, stats.frames);
+    CHECK(stats.mode_frames[RNNOISE_MODE_PASSTHROUGH] == stats.frames, "late: %lld passthrough frames",
+          stats.mode_frames[RNNOISE_MODE_PASSTHROUGH]);
+    CHECK(stats.slack_max_ns < 0, "late: slack %lld ns", stats.slack_max_ns);
+
+    for (j=0;j<NB_STREAMS;j++) rnnoise_destroy(st[j]);
+    rnnoise_sched_destroy(s);
+}
+
+static void test_queue_full(void) {
+    RNNoiseScheduler *s = rnnoise_sched_create(1, 0);
+    DenoiseState *st = rnnoise_create(NULL);
+    short in[FRAME] = {0}, out[FRAME];
+    CHECK(rnnoise_sched_submit(s, st, out, in, 0, NULL) == 0, "first submit failed");
+    CHECK(rnnoise_sched_submit(s, st, out, in, 0, NULL) == -1, "submit past capacity accepted");
+    CHECK(rnnoise_sched_run(s) == 1, "queued frame not run");
+    rnnoise_destroy(st);
+    rnnoise_sched_destroy(s);
+}
+
+/* Passthrough applies the analysis window, like the other modes, so the
+   output level does not jump when a stream switches modes. */
+static void test_passthrough_window(void) {
+    DenoiseState *st = rnnoise_create(NULL);
+    short in[FRAME], out[FRAME];
+    int i, worst = 0;
+    fill(in, FRAME, 0);
+    rnnoise_process_frame_mode(st, out, in, RNNOISE_MODE_PASSTHROUGH);
+    for (i=0;i<FRAME;i++) {
+        double w = .5*(1 - cos(2*M_PI*i/(FRAME - 1)));
+        int err = abs(out[i] - (int)(in[i]*w));
+        if (err > worst) worst = err;
+    }
+    CHECK(worst <= 1, "passthrough: off the windowed input by %d", worst);
+    /* In place, as the other modes allow. */
+    rnnoise_process_frame_mode(st, in, in, RNNOISE_MODE_PASSTHROUGH);
+    CHECK(memcmp(in, out, sizeof(out)) == 0, "passthrough: in-place output differs");
+    rnnoise_destroy(st);
+}
+
+static void test_mode_clamp(void) {
+    DenoiseState *a = rnnoise_create(NULL), *b = rnnoise_create(NULL);
+    short in[FRAME], out_a[FRAME], out_b[FRAME];
+    int k, same = 1;
+    for (k=0;k<10;k++) {
+        fill(in, FRAME, (long long)k*FRAME);
+        rnnoise_process_frame_mode(a, out_a, in, -5);
+        rnnoise_process_frame_mode(b, out_b, in, RNNOISE_MODE_FULL);
+        same &= memcmp(out_a, out_b, sizeof(out_a)) == 0;
+        rnnoise_process_frame_mode(a, out_a, in, 99);
+        rnnoise_process_frame_mode(b, out_b, in, RNNOISE_MODE_PASSTHROUGH);
+        same &= memcmp(out_a, out_b, sizeof(out_a)) == 0;
+    }
+    CHECK(same, "modes out of range are not clamped");
+    rnnoise_destroy(a);
+    rnnoise_destroy(b);
+}
+
+int main(void) {
+    test_deadlines();
+    test_queue_full();
+    test_passthrough_window();
+    test_mode_clamp();
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("scheduler: OK\n");
+    return 0;
+}
@@ -0,0 +1,347 @@
+/* Offline batch denoiser for archives of call recordings.
+
+   Usage: rnnoise_batch [-j THREADS] [-o OUTDIR] [--raw] INPUT...
+
+   Each INPUT is a 16-bit mono WAV file, a raw 16-bit little-endian PCM file
+   (.raw/.pcm, or any file with --raw), or a directory that is searched
+   recursively. Inputs are memory-mapped and spread over a pool of worker
+   threads, one DenoiseState per file; each output keeps the input's header
+   and relative path under OUTDIR and is written in large sequential chunks. */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "rnnoise.h"
+
+#define SAMPLE_RATE 48000
+/* Frames denoised between two write() calls (about 1 MB of PCM). */
+#define WRITE_FRAMES 1024
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+typedef struct {
+    char *in_path;
+    char *out_path;
+    off_t size;
+} Job;
+
+typedef struct {
+    Job *jobs;
+    int nb_jobs;
+    int next;
+    int raw;
+    pthread_mutex_t lock;
+    long long samples;
+    int failures;
+} Batch;
+
+static int add_job(Batch *b, const char *in_path, const char *out_path, off_t size) {
+    Job *jobs = realloc(b->jobs, (b->nb_jobs + 1)*sizeof(*jobs));
+    if (!jobs) return -1;
+    b->jobs = jobs;
+    jobs[b->nb_jobs].in_path = strdup(in_path);
+    jobs[b->nb_jobs].out_path = strdup(out_path);
+    jobs[b->nb_jobs].size = size;
+    b->nb_jobs++;
+    return 0;
+}
+
+static int has_suffix(const char *name, const char *suffix) {
+    size_t n = strlen(name), m = strlen(suffix);
+    return n >= m && !strcasecmp(name + n - m, suffix);
+}
+
+static int is_audio(const Batch *b, const char *name) {
+    return b->raw || has_suffix(name, ".wav") || has_suffix(name, ".raw") || has_suffix(name, ".pcm");
+}
+
+static void collect(Batch *b, const char *in_path, const char *out_path) {
+    struct stat sb;
+    DIR *dir;
+    struct dirent *e;
+
+    if (stat(in_path, &sb) != 0) {
+        fprintf(stderr, "%s: %s\n", in_path, strerror(errno));
+        b->failures++;
+        return;
+    }
+    if (!S_ISDIR(sb.st_mode)) {
+        add_job(b, in_path, out_path, sb.st_size);
+        return;
+    }
+    dir = opendir(in_path);
+    if (!dir) {
+        fprintf(stderr, "%s: %s\n", in_path, strerror(errno));
+        b->failures++;
+        return;
+    }
+    while ((e = readdir(dir)) != NULL) {
+        char *child_in, *child_out;
+        struct stat cs;
+        if (e->d_name[0] == '.') continue;
+        if (asprintf(&child_in, "%s/%s", in_path, e->d_name) < 0) continue;
+        if (asprintf(&child_out, "%s/%s", out_path, e->d_name) < 0) {
+            free(child_in);
+            continue;
+        }
+        if (stat(child_in, &cs) == 0 && (S_ISDIR(cs.st_mode) || is_audio(b, e->d_name)))
+            collect(b, child_in, child_out);
+        free(child_in);
+        free(child_out);
+    }
+    closedir(dir);
+}
+
+static int cmp_size_desc(const void *a, const void *b) {
+    off_t x = ((const Job*)a)->size, y = ((const Job*)b)->size;
+    return (x < y) - (x > y);
+}
+
+static int mkdirs_for(const char *path) {
+    char *dir = strdup(path);
+    char *p;
+    for (p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = 0;
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+            free(dir);
+            return -1;
+        }
+        *p = '/';
+    }
+    free(dir);
+    return 0;
+}
+
+static unsigned read_le32(const unsigned char *p) {
+    return p[0] | p[1]<<8 | p[2]<<16 | (unsigned)p[3]<<24;
+}
+
+static unsigned read_le16(const unsigned char *p) {
+    return p[0] | p[1]<<8;
+}
+
+/* Finds the PCM payload of a WAV file. Returns 0 and sets `offset`/`bytes`,
+   or -1 with a message in `err`. */
+static int parse_wav(const unsigned char *data, size_t size, size_t *offset, size_t *bytes, const char **err) {
+    size_t pos = 12;
+    int have_fmt = 0;
+    if (size < 12 || memcmp(data, "RIFF", 4) || memcmp(data + 8, "WAVE", 4)) {
+        *err = "not a RIFF/WAVE file";
+        return -1;
+    }
+    while (pos + 8 <= size) {
+        unsigned len = read_le32(data + pos + 4);
+        if (!memcmp(data + pos, "fmt ", 4) && len >= 16 && pos + 8 + 16 <= size) {
+            const unsigned char *fmt = data + pos + 8;
+            if (read_le16(fmt) != 1 || read_le16(fmt + 2) != 1 || read_le16(fmt + 14) != 16) {
+                *err = "only 16-bit mono PCM is supported";
+                return -1;
+            }
+            if (read_le32(fmt + 4) != SAMPLE_RATE)
+                fprintf(stderr, "warning: sample rate is %u Hz, the model expects %d Hz\n", read_le32(fmt + 4), SAMPLE_RATE);
+            have_fmt = 1;
+        } else if (!memcmp(data + pos, "data", 4)) {
+            if (!have_fmt) break;
+            *offset = pos + 8;
+            *bytes = MIN(len, size - *offset) & ~(size_t)1;
+            return 0;
+        }
+        pos += 8 + len + (len & 1);
+    }
+    *err = "missing fmt or data chunk";
+    return -1;
+}
+
+static int write_all(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= w;
+    }
+    return 0;
+}
+
+/* Denoises one file. Returns the number of samples processed, or -1. */
+static long long process_file(const Job *job, int raw, short *buf) {
+    int fd, out_fd;
+    unsigned char *data;
+    size_t offset = 0, bytes;
+    const char *err = NULL;
+    long long nb_samples, done;
+    int frame_size = rnnoise_get_frame_size();
+    DenoiseState *st;
+
+    fd = open(job->in_path, O_RDONLY);
+    if (fd < 0 || job->size == 0) {
+        fprintf(stderr, "%s: %s\n", job->in_path, fd < 0 ? strerror(errno) : "empty file");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    data = mmap(NULL, job->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "%s: mmap: %s\n", job->in_path, strerror(errno));
+        return -1;
+    }
+    madvise(data, job->size, MADV_SEQUENTIAL);
+
+    bytes = job->size & ~(size_t)1;
+    if (!raw && has_suffix(job->in_path, ".wav") && parse_wav(data, job->size, &offset, &bytes, &err) != 0) {
+        fprintf(stderr, "%s: %s\n", job->in_path, err);
+        munmap(data, job->size);
+        return -1;
+    }
+
+    if (mkdirs_for(job->out_path) != 0 ||
+        (out_fd = open(job->out_path, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "%s: %s\n", job->out_path, strerror(errno));
+        munmap(data, job->size);
+        return -1;
+    }
+    /* The header (and anything before the samples) is copied verbatim. */
+    if (offset > 0 && write_all(out_fd, data, offset) != 0) {
+        fprintf(stderr, "%s: %s\n", job->out_path, strerror(errno));
+        close(out_fd);
+        munmap(data, job->size);
+        return -1;
+    }
+
+    st = rnnoise_create(NULL);
+    nb_samples = bytes/sizeof(short);
+    for (done = 0; done < nb_samples; ) {
+        long long chunk = MIN(nb_samples - done, (long long)WRITE_FRAMES*frame_size);
+        int frames = (int)(chunk/frame_size);
+        const short *in = (const short*)(data + offset) + done;
+        rnnoise_process_frames(st, buf, in, frames, NULL);
+        if (chunk > (long long)frames*frame_size) {
+            /* Zero-pad the final partial frame. */
+            short last[frame_size];
+            int tail = (int)(chunk - (long long)frames*frame_size);
+            memset(last, 0, sizeof(last));
+            memcpy(last, in + (long long)frames*frame_size, tail*sizeof(short));
+            rnnoise_process_frame(st, last, last);
+            memcpy(buf + (long long)frames*frame_size, last, tail*sizeof(short));
+        }
+        if (write_all(out_fd, buf, chunk*sizeof(short)) != 0) {
+            fprintf(stderr, "%s: %s\n", job->out_path, strerror(errno));
+            nb_samples = -1;
+            break;
+        }
+        done += chunk;
+    }
+    rnnoise_destroy(st);
+    if (close(out_fd) != 0 && nb_samples >= 0) {
+        fprintf(stderr, "%s: %s\n", job->out_path, strerror(errno));
+        nb_samples = -1;
+    }
+    munmap(data, job->size);
+    return nb_samples;
+}
+
+static void *worker(void *arg) {
+    Batch *b = arg;
+    short *buf = malloc((size_t)WRITE_FRAMES*rnnoise_get_frame_size()*sizeof(short));
+    for (;;) {
+        int i;
+        long long n;
+        pthread_mutex_lock(&b->lock);
+        i = b->next++;
+        pthread_mutex_unlock(&b->lock);
+        if (i >= b->nb_jobs) break;
+        n = process_file(&b->jobs[i], b->raw, buf);
+        pthread_mutex_lock(&b->lock);
+        if (n < 0) b->failures++;
+        else b->samples += n;
+        pthread_mutex_unlock(&b->lock);
+    }
+    free(buf);
+    return NULL;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-j THREADS] [-o OUTDIR] [--raw] INPUT...\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    Batch b;
+    const char *outdir = "denoised";
+    int nb_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int i, nb_inputs = 0;
+    pthread_t *threads;
+    double start, elapsed, hours;
+
+    memset(&b, 0, sizeof(b));
+    pthread_mutex_init(&b.lock, NULL);
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i], "-j") && i+1 < argc) nb_threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i+1 < argc) outdir = argv[++i];
+        else if (!strcmp(argv[i], "--raw")) b.raw = 1;
+        else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    for (i=1;i<argc;i++) {
+        char *out_path;
+        const char *base;
+        if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "-o")) {
+            i++;
+            continue;
+        }
+        if (argv[i][0] == '-') continue;
+        base = strrchr(argv[i], '/');
+        base = base && base[1] ? base + 1 : argv[i];
+        if (asprintf(&out_path, "%s/%s", outdir, base) < 0) return 1;
+        collect(&b, argv[i], out_path);
+        free(out_path);
+        nb_inputs++;
+    }
+    if (nb_inputs == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (nb_threads < 1) nb_threads = 1;
+    if (nb_threads > b.nb_jobs) nb_threads = b.nb_jobs > 0 ? b.nb_jobs : 1;
+    /* Largest files first so a long recording does not end up last. */
+    qsort(b.jobs, b.nb_jobs, sizeof(*b.jobs), cmp_size_desc);
+
+    start = now_s();
+    threads = malloc(nb_threads*sizeof(*threads));
+    for (i=0;i<nb_threads;i++) pthread_create(&threads[i], NULL, worker, &b);
+    for (i=0;i<nb_threads;i++) pthread_join(threads[i], NULL);
+    elapsed = now_s() - start;
+
+    hours = b.samples/(double)SAMPLE_RATE/3600.;
+    printf("%d files, %d failed, %.3f audio hours in %.2f s on %d threads: %.4f audio-hours/s (%.1fx real time)\n",
+           b.nb_jobs, b.failures, hours, elapsed, nb_threads,
+           elapsed > 0 ? hours/elapsed : 0, elapsed > 0 ? hours*3600./elapsed : 0);
+
+    for (i=0;i<b.nb_jobs;i++) {
+        free(b.jobs[i].in_path);
+        free(b.jobs[i].out_path);
+    }
+    free(b.jobs);
+    free(threads);
+    return b.failures ? 2 : 0;
+}
@@ -0,0 +1,35 @@
+package com.shailesh.callai
+
+/**
+ * Detects the caller talking over AI playback, telling their speech apart from
+ * echo of the playback by comparing against the audio handed to the AudioTrack
+ * (pushed automatically by [CallConnectionService.playAudioInternal] while this
+ * detector is open). On an interruption the playback queue is flushed at once
+ * and Flutter receives onBargeIn. [CallAudioCapture] attaches one for the
+ * length of each call.
+ */
+class BargeInDetector(minSpeechMs: Int = 30) : AutoCloseable {
+    private var detector = RNNoise.bargeinCreate(minSpeechMs)
+
+    init {
+        CallConnectionService.bargeInDetector = detector
+    }
+
+    /** Call with every denoised microphone frame and its VAD probability, on the audio thread. */
+    fun onFrame(frame: ShortArray, vadProb: Float) {
+        if (RNNoise.bargeinUpdate(detector, frame, vadProb) == RNNoise.EVENT_BARGE_IN) {
+            CallConnectionService.interruptPlayback()
+            CallConnectionService.sendTurnEvent(RNNoise.EVENT_BARGE_IN)
+        }
+    }
+
+    /** Call from the thread that calls [onFrame], once it no longer does. */
+    override fun close() {
+        if (detector != 0L) {
+            // Waits for a push from the playback thread to finish, so freeing is safe afterwards.
+            CallConnectionService.detachBargeInDetector(detector)
+            RNNoise.bargeinDestroy(detector)
+            detector = 0
+        }
+    }
+}
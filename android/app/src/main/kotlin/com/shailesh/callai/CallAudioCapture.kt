@@ -0,0 +1,103 @@
+package com.shailesh.callai
+
+import android.annotation.SuppressLint
+import android.media.AudioFormat
+import android.media.AudioRecord
+import android.media.MediaRecorder
+import android.os.Process
+import android.util.Log
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Captures the caller's side of a call and denoises it in 10 ms frames, with echo cancellation
+ * against the AI playback: while it runs, its denoiser is [CallConnectionService.echoReferenceState].
+ * Each denoised frame drives a [TurnDetector] and a [BargeInDetector], whose events go to Flutter,
+ * and goes to the call recording through [CallConnectionService.writeCallerAudio].
+ */
+class CallAudioCapture(private val echoTailFrames: Int = ECHO_TAIL_FRAMES) : AutoCloseable {
+    private var state = RNNoise.create()
+    private var thread: Thread? = null
+    @Volatile private var running = false
+
+    @SuppressLint("MissingPermission")
+    fun start(): Boolean {
+        val bufferBytes = maxOf(
+            AudioRecord.getMinBufferSize(SAMPLE_RATE, AudioFormat.CHANNEL_IN_MONO, AudioFormat.ENCODING_PCM_16BIT),
+            4 * RNNoise.FRAME_SIZE * 2
+        )
+        val record = AudioRecord(
+            MediaRecorder.AudioSource.VOICE_RECOGNITION,
+            SAMPLE_RATE,
+            AudioFormat.CHANNEL_IN_MONO,
+            AudioFormat.ENCODING_PCM_16BIT,
+            bufferBytes
+        )
+        if (record.state != AudioRecord.STATE_INITIALIZED) {
+            Log.e(TAG, "Cannot open the microphone")
+            record.release()
+            return false
+        }
+        running = true
+        thread = Thread({ capture(record) }, "call-capture").apply { start() }
+        return true
+    }
+
+    private fun capture(record: AudioRecord) {
+        Process.setThreadPriority(Process.THREAD_PRIORITY_URGENT_AUDIO)
+        // Enabled here because it must happen on the processing thread.
+        if (RNNoise.aecEnable(state, echoTailFrames)) {
+            CallConnectionService.echoReferenceState = state
+        } else {
+            Log.w(TAG, "Echo cancellation unavailable")
+        }
+        val frame = ShortArray(RNNoise.FRAME_SIZE)
+        // The recorder takes native-order bytes; the view writes them without allocating.
+        val frameBytes = ByteArray(RNNoise.FRAME_SIZE * 2)
+        val frameShorts = ByteBuffer.wrap(frameBytes).order(ByteOrder.nativeOrder()).asShortBuffer()
+        val turns = TurnDetector()
+        val bargeIn = BargeInDetector()
+        record.startRecording()
+        try {
+            while (running) {
+                val n = record.read(frame, 0, frame.size)
+                if (n < 0) {
+                    Log.e(TAG, "Microphone read failed: $n")
+                    break
+                }
+                if (n != frame.size) continue
+                val vad = RNNoise.processFrame(state, frame)
+                turns.onFrame(vad)
+                bargeIn.onFrame(frame, vad)
+                frameShorts.rewind()
+                frameShorts.put(frame)
+                CallConnectionService.writeCallerAudio(frameBytes, frameBytes.size)
+            }
+        } finally {
+            // Once the setter returns, the playback thread no longer pushes into the state.
+            CallConnectionService.echoReferenceState = 0
+            turns.close()
+            bargeIn.close()
+            record.stop()
+            record.release()
+        }
+    }
+
+    /** Stops capturing and frees the denoiser. */
+    override fun close() {
+        running = false
+        thread?.join()
+        thread = null
+        if (state != 0L) {
+            RNNoise.destroy(state)
+            state = 0
+        }
+    }
+
+    companion object {
+        private const val TAG = "CallAudioCapture"
+        private const val SAMPLE_RATE = 48000
+        /** Echo path covered by the canceller: the AudioTrack buffer plus the room, 200 ms. */
+        private const val ECHO_TAIL_FRAMES = 20
+    }
+}
@@ -6,6 +6,9 @@ import android.media.AudioManager
 import android.net.Uri
 import android.os.Build
 import android.os.Bundle
+import android.os.Handler
+import android.os.Looper
+import android.os.Process
 import android.telecom.Connection
 import android.telecom.ConnectionRequest
 import android.telecom.ConnectionService
@@ -13,6 +16,7 @@ import android.telecom.PhoneAccountHandle
 import android.telecom.TelecomManager
 import android.util.Log
 import androidx.annotation.RequiresApi
+import io.flutter.plugin.common.MethodCall
 import io.flutter.plugin.common.MethodChannel
 import android.telecom.DisconnectCause
 import android.media.AudioFormat
@@ -24,9 +28,14 @@ class CallConnectionService : ConnectionService() {
     private var currentConnection: CallConnection? = null
     private lateinit var audioManager: AudioManager
     private var audioTrack: AudioTrack? = null
+    private var jitterBuffer = 0L
+    private var playbackThread: Thread? = null
+    @Volatile private var playbackRunning = false
 
     companion object {
         private const val TAG = "CallConnectionService"
+        private const val PLAYBACK_SAMPLE_RATE = 16000 // Match your TTS output
+        private const val CAPTURE_SAMPLE_RATE = 48000
         private var methodChannel: MethodChannel? = null
         private var instance: CallConnectionService? = null
 
@@ -36,10 +45,141 @@ class CallConnectionService : ConnectionService() {
             instance?.setupMethodCallHandler()
         }
 
+        /**
+         * Held by the audio threads while they use one of the native handles below, and by every
+         * change of a handle. Once a setter returns, no thread still uses the previous handle, so
+         * it can be freed right away.
+         */
+        private val audioHandleLock = Any()
+
+        /**
+         * Denoiser state that receives played audio as its echo reference (see [RNNoise.aecEnable]), or 0.
+         * Set by [CallAudioCapture] while a call is captured.
+         */
+        @JvmStatic
+        var echoReferenceState: Long = 0
+            set(value) = synchronized(audioHandleLock) { field = value }
+
+        /** Native barge-in detector told about played audio (see [BargeInDetector]), or 0. */
+        @JvmStatic
+        var bargeInDetector: Long = 0
+            set(value) = synchronized(audioHandleLock) { field = value }
+
+        /** Clears [bargeInDetector] if it is still [detector]; afterwards [detector] may be freed. */
+        @JvmStatic
+        fun detachBargeInDetector(detector: Long) {
+            synchronized(audioHandleLock) {
+                if (bargeInDetector == detector) bargeInDetector = 0
+            }
+        }
+
+        /** Native recorder for the denoised caller audio (48 kHz), or 0; see [writeCallerAudio]. */
+        private var callerRecorder: Long = 0
+
+        /** Native recorder for the AI audio, fed by the playback thread, or 0. */
+        private var aiRecorder: Long = 0
+
+        private var recordingPlayer: RecordingPlayer? = null
+
+        private var callAudio: CallAudioCapture? = null
+
+        /** Starts capturing and denoising the caller's audio for a new call. Main thread only. */
+        @JvmStatic
+        fun startCallAudio() {
+            if (callAudio != null) return
+            val capture = CallAudioCapture()
+            if (capture.start()) callAudio = capture else capture.close()
+        }
+
+        /** Stops the call's capture and playback. Main thread only; safe to call more than once. */
+        @JvmStatic
+        fun endCallAudio() {
+            callAudio?.close()
+            callAudio = null
+            instance?.stopAudioPlayback()
+        }
+
+        /**
+         * Starts recording the call into [dir]: the AI side in dir/ai and the caller side in
+         * dir/caller. The audio threads only queue samples; native writer threads do the I/O.
+         */
+        @JvmStatic
+        fun startRecording(dir: String): Boolean {
+            stopRecording()
+            java.io.File(dir).mkdirs()
+            val ai = RNNoise.recorderOpen("$dir/ai", PLAYBACK_SAMPLE_RATE)
+            val caller = RNNoise.recorderOpen("$dir/caller", CAPTURE_SAMPLE_RATE)
+            synchronized(audioHandleLock) {
+                aiRecorder = ai
+                callerRecorder = caller
+            }
+            return ai != 0L && caller != 0L
+        }
+
+        /**
+         * Records the first [bytes] bytes (native byte order) of a denoised 48 kHz caller frame, if
+         * a recording is running. [CallAudioCapture] calls it with each processed frame.
+         */
+        @JvmStatic
+        fun writeCallerAudio(pcm: ByteArray, bytes: Int) {
+            synchronized(audioHandleLock) {
+                if (callerRecorder != 0L) RNNoise.recorderWrite(callerRecorder, pcm, bytes)
+            }
+        }
+
+        @JvmStatic
+        fun stopRecording() {
+            val recorders = synchronized(audioHandleLock) {
+                longArrayOf(aiRecorder, callerRecorder).also {
+                    aiRecorder = 0
+                    callerRecorder = 0
+                }
+            }
+            if (recorders.all { it == 0L }) return
+            // No audio thread can still be writing. Closing flushes to disk, so keep it off the
+            // caller's thread.
+            Thread({
+                for (recorder in recorders) {
+                    if (recorder != 0L && !RNNoise.recorderClose(recorder)) {
+                        Log.e(TAG, "Recording write failed")
+                    }
+                }
+            }, "recording-close").start()
+        }
+
+        /**
+         * Handles an audio channel call. [MainActivity] replaces the channel's handler with its
+         * own and passes on the methods it does not know.
+         */
+        @JvmStatic
+        fun handleMethodCall(call: MethodCall, result: MethodChannel.Result) {
+            instance?.onMethodCall(call, result) ?: result.notImplemented()
+        }
+
         @JvmStatic
         fun playAudio(audioData: ByteArray) {
             instance?.playAudioInternal(audioData)
         }
+
+        /** Drops queued AI audio so that the caller is not talked over. Safe from any thread. */
+        @JvmStatic
+        fun interruptPlayback() {
+            instance?.flushAudioPlayback()
+        }
+
+        /** Forwards a detector event to Flutter as onSpeechStart / onEndOfTurn / onBargeIn. */
+        @JvmStatic
+        fun sendTurnEvent(event: Int) {
+            val method = when (event) {
+                RNNoise.EVENT_SPEECH_START -> "onSpeechStart"
+                RNNoise.EVENT_END_OF_TURN -> "onEndOfTurn"
+                RNNoise.EVENT_BARGE_IN -> "onBargeIn"
+                else -> return
+            }
+            mainHandler.post { methodChannel?.invokeMethod(method, null) }
+        }
+
+        private val mainHandler = Handler(Looper.getMainLooper())
     }
 
     override fun onCreate() {
@@ -48,32 +188,70 @@ class CallConnectionService : ConnectionService() {
     }
 
     private fun setupMethodCallHandler() {
-        methodChannel?.setMethodCallHandler { call, result ->
-            when (call.method) {
-                "startCall" -> {
-                    val number = call.argument<String>("number")
-                    if (number != null) {
-                        startCall(number)
-                        result.success(null)
-                    } else {
-                        result.error("INVALID_ARGUMENT", "Phone number is required.", null)
-                    }
+        methodChannel?.setMethodCallHandler { call, result -> onMethodCall(call, result) }
+    }
+
+    private fun onMethodCall(call: MethodCall, result: MethodChannel.Result) {
+        when (call.method) {
+            "startCall" -> {
+                val number = call.argument<String>("number")
+                if (number != null) {
+                    startCall(number)
+                    result.success(null)
+                } else {
+                    result.error("INVALID_ARGUMENT", "Phone number is required.", null)
                 }
-                "endCall" -> {
-                    endCall()
+            }
+            "endCall" -> {
+                endCall()
+                result.success(null)
+            }
+            "startRecording" -> {
+                val dir = call.argument<String>("dir")
+                if (dir != null) {
+                    result.success(startRecording(dir))
+                } else {
+                    result.error("INVALID_ARGUMENT", "Recording directory is required.", null)
+                }
+            }
+            "stopRecording" -> {
+                stopRecording()
+                result.success(null)
+            }
+            "getRecordingDuration" -> {
+                val dir = call.argument<String>("dir")
+                if (dir != null) {
+                    result.success(RecordingPlayer.durationMs(dir))
+                } else {
+                    result.error("INVALID_ARGUMENT", "Recording directory is required.", null)
+                }
+            }
+            "playRecording" -> {
+                val dir = call.argument<String>("dir")
+                val positionMs = call.argument<Int>("positionMs") ?: 0
+                if (dir != null) {
+                    recordingPlayer?.stop()
+                    recordingPlayer = RecordingPlayer(dir).also { it.start(positionMs.toLong()) }
                     result.success(null)
+                } else {
+                    result.error("INVALID_ARGUMENT", "Recording directory is required.", null)
                 }
-                "setSpeakerphoneOn" -> {
-                    val on = call.argument<Boolean>("on")
-                    if (on != null) {
-                        setSpeakerphoneOn(on)
-                        result.success(null)
-                    } else {
-                        result.error("INVALID_ARGUMENT", "Boolean 'on' is required.", null)
-                    }
+            }
+            "stopRecordingPlayback" -> {
+                recordingPlayer?.stop()
+                recordingPlayer = null
+                result.success(null)
+            }
+            "setSpeakerphoneOn" -> {
+                val on = call.argument<Boolean>("on")
+                if (on != null) {
+                    setSpeakerphoneOn(on)
+                    result.success(null)
+                } else {
+                    result.error("INVALID_ARGUMENT", "Boolean 'on' is required.", null)
                 }
-                else -> result.notImplemented()
             }
+            else -> result.notImplemented()
         }
     }
 
@@ -103,9 +281,12 @@ class CallConnectionService : ConnectionService() {
     ): Connection {
         Log.d(TAG, "onCreateOutgoingConnection")
         
-        val connection = CallConnection {
-            // Handle state changes if needed
-        }.apply {
+        val connection = CallConnection(
+            onAudioStateChanged = {
+                // Handle state changes if needed
+            },
+            onEnded = { endCallAudio() }
+        ).apply {
             setAddress(request.address, TelecomManager.PRESENTATION_ALLOWED)
             audioModeIsVoip = true
             setCallerDisplayName("Call-AI", TelecomManager.PRESENTATION_ALLOWED)
@@ -113,6 +294,7 @@ class CallConnectionService : ConnectionService() {
         }
         
         currentConnection = connection
+        startCallAudio()
         return connection
     }
 
@@ -125,31 +307,96 @@ class CallConnectionService : ConnectionService() {
         methodChannel?.invokeMethod("onCallStateChanged", "failed")
     }
 
+    /**
+     * Queues a TTS chunk. Chunks go through a native jitter buffer that a dedicated thread drains
+     * into the AudioTrack in 20 ms frames, so bursty arrival neither underruns nor builds up delay.
+     */
     fun playAudioInternal(audioData: ByteArray) {
-        val sampleRate = 16000 // Match your TTS output
-        if (audioTrack == null) {
-            audioTrack = AudioTrack(
-                AudioManager.STREAM_VOICE_CALL,
-                sampleRate,
-                AudioFormat.CHANNEL_OUT_MONO,
-                AudioFormat.ENCODING_PCM_16BIT,
-                AudioTrack.getMinBufferSize(sampleRate, AudioFormat.CHANNEL_OUT_MONO, AudioFormat.ENCODING_PCM_16BIT),
-                AudioTrack.MODE_STREAM
-            )
-            audioTrack?.play()
+        synchronized(audioHandleLock) {
+            if (audioTrack == null) {
+                audioTrack = AudioTrack(
+                    AudioManager.STREAM_VOICE_CALL,
+                    PLAYBACK_SAMPLE_RATE,
+                    AudioFormat.CHANNEL_OUT_MONO,
+                    AudioFormat.ENCODING_PCM_16BIT,
+                    AudioTrack.getMinBufferSize(PLAYBACK_SAMPLE_RATE, AudioFormat.CHANNEL_OUT_MONO, AudioFormat.ENCODING_PCM_16BIT),
+                    AudioTrack.MODE_STREAM
+                )
+                audioTrack?.play()
+                jitterBuffer = RNNoise.jitterCreate(PLAYBACK_SAMPLE_RATE, 40, 400)
+                startPlaybackThread()
+            }
+            RNNoise.jitterPut(jitterBuffer, audioData, audioData.size)
         }
-        audioTrack?.write(audioData, 0, audioData.size)
     }
 
+    private fun startPlaybackThread() {
+        val track = audioTrack ?: return
+        val jb = jitterBuffer
+        playbackRunning = true
+        playbackThread = Thread({
+            Process.setThreadPriority(Process.THREAD_PRIORITY_URGENT_AUDIO)
+            val frame = ByteArray(RNNoise.jitterFrameSize(jb) * 2)
+            while (playbackRunning) {
+                val status = RNNoise.jitterGet(jb, frame)
+                // The pushes only queue samples, so the lock is held briefly and is contended
+                // only while a handle changes.
+                synchronized(audioHandleLock) {
+                    // The echo canceller needs a continuous reference; barge-in only cares while audio plays.
+                    if (echoReferenceState != 0L) {
+                        RNNoise.pushEchoReference(echoReferenceState, frame, frame.size, PLAYBACK_SAMPLE_RATE)
+                    }
+                    if (bargeInDetector != 0L && status != RNNoise.JITTER_SILENCE) {
+                        RNNoise.bargeinPushReference(bargeInDetector, frame, frame.size, PLAYBACK_SAMPLE_RATE)
+                    }
+                    // Silence is recorded too, so recording time matches call time.
+                    if (aiRecorder != 0L) RNNoise.recorderWrite(aiRecorder, frame, frame.size)
+                }
+                // Blocks once the track buffer is full, which paces the loop.
+                track.write(frame, 0, frame.size)
+            }
+        }, "ai-playback").apply { start() }
+    }
+
+    /**
+     * Discards everything written but not yet played, keeping the track ready for the next response.
+     * Safe from any thread; the lock keeps [stopAudioPlayback] from freeing the handles meanwhile.
+     */
+    fun flushAudioPlayback() {
+        synchronized(audioHandleLock) {
+            if (jitterBuffer != 0L) RNNoise.jitterFlush(jitterBuffer)
+            audioTrack?.let {
+                it.pause()
+                it.flush()
+                it.play()
+            }
+        }
+    }
+
+    /** Stops the playback thread and frees the track and the jitter buffer. Safe to call when stopped. */
     fun stopAudioPlayback() {
-        audioTrack?.stop()
-        audioTrack?.release()
-        audioTrack = null
+        // Cleared under the lock, so no flush can reach the handles once they are freed below.
+        val (track, jb, thread) = synchronized(audioHandleLock) {
+            Triple(audioTrack, jitterBuffer, playbackThread).also {
+                playbackRunning = false
+                audioTrack = null
+                jitterBuffer = 0
+                playbackThread = null
+            }
+        }
+        // Stopping the track releases a write blocked on a full buffer.
+        track?.stop()
+        thread?.join()
+        track?.release()
+        if (jb != 0L) RNNoise.jitterDestroy(jb)
     }
 }
 
 @RequiresApi(Build.VERSION_CODES.M)
-class CallConnection(private val onAudioStateChanged: (state: android.telecom.CallAudioState?) -> Unit) : Connection() {
+class CallConnection(
+    private val onAudioStateChanged: (state: android.telecom.CallAudioState?) -> Unit,
+    private val onEnded: () -> Unit = {}
+) : Connection() {
 
     init {
         audioModeIsVoip = true
@@ -174,7 +421,7 @@ class CallConnection(private val onAudioStateChanged: (state: android.telecom.Ca
             }
             STATE_DISCONNECTED -> {
                 Log.d("CallConnection", "Call disconnected")
-                destroy()
+                end()
             }
         }
     }
@@ -186,7 +433,7 @@ class CallConnection(private val onAudioStateChanged: (state: android.telecom.Ca
     override fun onDisconnect() {
         Log.d("CallConnection", "onDisconnect")
         setDisconnected(DisconnectCause(DisconnectCause.LOCAL))
-        destroy()
+        end()
     }
 
     override fun onSeparate() {
@@ -196,6 +443,12 @@ class CallConnection(private val onAudioStateChanged: (state: android.telecom.Ca
     override fun onAbort() {
         Log.d("CallConnection", "onAbort")
         setDisconnected(DisconnectCause(DisconnectCause.LOCAL))
+        end()
+    }
+
+    /** Releases the call's audio and the connection. */
+    private fun end() {
+        onEnded()
         destroy()
     }
 
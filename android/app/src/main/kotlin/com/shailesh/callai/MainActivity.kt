@@ -144,7 +144,7 @@ class MainActivity: FlutterActivity() {
                     startActivity(intent)
                     result.success(null)
                 }
-                else -> result.notImplemented()
+                else -> CallConnectionService.handleMethodCall(call, result)
             }
         }
     }
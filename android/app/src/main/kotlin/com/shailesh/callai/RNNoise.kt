@@ -1,11 +1,178 @@
 package com.shailesh.callai
 
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.FloatBuffer
+
 object RNNoise {
     init {
         System.loadLibrary("rnnoise_jni")
     }
 
+    /** Samples per frame (10 ms). */
+    val FRAME_SIZE: Int = frameSize()
+
+    /** Allocates a direct buffer for [frames] frames of 16-bit PCM in native byte order. */
+    fun allocateFrameBuffer(frames: Int = 1): ByteBuffer =
+        ByteBuffer.allocateDirect(frames * FRAME_SIZE * 2).order(ByteOrder.nativeOrder())
+
+    /** Allocates a direct buffer for [frames] VAD probabilities. */
+    fun allocateVadBuffer(frames: Int): FloatBuffer =
+        ByteBuffer.allocateDirect(frames * 4).order(ByteOrder.nativeOrder()).asFloatBuffer()
+
     external fun create(): Long
+    external fun frameSize(): Int
     external fun processFrame(state: Long, frame: ShortArray): Float
+    /** Zero-copy variant; both buffers must be direct (see [allocateFrameBuffer]). */
+    external fun processFrameDirect(state: Long, input: ByteBuffer, output: ByteBuffer): Float
+    /** Processes [frames] consecutive frames of one stream in a single native call. */
+    external fun processFrames(state: Long, input: ByteBuffer, output: ByteBuffer, frames: Int, vad: FloatBuffer)
+    /** Processes one frame per state, with the frames stored stream after stream. */
+    external fun processStreams(states: LongArray, input: ByteBuffer, output: ByteBuffer, vad: FloatBuffer)
+    external fun setComplexity(state: Long, complexity: Int)
+
+    /**
+     * Enables [mels] log-mel bands (or [mfcc] cepstral coefficients when non-zero) per frame, computed
+     * from the denoised spectrum and returned [stack] frames at a time; 0 mels disables. At most 128
+     * mels and 1024 stacked frames; larger values return false.
+     */
+    external fun featuresEnable(state: Long, mels: Int, mfcc: Int, stack: Int): Boolean
+
+    /**
+     * Returns the latest stacked features as a view of native memory (oldest frame first), or null if
+     * disabled. Read it before the next frame of [state] is processed; it is not a copy.
+     */
+    fun getFeatureBuffer(state: Long): FloatBuffer? =
+        getFeatures(state)?.order(ByteOrder.nativeOrder())?.asFloatBuffer()
+    external fun getFeatures(state: Long): ByteBuffer?
+
+    /**
+     * Enables automatic gain control towards [targetDb] (relative to a full-scale tone, e.g. -20),
+     * boosting by at most [maxGainDb]; a target of 0 disables it.
+     */
+    external fun agcEnable(state: Long, targetDb: Float, maxGainDb: Float)
+
+    /**
+     * Enables echo cancellation with an echo tail of [partitions] frames (10 ms each), which must cover
+     * the AudioTrack buffer latency; 0 disables it. Call from the processing thread.
+     */
+    external fun aecEnable(state: Long, partitions: Int): Boolean
+    /** Queues the first [bytes] bytes of 16-bit playback PCM at [sampleRate] as the echo reference. */
+    external fun pushEchoReference(state: Long, pcm: ByteArray, bytes: Int, sampleRate: Int): Int
+
+    /** Returns the per-stage timings of [state], or null if the library was built without RNNOISE_STATS. */
+    fun getStats(state: Long): Stats? {
+        val raw = LongArray(Stats.SIZE)
+        return if (getStats(state, raw)) Stats(raw) else null
+    }
+    external fun getStats(state: Long, out: LongArray): Boolean
+    external fun resetStats(state: Long)
+
+    /** Creates a turn endpointer fed with per-frame VAD probabilities; see [TurnDetector]. */
+    external fun endpointCreate(minSpeechMs: Int, hangoverMs: Int): Long
+    /** Advances the endpointer by one frame and returns one of the EVENT_* values. */
+    external fun endpointUpdate(endpointer: Long, vadProb: Float): Int
+    external fun endpointReset(endpointer: Long)
+    external fun endpointDestroy(endpointer: Long)
+
+    const val EVENT_NONE = 0
+    const val EVENT_SPEECH_START = 1
+    const val EVENT_END_OF_TURN = 2
+    const val EVENT_BARGE_IN = 3
+
+    /** Creates a barge-in detector; see [BargeInDetector]. */
+    external fun bargeinCreate(minSpeechMs: Int): Long
+    /** Reports the first [bytes] bytes of 16-bit PCM handed to the AudioTrack. */
+    external fun bargeinPushReference(detector: Long, pcm: ByteArray, bytes: Int, sampleRate: Int)
+    /** Advances by one denoised frame; returns [EVENT_BARGE_IN] or [EVENT_NONE]. */
+    external fun bargeinUpdate(detector: Long, frame: ShortArray, vadProb: Float): Int
+    external fun bargeinDestroy(detector: Long)
+
+    /** Creates an adaptive playback jitter buffer whose delay stays within [minDelayMs, maxDelayMs]. */
+    external fun jitterCreate(sampleRate: Int, minDelayMs: Int, maxDelayMs: Int): Long
+    /** Samples produced by each [jitterGet] (20 ms). */
+    external fun jitterFrameSize(jitterBuffer: Long): Int
+    /** Queues the first [bytes] bytes of arriving 16-bit PCM; returns the samples accepted. */
+    external fun jitterPut(jitterBuffer: Long, pcm: ByteArray, bytes: Int): Int
+    /** Fills [pcm] with the next frame for playback and returns one of the JITTER_* values. */
+    external fun jitterGet(jitterBuffer: Long, pcm: ByteArray): Int
+    /** Drops all queued audio; safe from any thread. */
+    external fun jitterFlush(jitterBuffer: Long)
+    external fun jitterDestroy(jitterBuffer: Long)
+
+    const val JITTER_NORMAL = 0
+    const val JITTER_ACCELERATE = 1
+    const val JITTER_STRETCH = 2
+    const val JITTER_CONCEAL = 3
+    const val JITTER_SILENCE = 4
+
+    /**
+     * Starts an append-only recording in [dir]. [recorderWrite] never blocks; a writer thread
+     * compresses and appends 100 ms blocks. Returns 0 on failure.
+     */
+    external fun recorderOpen(dir: String, sampleRate: Int): Long
+    /** Queues the first [bytes] bytes of 16-bit PCM; returns the samples accepted. */
+    external fun recorderWrite(recorder: Long, pcm: ByteArray, bytes: Int): Int
+    /** Samples dropped because the writer fell behind. */
+    external fun recorderDropped(recorder: Long): Long
+    /** Writes out queued audio and frees the recorder; false if any write failed. */
+    external fun recorderClose(recorder: Long): Boolean
+
+    /** Opens a recording made with [recorderOpen] for reading, or returns 0. */
+    external fun recordingOpen(dir: String): Long
+    external fun recordingSampleRate(recording: Long): Int
+    /** Length in samples. */
+    external fun recordingLength(recording: Long): Long
+    /** Fills [pcm] with 16-bit samples from [position] on; returns the samples read, 0 at the end. */
+    external fun recordingRead(recording: Long, position: Long, pcm: ByteArray): Int
+    external fun recordingClose(recording: Long)
+
+    /** Tags the trace events of [state]; states are numbered in creation order by default. */
+    external fun setStreamId(state: Long, streamId: Int)
+
+    /**
+     * Starts writing a Chrome trace (loadable in chrome://tracing or ui.perfetto.dev) to [path].
+     * Returns false if the library was built without RNNOISE_TRACE or a trace is already running.
+     */
+    external fun traceStart(path: String): Boolean
+    /** Drains buffered events to the trace file; call periodically. Returns the number written, or -1. */
+    external fun traceFlush(): Int
+    external fun traceStop(): Boolean
+    /** Records a [TRACE_CAPTURE] or [TRACE_PLAYBACK] event; times are [System.nanoTime] values. */
+    external fun traceEvent(kind: Int, streamId: Int, seq: Long, startNs: Long, durNs: Long)
+
+    const val TRACE_CAPTURE = 0
+    const val TRACE_PLAYBACK = 1
+
     external fun destroy(state: Long)
-} 
\ No newline at end of file
+
+    /** Decoded RNNoiseStats; see rnnoise.h. Times are in nanoseconds. */
+    class Stats(raw: LongArray) {
+        val frames = raw[0]
+        val frameNs = raw[1]
+        val frameMaxNs = raw[2]
+        val vadFrames = raw[3]
+        val rnnFrames = raw[4]
+        val interpolatedFrames = raw[5]
+        val spectralSubtractionFrames = raw[6]
+        val modeFrames = raw.copyOfRange(MODES, STAGE_NS)
+        val stageNs = raw.copyOfRange(STAGE_NS, STAGE_MAX_NS)
+        val stageMaxNs = raw.copyOfRange(STAGE_MAX_NS, FRAME_HIST)
+        /** Bucket b counts frames that took [2^b, 2^(b+1)) ns. */
+        val frameHistogram = raw.copyOfRange(FRAME_HIST, STAGE_HIST)
+        val stageHistograms = Array(NB_STAGES) { raw.copyOfRange(STAGE_HIST + it * BUCKETS, STAGE_HIST + (it + 1) * BUCKETS) }
+
+        companion object {
+            const val NB_MODES = 4
+            const val NB_STAGES = 8
+            const val BUCKETS = 32
+            val STAGE_NAMES = arrayOf("window", "fft", "band_energy", "pitch", "rnn", "gain", "ifft", "output")
+            private const val MODES = 7
+            private const val STAGE_NS = MODES + NB_MODES
+            private const val STAGE_MAX_NS = STAGE_NS + NB_STAGES
+            private const val FRAME_HIST = STAGE_MAX_NS + NB_STAGES
+            private const val STAGE_HIST = FRAME_HIST + BUCKETS
+            const val SIZE = STAGE_HIST + NB_STAGES * BUCKETS
+        }
+    }
+}
@@ -0,0 +1,97 @@
+package com.shailesh.callai
+
+import android.media.AudioFormat
+import android.media.AudioManager
+import android.media.AudioTrack
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Plays a call recorded with [CallConnectionService.startRecording] from any position. Seeking is a
+ * lookup in the native recording index, so playback starts immediately. Both sides are mixed down to
+ * the lowest sample rate among them.
+ */
+class RecordingPlayer(private val dir: String) {
+    @Volatile private var running = false
+    private var thread: Thread? = null
+
+    fun start(positionMs: Long) {
+        running = true
+        thread = Thread({ play(positionMs) }, "recording-playback").apply { start() }
+    }
+
+    fun stop() {
+        running = false
+        thread?.join()
+        thread = null
+    }
+
+    private fun play(positionMs: Long) {
+        val recordings = TRACKS.map { RNNoise.recordingOpen("$dir/$it") }.filter { it != 0L }
+        if (recordings.isEmpty()) return
+        val rate = recordings.minOf { RNNoise.recordingSampleRate(it) }
+        val frame = rate / 50
+        val track = AudioTrack(
+            AudioManager.STREAM_MUSIC,
+            rate,
+            AudioFormat.CHANNEL_OUT_MONO,
+            AudioFormat.ENCODING_PCM_16BIT,
+            AudioTrack.getMinBufferSize(rate, AudioFormat.CHANNEL_OUT_MONO, AudioFormat.ENCODING_PCM_16BIT),
+            AudioTrack.MODE_STREAM
+        )
+        // Recordings whose rate is not a multiple of the output rate are skipped.
+        val ratios = recordings.map { RNNoise.recordingSampleRate(it) / rate }
+        val positions = recordings.map { positionMs * RNNoise.recordingSampleRate(it) / 1000 }.toLongArray()
+        val inputs = ratios.map { ByteArray(frame * it * 2) }
+        val mix = IntArray(frame)
+        val out = ByteArray(frame * 2)
+        val outShorts = ByteBuffer.wrap(out).order(ByteOrder.nativeOrder()).asShortBuffer()
+        track.play()
+        try {
+            while (running) {
+                mix.fill(0)
+                var active = false
+                for (t in recordings.indices) {
+                    val ratio = ratios[t]
+                    if (ratio * rate != RNNoise.recordingSampleRate(recordings[t])) continue
+                    val n = RNNoise.recordingRead(recordings[t], positions[t], inputs[t])
+                    if (n <= 0) continue
+                    active = true
+                    positions[t] += n
+                    val samples = ByteBuffer.wrap(inputs[t]).order(ByteOrder.nativeOrder()).asShortBuffer()
+                    // Box-filter decimation; speech has little energy near the output Nyquist rate.
+                    for (i in 0 until n / ratio) {
+                        var sum = 0
+                        for (j in 0 until ratio) sum += samples.get(i * ratio + j)
+                        mix[i] += sum / ratio
+                    }
+                }
+                if (!active) break
+                for (i in 0 until frame) outShorts.put(i, mix[i].coerceIn(-32768, 32767).toShort())
+                track.write(out, 0, out.size)
+            }
+        } finally {
+            track.stop()
+            track.release()
+            recordings.forEach { RNNoise.recordingClose(it) }
+        }
+    }
+
+    companion object {
+        private val TRACKS = listOf("ai", "caller")
+
+        /** Length of the longer side of the recording in [dir], in ms. */
+        @JvmStatic
+        fun durationMs(dir: String): Long {
+            var duration = 0L
+            for (name in TRACKS) {
+                val recording = RNNoise.recordingOpen("$dir/$name")
+                if (recording == 0L) continue
+                duration = maxOf(duration, RNNoise.recordingLength(recording) * 1000 /
+                        RNNoise.recordingSampleRate(recording))
+                RNNoise.recordingClose(recording)
+            }
+            return duration
+        }
+    }
+}
@@ -0,0 +1,31 @@
+package com.shailesh.callai
+
+/**
+ * Detects the start and end of the caller's turn from the VAD probability that
+ * [RNNoise.processFrame] returns for each 10 ms frame. With the defaults a turn
+ * ends 300 ms after the caller stops talking, instead of waiting for the
+ * speech recognizer's silence timeout. [CallAudioCapture] runs one for the
+ * length of each call.
+ */
+class TurnDetector(
+    minSpeechMs: Int = 60,
+    hangoverMs: Int = 300,
+    private val onEvent: (Int) -> Unit = { CallConnectionService.sendTurnEvent(it) }
+) : AutoCloseable {
+    private var endpointer = RNNoise.endpointCreate(minSpeechMs, hangoverMs)
+
+    /** Call once per processed frame, on the audio thread. */
+    fun onFrame(vadProb: Float) {
+        val event = RNNoise.endpointUpdate(endpointer, vadProb)
+        if (event != RNNoise.EVENT_NONE) onEvent(event)
+    }
+
+    fun reset() = RNNoise.endpointReset(endpointer)
+
+    override fun close() {
+        if (endpointer != 0L) {
+            RNNoise.endpointDestroy(endpointer)
+            endpointer = 0
+        }
+    }
+}
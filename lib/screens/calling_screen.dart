@@ -16,6 +16,7 @@ import '../main.dart';
 import '../services/device_service.dart';
 import '../services/firebase_service.dart';
 import '../services/audio_service.dart';
+import '../services/contact_ingest_service.dart';
 import '../services/wallet_service.dart';
 import 'login_screen.dart';
 import 'conversation_log_screen.dart';
@@ -47,6 +48,7 @@ class _CallingScreenState extends State<CallingScreen> {
   bool _isCalling = false;
   String _log = '';
   List<Map<String, String>> _conversation = [];
+  String? _recordingDir;
   bool _callConnected = false;
   bool _conversationActive = false;
   String _currentStatus = "Initializing...";
@@ -341,6 +343,8 @@ class _CallingScreenState extends State<CallingScreen> {
       
       if (callStarted == true) {
         print('[DEBUG] Call initiated successfully');
+        CalledNumbers.markCalled(phoneNumber);
+        _recordingDir = await _audioService.startRecording();
         setState(() { _isCalling = true; });
       } else {
         print('[DEBUG] Failed to start call');
@@ -579,7 +583,10 @@ class _CallingScreenState extends State<CallingScreen> {
               onPressed: () {
                 Navigator.of(context).push(
                   MaterialPageRoute(
-                    builder: (context) => ConversationLogScreen(conversation: _conversation),
+                    builder: (context) => ConversationLogScreen(
+                      conversation: _conversation,
+                      recordingDir: _recordingDir,
+                    ),
                   ),
                 );
               },
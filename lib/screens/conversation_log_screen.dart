@@ -1,10 +1,13 @@
 import 'dart:async';
 import 'package:flutter/material.dart';
+import '../services/audio_service.dart';
 
 class ConversationLogScreen extends StatefulWidget {
   final List<Map<String, String>> conversation;
   final VoidCallback? onShowDialer;
-  const ConversationLogScreen({Key? key, required this.conversation, this.onShowDialer}) : super(key: key);
+  /// Directory of the native call recording, if the call was recorded.
+  final String? recordingDir;
+  const ConversationLogScreen({Key? key, required this.conversation, this.onShowDialer, this.recordingDir}) : super(key: key);
 
   @override
   State<ConversationLogScreen> createState() => _ConversationLogScreenState();
@@ -14,6 +17,10 @@ class _ConversationLogScreenState extends State<ConversationLogScreen> {
   late Timer _timer;
   int _secondsLeft = 300; // 5 minutes
   List<Map<String, String>> _log = [];
+  int _durationMs = 0;
+  double _positionMs = 0;
+  bool _playing = false;
+  Timer? _playbackTimer;
 
   @override
   void initState() {
@@ -29,11 +36,48 @@ class _ConversationLogScreenState extends State<ConversationLogScreen> {
         if (mounted) Navigator.of(context).pop();
       }
     });
+    if (widget.recordingDir != null) _loadRecording();
+  }
+
+  Future<void> _loadRecording() async {
+    final duration = await AudioService.audioChannel
+        .invokeMethod<int>('getRecordingDuration', {'dir': widget.recordingDir});
+    if (mounted) setState(() => _durationMs = duration ?? 0);
+  }
+
+  /// Playback starts at the slider position; the native store seeks through
+  /// its block index, so any position starts immediately.
+  Future<void> _play() async {
+    await AudioService.audioChannel.invokeMethod('playRecording', {
+      'dir': widget.recordingDir,
+      'positionMs': _positionMs.round(),
+    });
+    _playbackTimer?.cancel();
+    final start = DateTime.now();
+    final from = _positionMs;
+    _playbackTimer = Timer.periodic(const Duration(milliseconds: 200), (timer) {
+      final position = from + DateTime.now().difference(start).inMilliseconds;
+      if (position >= _durationMs) {
+        _stopPlayback();
+        setState(() => _positionMs = 0);
+      } else {
+        setState(() => _positionMs = position);
+      }
+    });
+    setState(() => _playing = true);
+  }
+
+  Future<void> _stopPlayback() async {
+    _playbackTimer?.cancel();
+    _playbackTimer = null;
+    if (mounted) setState(() => _playing = false);
+    await AudioService.audioChannel.invokeMethod('stopRecordingPlayback');
   }
 
   @override
   void dispose() {
     _timer.cancel();
+    if (_playing) _stopPlayback();
     super.dispose();
   }
 
@@ -57,6 +101,26 @@ class _ConversationLogScreenState extends State<ConversationLogScreen> {
                 child: const Text('Show Dialer'),
               ),
             const SizedBox(height: 8),
+            if (_durationMs > 0)
+              Row(
+                children: [
+                  IconButton(
+                    icon: Icon(_playing ? Icons.stop : Icons.play_arrow),
+                    onPressed: _playing ? _stopPlayback : _play,
+                  ),
+                  Expanded(
+                    child: Slider(
+                      value: _positionMs.clamp(0, _durationMs).toDouble(),
+                      max: _durationMs.toDouble(),
+                      onChanged: (value) => setState(() => _positionMs = value),
+                      onChangeEnd: (value) {
+                        if (_playing) _play();
+                      },
+                    ),
+                  ),
+                  Text('${_positionMs ~/ 60000}:${((_positionMs ~/ 1000) % 60).toString().padLeft(2, '0')}'),
+                ],
+              ),
             Expanded(
               child: ListView.builder(
                 itemCount: _log.length,
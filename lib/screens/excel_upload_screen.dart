@@ -2,8 +2,11 @@ import 'package:flutter/material.dart';
 import 'package:file_picker/file_picker.dart';
 import 'package:google_fonts/google_fonts.dart';
 import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
 import 'package:csv/csv.dart';
 import 'package:excel/excel.dart' hide Border;
+import '../services/contact_ingest_service.dart';
 import '../widgets/callai_logo.dart';
 
 class ExcelUploadScreen extends StatefulWidget {
@@ -24,6 +27,8 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
   String? _selectedFilePath;
   List<Map<String, String>> _contactsPreview = [];
   bool _isLoading = false;
+  double? _importProgress;
+  String? _skippedSummary;
   String? _errorMessage;
   bool _showPreview = false;
 
@@ -108,7 +113,11 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
                   )
                 : const Icon(Icons.upload_file),
               label: Text(
-                _isLoading ? 'Processing...' : 'Choose File',
+                _isLoading
+                    ? (_importProgress != null
+                        ? 'Processing... ${(_importProgress! * 100).round()}%'
+                        : 'Processing...')
+                    : 'Choose File',
                 style: GoogleFonts.poppins(
                   fontSize: 16,
                   fontWeight: FontWeight.w600,
@@ -310,6 +319,8 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
   Future<void> _pickFile() async {
     setState(() {
       _isLoading = true;
+      _importProgress = null;
+      _skippedSummary = null;
       _errorMessage = null;
       _selectedFilePath = null;
       _contactsPreview = [];
@@ -346,7 +357,8 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
         // Show success message
         ScaffoldMessenger.of(context).showSnackBar(
           SnackBar(
-            content: Text('Successfully loaded ${contacts.length} contacts'),
+            content: Text('Successfully loaded ${contacts.length} contacts'
+                '${_skippedSummary != null ? ' ($_skippedSummary)' : ''}'),
             backgroundColor: Colors.green,
           ),
         );
@@ -371,14 +383,49 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
     }
   }
 
-  String _cleanPhoneNumber(String raw) {
-    var cleaned = raw.trim();
-    // If it's a number that got converted to a double string (e.g., "123.0"), fix it.
-    if (cleaned.endsWith('.0')) {
-      cleaned = cleaned.substring(0, cleaned.length - 2);
+  static String? _describeSkipped(ContactImport result) {
+    final parts = [
+      if (result.duplicates > 0) '${result.duplicates} duplicates',
+      if (result.alreadyCalled > 0) '${result.alreadyCalled} already called',
+      if (result.invalid > 0) '${result.invalid} invalid numbers',
+    ];
+    return parts.isEmpty ? null : 'skipped ${parts.join(', ')}';
+  }
+
+  /// Decodes the first sheet of an Excel file. Runs on a background isolate,
+  /// so it must not touch widget state. Phone numbers are returned as found;
+  /// ContactIngestService.dedupContacts() normalizes them.
+  static List<Map<String, String>> _parseExcel(Uint8List bytes) {
+    List<Map<String, String>> contacts = [];
+    var excel = Excel.decodeBytes(bytes);
+    var sheet = excel.tables[excel.tables.keys.first];
+    if (sheet == null) {
+      throw Exception('No sheet found in Excel file');
     }
-    // Remove any other non-numeric characters.
-    return cleaned.replaceAll(RegExp(r'[^\d]'), '');
+    print('[DEBUG] Excel sheet rows: ${sheet.maxRows}');
+
+    // Skip header row, start from the second row (index 1)
+    for (var i = 1; i < sheet.maxRows; i++) {
+      var row = sheet.row(i);
+
+      if (row.length >= 2 && row[0]?.value != null && row[1]?.value != null) {
+        final phone = row[1]!.value.toString().trim();
+        final name = row[0]!.value.toString().trim();
+
+        // Skip empty rows
+        if (name.isEmpty || phone.isEmpty) {
+          continue;
+        }
+
+        contacts.add({
+          'name': name,
+          'phone': phone
+        });
+      } else {
+        print('[WARNING] Excel row $i has insufficient data: $row');
+      }
+    }
+    return contacts;
   }
 
   Future<List<Map<String, String>>> _readContactsFromFile(String path) async {
@@ -389,7 +436,20 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
     print('[DEBUG] File exists: ${await file.exists()}');
     print('[DEBUG] File size: ${await file.length()} bytes');
 
-    if (path.endsWith('.csv')) {
+    if (path.endsWith('.csv') && ContactIngestService.isAvailable) {
+      // Native parser on a background isolate; large campaign lists would
+      // otherwise freeze the UI while the Dart parser runs.
+      try {
+        final result = await ContactIngestService.readCsv(path, onProgress: (fraction) {
+          if (mounted) setState(() => _importProgress = fraction);
+        });
+        contacts = result.contacts;
+        _skippedSummary = _describeSkipped(result);
+      } catch (e) {
+        print('[ERROR] Error reading CSV file: $e');
+        throw Exception('Failed to read CSV file: $e');
+      }
+    } else if (path.endsWith('.csv')) {
       try {
         final content = await file.readAsString();
         print('[DEBUG] CSV content length: ${content.length} characters');
@@ -420,8 +480,7 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
           }
           
           if (row.length >= 2) {
-            final rawPhone = row[1].toString();
-            final phone = _cleanPhoneNumber(rawPhone);
+            final phone = row[1].toString().trim();
             final name = row[0].toString().trim();
             
             // Skip empty rows
@@ -429,17 +488,16 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
               continue;
             }
             
-            print('[DEBUG] CSV contact: name="$name" raw="$rawPhone" cleaned="$phone"');
-            
-            if (phone.length != 10) {
-              print('[WARNING] Cleaned phone number is not 10 digits: "$phone" from row: $row');
-            }
+            print('[DEBUG] CSV contact: name="$name" phone="$phone"');
             
             contacts.add({'name': name, 'phone': phone});
           } else {
             print('[WARNING] Row $i has insufficient columns: $row');
           }
         }
+        final result = await ContactIngestService.dedupContacts(contacts);
+        contacts = result.contacts;
+        _skippedSummary = _describeSkipped(result);
       } catch (e) {
         print('[ERROR] Error reading CSV file: $e');
         throw Exception('Failed to read CSV file: $e');
@@ -449,43 +507,11 @@ class _ExcelUploadScreenState extends State<ExcelUploadScreen> {
         var bytes = await file.readAsBytes();
         print('[DEBUG] Excel file size: ${bytes.length} bytes');
         
-        var excel = Excel.decodeBytes(bytes);
-        var sheet = excel.tables[excel.tables.keys.first];
-        if (sheet != null) {
-          print('[DEBUG] Excel sheet rows: ${sheet.maxRows}');
-          
-          // Skip header row, start from the second row (index 1)
-          for (var i = 1; i < sheet.maxRows; i++) {
-            var row = sheet.row(i);
-            print('[DEBUG] Processing Excel row $i: $row');
-            
-            if (row.length >= 2 && row[0]?.value != null && row[1]?.value != null) {
-              final rawPhone = row[1]!.value.toString();
-              final phone = _cleanPhoneNumber(rawPhone);
-              final name = row[0]!.value.toString().trim();
-              
-              // Skip empty rows
-              if (name.isEmpty || phone.isEmpty) {
-                continue;
-              }
-              
-              print('[DEBUG] Excel contact: name="$name" raw="$rawPhone" cleaned="$phone"');
-              
-              if (phone.length != 10) {
-                print('[WARNING] Cleaned phone number is not 10 digits: "$phone" from row: $row');
-              }
-              
-              contacts.add({
-                'name': name,
-                'phone': phone
-              });
-            } else {
-              print('[WARNING] Excel row $i has insufficient data: $row');
-            }
-          }
-        } else {
-          throw Exception('No sheet found in Excel file');
-        }
+        final rows = await Isolate.run(() => _parseExcel(bytes));
+        // Same normalization, deduplication and called-number check as CSV.
+        final result = await ContactIngestService.dedupContacts(rows);
+        contacts = result.contacts;
+        _skippedSummary = _describeSkipped(result);
       } catch (e) {
         print('[ERROR] Error reading Excel file: $e');
         throw Exception('Failed to read Excel file: $e');
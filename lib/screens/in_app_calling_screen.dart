@@ -3,6 +3,7 @@ import 'dart:async';
 import 'package:flutter/material.dart';
 import 'package:flutter/services.dart';
 import 'package:googleapis_auth/auth_io.dart';
+import '../services/contact_ingest_service.dart';
 import '../services/speech_to_text_service.dart';
 // TODO: Add a streaming speech-to-text package
 
@@ -97,6 +98,7 @@ class _InAppCallingScreenState extends State<InAppCallingScreen> {
 
     try {
       await platform.invokeMethod('startCall', {'number': phoneNumber});
+      CalledNumbers.markCalled(phoneNumber);
       _startCallTimer();
     } on PlatformException catch (e) {
       setState(() {
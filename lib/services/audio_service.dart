@@ -5,6 +5,7 @@ import 'firebase_service.dart';
 import 'package:get_it/get_it.dart';
 import 'wallet_service.dart';
 import 'dart:async';
+import 'package:path_provider/path_provider.dart';
 
 class AudioService {
   static const platform = MethodChannel('com.shailesh.callai/audio');
@@ -13,7 +14,9 @@ class AudioService {
   final FlutterTts tts;
   final SpeechToText stt;
 
-  AudioService(this.tts, this.stt);
+  AudioService(this.tts, this.stt) {
+    _initAudioProcessing();
+  }
 
   static void register() {
     GetIt.I.registerSingletonAsync<AudioService>(() async {
@@ -79,6 +82,23 @@ class AudioService {
             await _processAudioData(audioData);
           }
           break;
+        case 'onSpeechStart':
+          break;
+        case 'onEndOfTurn':
+          // The native turn detector saw the caller stop talking; finish the
+          // recognition now instead of waiting for the STT silence timeout.
+          if (_isListening) {
+            await stt.stop();
+          }
+          break;
+        case 'onBargeIn':
+          // The caller talked over the AI. Native code has already flushed
+          // queued playback; stopping TTS ends speakResponse, which resumes
+          // listening.
+          if (_isSpeaking) {
+            await tts.stop();
+          }
+          break;
         default:
           throw PlatformException(
             code: 'Unimplemented',
@@ -119,6 +139,8 @@ class AudioService {
         }
       },
       listenFor: const Duration(seconds: 30),
+      // Fallback only: onEndOfTurn from the native turn detector normally
+      // stops listening 300 ms after the caller goes quiet.
       pauseFor: const Duration(seconds: 3),
     );
 
@@ -192,11 +214,34 @@ class AudioService {
     _isListening = false;
     await stt.stop();
     await tts.stop();
+    await stopRecording();
     
     // Save conversation log
     await _saveConversationLog();
   }
 
+  /// Records the call audio natively into a new directory under
+  /// documents/recordings and returns it, or null if recording failed.
+  Future<String?> startRecording() async {
+    try {
+      final docs = await getApplicationDocumentsDirectory();
+      final dir = '${docs.path}/recordings/${DateTime.now().millisecondsSinceEpoch}';
+      final ok = await audioChannel.invokeMethod<bool>('startRecording', {'dir': dir});
+      return ok == true ? dir : null;
+    } on PlatformException catch (e) {
+      print("Failed to start call recording: '${e.message}'.");
+      return null;
+    }
+  }
+
+  Future<void> stopRecording() async {
+    try {
+      await audioChannel.invokeMethod('stopRecording');
+    } on PlatformException catch (e) {
+      print("Failed to stop call recording: '${e.message}'.");
+    }
+  }
+
   Future<void> _saveConversationLog() async {
     try {
       // Generate summary using Gemini
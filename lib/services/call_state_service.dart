@@ -1,5 +1,6 @@
 import 'package:flutter/services.dart';
 import 'dart:async';
+import 'contact_ingest_service.dart';
 
 class CallStateService {
   static const MethodChannel _channel = MethodChannel('com.shailesh.callai/call');
@@ -76,7 +77,9 @@ class CallStateService {
     try {
       final result = await _channel.invokeMethod('startCall', {'number': phoneNumber});
       _logDebug('Call initiated: $phoneNumber');
-      return result == 'Call initiation process started';
+      final started = result == 'Call initiation process started';
+      if (started) CalledNumbers.markCalled(phoneNumber);
+      return started;
     } catch (e) {
       _logError('Failed to start call: $e');
       return false;
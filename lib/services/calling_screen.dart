@@ -66,6 +66,7 @@ class _CallingScreenState extends State<CallingScreen> {
       await _audioService.stopListening();
       final callStarted = await FlutterPhoneDirectCaller.callNumber(phoneNumber);
       if (callStarted == true) {
+        CalledNumbers.markCalled(phoneNumber);
         setState(() { _isCalling = true; });
       } else {
         _log += 'Failed to start call.\n';
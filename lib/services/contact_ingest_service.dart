@@ -0,0 +1,353 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'package:ffi/ffi.dart';
+import 'package:path_provider/path_provider.dart';
+
+typedef _OpenNative = Pointer<Void> Function(Pointer<Utf8> path);
+typedef _RunNative = Int32 Function(Pointer<Void> table);
+typedef _Run = int Function(Pointer<Void> table);
+typedef _Int64Native = Int64 Function(Pointer<Void> table);
+typedef _Int64 = int Function(Pointer<Void> table);
+typedef _ColumnNative = Pointer<Uint8> Function(
+    Pointer<Void> table, Int32 column, Pointer<Pointer<Uint32>> offsets);
+typedef _Column = Pointer<Uint8> Function(
+    Pointer<Void> table, int column, Pointer<Pointer<Uint32>> offsets);
+typedef _CloseNative = Void Function(Pointer<Void> table);
+typedef _Close = void Function(Pointer<Void> table);
+typedef _NormalizeNative = Uint64 Function(Pointer<Utf8> raw, Int32 len, Int32 defaultCc);
+typedef _Normalize = int Function(Pointer<Utf8> raw, int len, int defaultCc);
+typedef _SetCreateNative = Pointer<Void> Function(Int64 expected);
+typedef _SetCreate = Pointer<Void> Function(int expected);
+typedef _SetKeyNative = Int32 Function(Pointer<Void> set, Uint64 key);
+typedef _SetKey = int Function(Pointer<Void> set, int key);
+typedef _SetPathNative = Int32 Function(Pointer<Void> set, Pointer<Utf8> path);
+typedef _SetPath = int Function(Pointer<Void> set, Pointer<Utf8> path);
+typedef _DedupNative = Int32 Function(Pointer<Void> table, Pointer<Void> called,
+    Int32 defaultCc, Pointer<Uint64> keys, Pointer<Uint8> status);
+typedef _Dedup = int Function(Pointer<Void> table, Pointer<Void> called,
+    int defaultCc, Pointer<Uint64> keys, Pointer<Uint8> status);
+
+/// Bindings for libcallai_ingest (android/app/src/main/cpp/ingest). Top-level
+/// so every isolate resolves its own copy on first use.
+class _IngestLib {
+  static const nameColumn = 0;
+  static const phoneColumn = 1;
+  static const errorFormat = -2;
+
+  // Statuses from callai_phone_dedup().
+  static const phoneNew = 0;
+  static const phoneDuplicate = 1;
+  static const phoneCalled = 2;
+  static const phoneBad = 3;
+
+  final _OpenNative open;
+  final _Run run;
+  final _Int64 progress;
+  final _Int64 size;
+  final _Run rows;
+  final _Column column;
+  final _Close close;
+  final _Normalize normalize;
+  final _SetCreate setCreate;
+  final _SetKey setInsert;
+  final _SetKey setContains;
+  final _SetPath setLoad;
+  final _SetPath setSave;
+  final _Dedup dedup;
+
+  _IngestLib(DynamicLibrary lib)
+      : open = lib.lookupFunction<_OpenNative, _OpenNative>('callai_ingest_open'),
+        run = lib.lookupFunction<_RunNative, _Run>('callai_ingest_run'),
+        progress = lib.lookupFunction<_Int64Native, _Int64>('callai_ingest_progress'),
+        size = lib.lookupFunction<_Int64Native, _Int64>('callai_ingest_size'),
+        rows = lib.lookupFunction<_RunNative, _Run>('callai_ingest_rows'),
+        column = lib.lookupFunction<_ColumnNative, _Column>('callai_ingest_column'),
+        close = lib.lookupFunction<_CloseNative, _Close>('callai_ingest_close'),
+        normalize = lib.lookupFunction<_NormalizeNative, _Normalize>('callai_phone_normalize'),
+        setCreate = lib.lookupFunction<_SetCreateNative, _SetCreate>('callai_phone_set_create'),
+        setInsert = lib.lookupFunction<_SetKeyNative, _SetKey>('callai_phone_set_insert'),
+        setContains = lib.lookupFunction<_SetKeyNative, _SetKey>('callai_phone_set_contains'),
+        setLoad = lib.lookupFunction<_SetPathNative, _SetPath>('callai_phone_set_load'),
+        setSave = lib.lookupFunction<_SetPathNative, _SetPath>('callai_phone_set_save'),
+        dedup = lib.lookupFunction<_DedupNative, _Dedup>('callai_phone_dedup');
+}
+
+final _IngestLib? _lib = () {
+  if (!Platform.isAndroid && !Platform.isLinux) return null;
+  try {
+    return _IngestLib(DynamicLibrary.open('libcallai_ingest.so'));
+  } catch (e) {
+    print('[WARNING] Native contact import unavailable: $e');
+    return null;
+  }
+}();
+
+/// Country calling code assumed for numbers without one.
+const int defaultCountryCode = 91;
+
+/// Formats a packed E.164 key from libcallai_ingest as "+<digits>".
+String _formatPhoneKey(int key) => '+${key & ((1 << 56) - 1)}';
+
+/// Packs [phone] into an E.164 key with callai_phone_normalize(), or with the
+/// same rules in Dart where the library is unavailable. 0 means invalid.
+int _phoneKey(String phone) {
+  final lib = _lib;
+  if (lib == null) return _normalizeInDart(phone, defaultCountryCode);
+  final raw = phone.toNativeUtf8();
+  final key = lib.normalize(raw, raw.length, defaultCountryCode);
+  malloc.free(raw);
+  return key;
+}
+
+/// Dart port of callai_phone_normalize(); see phone_index.h for the rules.
+int _normalizeInDart(String raw, int defaultCc) {
+  var trimmed = raw.trimRight();
+  if (trimmed.endsWith('.0')) trimmed = trimmed.substring(0, trimmed.length - 2);
+  final buffer = StringBuffer();
+  var international = false;
+  for (final c in trimmed.codeUnits) {
+    if (c >= 0x30 && c <= 0x39) {
+      buffer.writeCharCode(c);
+    } else if (c == 0x2B && buffer.isEmpty) {
+      international = true;
+    }
+  }
+  var digits = buffer.toString();
+  if (!international && digits.startsWith('00')) {
+    international = true;
+    digits = digits.substring(2);
+  }
+  if (!international) {
+    final cc = defaultCc > 0 ? '$defaultCc' : '';
+    if (digits.startsWith('0')) digits = digits.substring(1);
+    if (!(digits.length == cc.length + 10 && digits.startsWith(cc))) digits = cc + digits;
+  }
+  if (digits.length < 8 || digits.length > 15 || digits.startsWith('0')) return 0;
+  return digits.length << 56 | int.parse(digits);
+}
+
+/// Result of a native import: the new contacts, with phone numbers in E.164,
+/// and how many rows were dropped.
+class ContactImport {
+  final List<Map<String, String>> contacts;
+  final int duplicates;
+  final int alreadyCalled;
+  final int invalid;
+
+  const ContactImport(this.contacts, this.duplicates, this.alreadyCalled, this.invalid);
+}
+
+/// Index of every number the app has dialled, kept in a native hash set and
+/// saved under the documents directory.
+///
+/// Imports read the set on background isolates, and an insert may grow and
+/// free its table, so numbers dialled while an import runs are queued and
+/// added when the last import finishes.
+class CalledNumbers {
+  static const _fileName = 'called_numbers.bin';
+
+  static Pointer<Void>? _set;
+  static String? _path;
+  static Timer? _saveTimer;
+  static int _readers = 0;
+  static final List<int> _pending = [];
+
+  static Future<Pointer<Void>?>? _loading;
+
+  static Future<Pointer<Void>?> _load() => _loading ??= _open();
+
+  static Future<Pointer<Void>?> _open() async {
+    final lib = _lib;
+    if (lib == null) return null;
+    final dir = await getApplicationDocumentsDirectory();
+    final path = '${dir.path}/$_fileName';
+    final set = lib.setCreate(1 << 16);
+    final nativePath = path.toNativeUtf8();
+    final status = lib.setLoad(set, nativePath);
+    malloc.free(nativePath);
+    if (status != 0) {
+      print('[WARNING] Could not load called numbers (error $status)');
+    }
+    _path = path;
+    return _set = set;
+  }
+
+  /// Records a dialled number. The file is rewritten a few seconds later so a
+  /// calling campaign does not save after every call.
+  static Future<void> markCalled(String phone) async {
+    final lib = _lib;
+    final set = await _load();
+    if (lib == null || set == null) return;
+    final key = _phoneKey(phone);
+    if (_readers > 0) {
+      _pending.add(key);
+    } else {
+      _insert(lib, set, key);
+    }
+  }
+
+  static void _insert(_IngestLib lib, Pointer<Void> set, int key) {
+    if (lib.setInsert(set, key) == 1) {
+      _saveTimer ??= Timer(const Duration(seconds: 5), _save);
+    }
+  }
+
+  /// Loads the set for a background reader; no insert happens until the
+  /// matching [_endRead].
+  static Future<Pointer<Void>?> _beginRead() {
+    _readers++;
+    return _load();
+  }
+
+  static void _endRead() {
+    if (--_readers > 0) return;
+    final set = _set;
+    if (set != null) {
+      for (final key in _pending) {
+        _insert(_lib!, set, key);
+      }
+    }
+    _pending.clear();
+  }
+
+  static void _save() {
+    _saveTimer = null;
+    final nativePath = _path!.toNativeUtf8();
+    final status = _lib!.setSave(_set!, nativePath);
+    malloc.free(nativePath);
+    if (status != 0) {
+      print('[WARNING] Could not save called numbers (error $status)');
+    }
+  }
+}
+
+/// Imports CSV contact lists with the native parser, which memory-maps the
+/// file and scans it with SIMD. Parsing and decoding run on a background
+/// isolate so large campaign lists do not block the UI.
+class ContactIngestService {
+  static bool get isAvailable => _lib != null;
+
+  /// Reads the name and phone columns of a CSV file, applying the same rules
+  /// as the Dart importer in ExcelUploadScreen. Phone numbers are normalized
+  /// to E.164; repeated numbers, invalid ones and, with [skipCalled], numbers
+  /// dialled before are dropped. [onProgress] is called with the fraction of
+  /// the file parsed so far.
+  static Future<ContactImport> readCsv(String path,
+      {bool skipCalled = true, void Function(double fraction)? onProgress}) async {
+    final lib = _lib;
+    if (lib == null) {
+      throw UnsupportedError('Native contact import is not available on this platform.');
+    }
+    final nativePath = path.toNativeUtf8();
+    final table = lib.open(nativePath);
+    malloc.free(nativePath);
+    if (table == nullptr) {
+      throw FileSystemException('Cannot open contact list', path);
+    }
+
+    final total = lib.size(table);
+    Timer? timer;
+    if (onProgress != null && total > 0) {
+      timer = Timer.periodic(const Duration(milliseconds: 50), (_) {
+        onProgress(lib.progress(table) / total);
+      });
+    }
+    try {
+      // Inserts into the called set are held back while the isolate reads it.
+      final called = skipCalled ? await CalledNumbers._beginRead() : null;
+      final address = table.address;
+      final calledAddress = called?.address ?? 0;
+      return await Isolate.run(() => _parse(address, calledAddress));
+    } finally {
+      if (skipCalled) CalledNumbers._endRead();
+      timer?.cancel();
+      lib.close(table);
+    }
+  }
+
+  /// Applies the rules of [readCsv] to contacts read by a Dart parser (Excel
+  /// files, or CSV where the native parser is unavailable): phone numbers
+  /// become E.164, and repeated, invalid and, with [skipCalled], previously
+  /// dialled numbers are dropped. Other fields are kept.
+  static Future<ContactImport> dedupContacts(List<Map<String, String>> rows,
+      {bool skipCalled = true}) async {
+    final reading = skipCalled && _lib != null;
+    try {
+      final called = reading ? await CalledNumbers._beginRead() : null;
+      final calledAddress = called?.address ?? 0;
+      return await Isolate.run(() => _dedupRows(rows, calledAddress));
+    } finally {
+      if (reading) CalledNumbers._endRead();
+    }
+  }
+
+  static ContactImport _dedupRows(List<Map<String, String>> rows, int calledAddress) {
+    final called = Pointer<Void>.fromAddress(calledAddress);
+    final seen = <int>{};
+    final contacts = <Map<String, String>>[];
+    var duplicates = 0, alreadyCalled = 0, invalid = 0;
+    for (final row in rows) {
+      final key = _phoneKey(row['phone'] ?? '');
+      if (key == 0) {
+        invalid++;
+      } else if (calledAddress != 0 && _lib!.setContains(called, key) != 0) {
+        alreadyCalled++;
+      } else if (!seen.add(key)) {
+        duplicates++;
+      } else {
+        contacts.add({...row, 'phone': _formatPhoneKey(key)});
+      }
+    }
+    return ContactImport(contacts, duplicates, alreadyCalled, invalid);
+  }
+
+  static ContactImport _parse(int address, int calledAddress) {
+    final lib = _lib!;
+    final table = Pointer<Void>.fromAddress(address);
+    final status = lib.run(table);
+    if (status == _IngestLib.errorFormat) {
+      throw const FormatException('Invalid CSV format. File must have at least 2 columns.');
+    } else if (status != 0) {
+      throw Exception('Failed to read CSV file (error $status).');
+    }
+
+    final rows = lib.rows(table);
+    if (rows == 0) return const ContactImport([], 0, 0, 0);
+    final offsetsOut = malloc<Pointer<Uint32>>();
+    final keysOut = malloc<Uint64>(rows);
+    final statusOut = malloc<Uint8>(rows);
+    try {
+      final fresh = lib.dedup(table, Pointer<Void>.fromAddress(calledAddress),
+          defaultCountryCode, keysOut, statusOut);
+      if (fresh < 0) {
+        throw Exception('Failed to deduplicate contacts (error $fresh).');
+      }
+      final namesData = lib.column(table, _IngestLib.nameColumn, offsetsOut);
+      final nameOffsets = offsetsOut.value.asTypedList(rows + 1);
+      final names = namesData.asTypedList(nameOffsets[rows]);
+      final keys = keysOut.asTypedList(rows);
+      final statuses = statusOut.asTypedList(rows);
+
+      final contacts = <Map<String, String>>[];
+      final counts = List<int>.filled(4, 0);
+      const decoder = Utf8Decoder(allowMalformed: true);
+      for (var i = 0; i < rows; i++) {
+        counts[statuses[i]]++;
+        if (statuses[i] != _IngestLib.phoneNew) continue;
+        contacts.add({
+          'name': decoder.convert(names, nameOffsets[i], nameOffsets[i + 1]),
+          'phone': _formatPhoneKey(keys[i]),
+        });
+      }
+      return ContactImport(contacts, counts[_IngestLib.phoneDuplicate],
+          counts[_IngestLib.phoneCalled], counts[_IngestLib.phoneBad]);
+    } finally {
+      malloc.free(offsetsOut);
+      malloc.free(keysOut);
+      malloc.free(statusOut);
+    }
+  }
+}
@@ -0,0 +1,201 @@
+import 'dart:async';
+import 'dart:developer';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+
+typedef _FrameSizeNative = Int32 Function();
+typedef _FrameSize = int Function();
+typedef _CreateNative = Pointer<Void> Function(Pointer<Void> model);
+typedef _DestroyNative = Void Function(Pointer<Void> st);
+typedef _Destroy = void Function(Pointer<Void> st);
+typedef _ProcessFramesNative = Void Function(Pointer<Void> st, Pointer<Int16> out,
+    Pointer<Int16> input, Int32 frames, Pointer<Float> vad);
+typedef _ProcessFrames = void Function(Pointer<Void> st, Pointer<Int16> out,
+    Pointer<Int16> input, int frames, Pointer<Float> vad);
+typedef _SetComplexityNative = Void Function(Pointer<Void> st, Int32 complexity);
+typedef _SetComplexity = void Function(Pointer<Void> st, int complexity);
+
+/// Bindings for librnnoise_ffi, the Linux desktop build of the denoiser in
+/// android/app/src/main/cpp/rnnoise. On Android the same code is reached
+/// through JNI instead.
+class _RNNoiseLib {
+  final _FrameSize frameSize;
+  final _CreateNative create;
+  final _Destroy destroy;
+  final _ProcessFrames processFrames;
+  final _SetComplexity setComplexity;
+
+  _RNNoiseLib(DynamicLibrary lib)
+      : frameSize = lib.lookupFunction<_FrameSizeNative, _FrameSize>('rnnoise_get_frame_size'),
+        create = lib.lookupFunction<_CreateNative, _CreateNative>('rnnoise_create'),
+        destroy = lib.lookupFunction<_DestroyNative, _Destroy>('rnnoise_destroy'),
+        processFrames =
+            lib.lookupFunction<_ProcessFramesNative, _ProcessFrames>('rnnoise_process_frames'),
+        setComplexity =
+            lib.lookupFunction<_SetComplexityNative, _SetComplexity>('rnnoise_set_complexity');
+}
+
+final _RNNoiseLib? _lib = () {
+  if (!Platform.isLinux) return null;
+  try {
+    return _RNNoiseLib(DynamicLibrary.open('librnnoise_ffi.so'));
+  } catch (e) {
+    print('[WARNING] Native denoiser unavailable: $e');
+    return null;
+  }
+}();
+
+/// Audio buffers in native memory for [DenoiseWorker]. The typed-data views
+/// alias the native allocation, so filling [input] and reading [output]
+/// copies nothing, and the worker isolate is only sent their addresses.
+class DenoiseBuffers {
+  final int frames;
+  final Pointer<Int16> _input;
+  final Pointer<Int16> _output;
+  final Pointer<Float> _vad;
+
+  /// 16-bit PCM at 48 kHz, [frames] frames of [DenoiseWorker.frameSize].
+  late final Int16List input = _input.asTypedList(frames * DenoiseWorker.frameSize);
+  late final Int16List output = _output.asTypedList(frames * DenoiseWorker.frameSize);
+
+  /// Voice activity probability of each frame.
+  late final Float32List vad = _vad.asTypedList(frames);
+
+  DenoiseBuffers._(this.frames, this._input, this._output, this._vad);
+
+  factory DenoiseBuffers(int frames) {
+    final samples = frames * DenoiseWorker.frameSize;
+    return DenoiseBuffers._(
+        frames, malloc<Int16>(samples), malloc<Int16>(samples), malloc<Float>(frames));
+  }
+
+  /// Releases the native memory. The views must not be used afterwards.
+  void free() {
+    malloc.free(_input);
+    malloc.free(_output);
+    malloc.free(_vad);
+  }
+}
+
+/// Timings of the calls made through a [DenoiseWorker], for profiling the
+/// whole path from the UI isolate to the native code and back.
+class DenoiseProfile {
+  int calls = 0;
+  int frames = 0;
+
+  /// Time spent in rnnoise_process_frames().
+  int nativeMicros = 0;
+
+  /// Time from [DenoiseWorker.process] to its future completing.
+  int roundTripMicros = 0;
+  int maxRoundTripMicros = 0;
+
+  /// Average cost of crossing the isolate boundary per call.
+  double get overheadMicros => calls == 0 ? 0 : (roundTripMicros - nativeMicros) / calls;
+
+  /// Fraction of real time spent denoising; frames are 10 ms.
+  double get realTimeFactor => frames == 0 ? 0 : nativeMicros / (frames * 10000);
+
+  @override
+  String toString() => 'DenoiseProfile(calls: $calls, frames: $frames, '
+      'native: ${nativeMicros}us, roundTrip: ${roundTripMicros}us, '
+      'maxRoundTrip: ${maxRoundTripMicros}us, overhead/call: '
+      '${overheadMicros.toStringAsFixed(1)}us, rtf: ${realTimeFactor.toStringAsFixed(4)})';
+}
+
+/// Runs one denoiser stream on a background isolate. Calls are processed in
+/// order; each one denoises [DenoiseBuffers.input] into
+/// [DenoiseBuffers.output] on the native side.
+class DenoiseWorker {
+  static bool get isAvailable => _lib != null;
+
+  /// Samples per frame (10 ms at 48 kHz).
+  static int get frameSize => _lib?.frameSize() ?? 480;
+
+  final SendPort _commands;
+  final ReceivePort _replies;
+  final _pending = <int, (Completer<void>, Stopwatch)>{};
+  int _nextId = 0;
+
+  final DenoiseProfile profile = DenoiseProfile();
+
+  DenoiseWorker._(this._commands, this._replies, Stream<dynamic> messages) {
+    messages.listen(_onReply);
+  }
+
+  /// Starts the worker isolate, which owns the denoiser state.
+  static Future<DenoiseWorker> spawn({int? complexity}) async {
+    if (_lib == null) {
+      throw UnsupportedError('Native denoiser is not available on this platform.');
+    }
+    final replies = ReceivePort();
+    await Isolate.spawn(_run, (replies.sendPort, complexity),
+        debugName: 'denoise');
+    // The first message is the worker's port; the rest are replies.
+    final messages = replies.asBroadcastStream();
+    final commands = await messages.first as SendPort;
+    return DenoiseWorker._(commands, replies, messages);
+  }
+
+  /// Denoises all frames of [buffers]. [buffers] must not be touched until
+  /// the future completes.
+  Future<void> process(DenoiseBuffers buffers) {
+    final id = _nextId++;
+    final done = Completer<void>();
+    _pending[id] = (done, Stopwatch()..start());
+    _commands.send([id, buffers._input.address, buffers._output.address,
+        buffers._vad.address, buffers.frames]);
+    return done.future;
+  }
+
+  void _onReply(dynamic message) {
+    final [int id, int frames, int nativeMicros] = message as List<dynamic>;
+    final (done, watch) = _pending.remove(id)!;
+    final roundTrip = watch.elapsedMicroseconds;
+    profile
+      ..calls += 1
+      ..frames += frames
+      ..nativeMicros += nativeMicros
+      ..roundTripMicros += roundTrip;
+    if (roundTrip > profile.maxRoundTripMicros) profile.maxRoundTripMicros = roundTrip;
+    done.complete();
+  }
+
+  /// Stops the worker after the calls already queued and frees its state.
+  Future<void> close() async {
+    await Future.wait(_pending.values.map((p) => p.$1.future));
+    // The worker frees its state and exits once its port is closed.
+    _commands.send(null);
+    _replies.close();
+  }
+
+  static void _run((SendPort, int?) args) {
+    final (replies, complexity) = args;
+    final lib = _lib!;
+    final commands = ReceivePort();
+    final st = lib.create(nullptr);
+    if (complexity != null) lib.setComplexity(st, complexity);
+    final watch = Stopwatch();
+    replies.send(commands.sendPort);
+    commands.listen((message) {
+      if (message == null) {
+        lib.destroy(st);
+        commands.close();
+        return;
+      }
+      final [int id, int input, int output, int vad, int frames] = message as List<dynamic>;
+      watch
+        ..reset()
+        ..start();
+      Timeline.timeSync('rnnoise_process_frames', () {
+        lib.processFrames(st, Pointer<Int16>.fromAddress(output),
+            Pointer<Int16>.fromAddress(input), frames, Pointer<Float>.fromAddress(vad));
+      });
+      watch.stop();
+      replies.send([id, frames, watch.elapsedMicroseconds]);
+    });
+  }
+}